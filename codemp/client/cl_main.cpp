@@ -37,6 +37,12 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "snd_local.h"
 #include "sys/sys_loadlib.h"
 
+#ifdef USE_INTERNAL_ZLIB
+#include "zlib/zlib.h"
+#else
+#include <zlib.h>
+#endif
+
 cvar_t	*cl_consoleFontSize;
 cvar_t	*cl_topLeftFontSize;
 cvar_t	*cl_useToggle;
@@ -458,6 +464,192 @@ void CL_DemoCompleted( void ) {
 	CL_NextDemo();
 }
 
+static byte	demoBlockData[DEMO_BLOCK_SIZE];			// unpacked container block
+static byte	demoPackedData[DEMO_BLOCK_PACKED_SIZE];
+static int	demoSeekTime = -1;						// set by demo_seek for the next CL_PlayDemo_f
+
+/*
+=================
+CL_ReadDemoBlockHeader
+
+Reads the header of the next container block, returns qfalse at the end
+of the file or if the header makes no sense.
+=================
+*/
+static qboolean CL_ReadDemoBlockHeader( int *type, int *packedLen, int *rawLen, int *time ) {
+	int		header[4];
+
+	if ( FS_Read( header, sizeof( header ), clc.demofile ) != sizeof( header ) ) {
+		return qfalse;
+	}
+
+	*type = LittleLong( header[0] );
+	*packedLen = LittleLong( header[1] );
+	*rawLen = LittleLong( header[2] );
+	*time = LittleLong( header[3] );
+
+	if ( *packedLen < 0 || *packedLen > DEMO_BLOCK_PACKED_SIZE || *rawLen < 0 || *rawLen > DEMO_BLOCK_SIZE ) {
+		Com_Printf( "Demo file is corrupt.\n" );
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+CL_UnpackDemoBlock
+
+Unpacks the block whose header was just read into demoBlockData.
+=================
+*/
+static qboolean CL_UnpackDemoBlock( int packedLen, int rawLen ) {
+	uLongf	len = DEMO_BLOCK_SIZE;
+
+	if ( FS_Read( demoPackedData, packedLen, clc.demofile ) != packedLen ) {
+		Com_Printf( "Demo file was truncated.\n" );
+		return qfalse;
+	}
+
+	if ( uncompress( demoBlockData, &len, demoPackedData, packedLen ) != Z_OK || (int)len != rawLen ) {
+		Com_Printf( "Demo file is corrupt.\n" );
+		return qfalse;
+	}
+
+	clc.demoBlockLen = rawLen;
+	clc.demoBlockPos = 0;
+	return qtrue;
+}
+
+/*
+=================
+CL_NextDemoBlock
+
+Moves on to the next messages block, skipping keyframes.
+=================
+*/
+static qboolean CL_NextDemoBlock( void ) {
+	int		type, packedLen, rawLen, time;
+
+	while ( CL_ReadDemoBlockHeader( &type, &packedLen, &rawLen, &time ) ) {
+		if ( type == DEMO_BLOCK_MESSAGES ) {
+			return CL_UnpackDemoBlock( packedLen, rawLen );
+		}
+		if ( type == DEMO_BLOCK_INDEX ) {
+			break;
+		}
+		FS_Seek( clc.demofile, packedLen, FS_SEEK_CUR );
+	}
+
+	return qfalse;
+}
+
+/*
+=================
+CL_ReadDemoData
+
+FS_Read for the demo stream, unpacking container demos on the way.
+=================
+*/
+static int CL_ReadDemoData( void *buffer, int len ) {
+	int		done, n;
+
+	if ( !clc.demoContainer ) {
+		return FS_Read( buffer, len, clc.demofile );
+	}
+
+	for ( done = 0 ; done < len ; done += n ) {
+		if ( clc.demoBlockPos >= clc.demoBlockLen && !CL_NextDemoBlock() ) {
+			break;
+		}
+		n = Q_min( len - done, clc.demoBlockLen - clc.demoBlockPos );
+		Com_Memcpy( (byte *)buffer + done, demoBlockData + clc.demoBlockPos, n );
+		clc.demoBlockPos += n;
+	}
+
+	return done;
+}
+
+/*
+=================
+CL_FindDemoKeyframe
+
+Returns the file offset of the last keyframe at or before time, or 0 if
+there is none.  Uses the index at the end of the file, or walks the block
+headers if the recording never got to write one.
+=================
+*/
+static int CL_FindDemoKeyframe( int time ) {
+	int		type, packedLen, rawLen, blockTime;
+	int		trailer[2];
+	int		i, offset, best = 0;
+
+	if ( FS_Seek( clc.demofile, -(long)sizeof( trailer ), FS_SEEK_END ) == 0
+		&& FS_Read( trailer, sizeof( trailer ), clc.demofile ) == sizeof( trailer )
+		&& LittleLong( trailer[1] ) == DEMO_INDEX_MAGIC ) {
+		FS_Seek( clc.demofile, LittleLong( trailer[0] ), FS_SEEK_SET );
+		if ( CL_ReadDemoBlockHeader( &type, &packedLen, &rawLen, &blockTime ) && type == DEMO_BLOCK_INDEX
+			&& CL_UnpackDemoBlock( packedLen, rawLen ) ) {
+			const int *index = (const int *)demoBlockData;
+
+			for ( i = 0 ; i < rawLen / 8 ; i++ ) {
+				if ( LittleLong( index[i * 2] ) > time ) {
+					break;
+				}
+				best = LittleLong( index[i * 2 + 1] );
+			}
+			return best;
+		}
+	}
+
+	// no index, look at every block
+	FS_Seek( clc.demofile, 8, FS_SEEK_SET );
+	for ( offset = 8 ; CL_ReadDemoBlockHeader( &type, &packedLen, &rawLen, &blockTime ) ; offset += 16 + packedLen ) {
+		if ( type == DEMO_BLOCK_KEYFRAME ) {
+			if ( blockTime > time ) {
+				break;
+			}
+			best = offset;
+		}
+		FS_Seek( clc.demofile, packedLen, FS_SEEK_CUR );
+	}
+
+	return best;
+}
+
+/*
+=================
+CL_SeekDemo
+
+Positions a container demo so that playback starts at the keyframe
+closest before time.
+=================
+*/
+static void CL_SeekDemo( int time ) {
+	int		type, packedLen, rawLen, blockTime;
+	int		offset;
+
+	offset = CL_FindDemoKeyframe( time );
+
+	clc.demoBlockLen = clc.demoBlockPos = 0;
+	if ( !offset ) {
+		FS_Seek( clc.demofile, 8, FS_SEEK_SET );
+		return;
+	}
+
+	// the keyframe holds the gamestate record to start from,
+	// the messages after it pick up with a non-delta snapshot
+	FS_Seek( clc.demofile, offset, FS_SEEK_SET );
+	if ( CL_ReadDemoBlockHeader( &type, &packedLen, &rawLen, &blockTime ) && type == DEMO_BLOCK_KEYFRAME
+		&& CL_UnpackDemoBlock( packedLen, rawLen ) ) {
+		Com_Printf( "Starting demo at %i:%02i\n", blockTime / 60000, ( blockTime / 1000 ) % 60 );
+		return;
+	}
+
+	clc.demoBlockLen = clc.demoBlockPos = 0;
+	FS_Seek( clc.demofile, 8, FS_SEEK_SET );
+}
+
 /*
 =================
 CL_ReadDemoMessage
@@ -475,7 +667,7 @@ void CL_ReadDemoMessage( void ) {
 	}
 
 	// get the sequence number
-	r = FS_Read( &s, 4, clc.demofile);
+	r = CL_ReadDemoData( &s, 4 );
 	if ( r != 4 ) {
 		CL_DemoCompleted ();
 		return;
@@ -486,7 +678,7 @@ void CL_ReadDemoMessage( void ) {
 	MSG_Init( &buf, bufData, sizeof( bufData ) );
 
 	// get the length
-	r = FS_Read (&buf.cursize, 4, clc.demofile);
+	r = CL_ReadDemoData( &buf.cursize, 4 );
 	if ( r != 4 ) {
 		CL_DemoCompleted ();
 		return;
@@ -499,7 +691,7 @@ void CL_ReadDemoMessage( void ) {
 	if ( buf.cursize > buf.maxsize ) {
 		Com_Error (ERR_DROP, "CL_ReadDemoMessage: demoMsglen > MAX_MSGLEN");
 	}
-	r = FS_Read( buf.data, buf.cursize, clc.demofile );
+	r = CL_ReadDemoData( buf.data, buf.cursize );
 	if ( r != buf.cursize ) {
 		Com_Printf( "Demo file was truncated.\n");
 		CL_DemoCompleted ();
@@ -538,6 +730,10 @@ demo <demoname>
 void CL_PlayDemo_f( void ) {
 	char		name[MAX_OSPATH], extension[32];
 	char		*arg;
+	int			seekTime = demoSeekTime;
+
+	// only for this command, whether it gets to play the demo or not
+	demoSeekTime = -1;
 
 	Cvar_Set("demoname", "");
 
@@ -655,6 +851,30 @@ void CL_PlayDemo_f( void ) {
 		return;
 	}
 
+	// compressed server demos keep the same extension, tell them apart by the header
+	{
+		int header[2] = { 0, 0 };
+
+		if ( FS_Read( header, sizeof( header ), clc.demofile ) == sizeof( header )
+			&& LittleLong( header[0] ) == DEMO_CONTAINER_MAGIC ) {
+			if ( LittleLong( header[1] ) != DEMO_CONTAINER_VERSION ) {
+				Com_Printf( "%s has unsupported container version %i.\n", name, LittleLong( header[1] ) );
+				FS_FCloseFile( clc.demofile );
+				clc.demofile = 0;
+				return;
+			}
+			clc.demoContainer = qtrue;
+			if ( seekTime > 0 ) {
+				CL_SeekDemo( seekTime );
+			}
+		} else {
+			FS_Seek( clc.demofile, 0, FS_SEEK_SET );
+			if ( seekTime > 0 ) {
+				Com_Printf( "%s has no keyframes, playing from the start.\n", name );
+			}
+		}
+	}
+
 	Q_strncpyz( clc.demoName, arg, sizeof( clc.demoName ) );
 	Cvar_Set("demoname", arg);
 
@@ -685,6 +905,36 @@ void CL_DemoRestart_f(void) {
 	Cbuf_ExecuteText(EXEC_APPEND, va("demo \"%s\"\n", demoname));
 }
 
+/*
+====================
+CL_DemoSeek_f
+
+demo_seek <seconds>
+
+Restarts the current demo at the last keyframe before the given time.
+Only compressed server demos have keyframes.
+====================
+*/
+void CL_DemoSeek_f( void ) {
+	char *demoname = Cvar_VariableString( "demoname" );
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "demo_seek <seconds>\n" );
+		return;
+	}
+
+	if ( !VALIDSTRING( demoname ) ) {
+		Com_Printf( "No demo available to seek in.\n" );
+		return;
+	}
+
+	demoSeekTime = (int)( atof( Cmd_Argv( 1 ) ) * 1000.0f );
+	if ( demoSeekTime < 0 ) {
+		demoSeekTime = 0;
+	}
+	Cbuf_ExecuteText( EXEC_APPEND, va( "demo \"%s\"\n", demoname ) );
+}
+
 
 /*
 ====================
@@ -3089,6 +3339,7 @@ void CL_Init( void ) {
 	Cmd_AddCommand ("demo", CL_PlayDemo_f, "Playback a demo" );
 	Cmd_SetCommandCompletionFunc( "demo", CL_CompleteDemoName );
 	Cmd_AddCommand ("demo_restart", CL_DemoRestart_f, "Restarts the current or last-played demo" );
+	Cmd_AddCommand ("demo_seek", CL_DemoSeek_f, "Restarts the current demo at a time in seconds" );
 	Cmd_AddCommand ("stoprecord", CL_StopRecord_f, "Stop recording a demo" );
 	Cmd_AddCommand ("configstrings", CL_Configstrings_f, "Prints the configstrings list" );
 	Cmd_AddCommand ("clientinfo", CL_Clientinfo_f, "Prints the userinfo variables" );
@@ -3168,6 +3419,7 @@ void CL_Shutdown( void ) {
 	Cmd_RemoveCommand ("record");
 	Cmd_RemoveCommand ("demo");
 	Cmd_RemoveCommand ("demo_restart");
+	Cmd_RemoveCommand ("demo_seek");
 	Cmd_RemoveCommand ("cinematic");
 	Cmd_RemoveCommand ("stoprecord");
 	Cmd_RemoveCommand ("connect");
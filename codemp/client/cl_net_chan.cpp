@@ -160,7 +160,7 @@ void CL_Netchan_Transmit( netchan_t *chan, msg_t* msg ) {
 	Netchan_Transmit( chan, msg->cursize, msg->data );
 }
 
-extern 	int oldsize;
+extern thread_local int oldsize;
 int newsize = 0;
 
 /*
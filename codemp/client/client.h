@@ -255,6 +255,9 @@ typedef struct clientConnection_s {
 	qboolean	demowaiting;	// don't record until a non-delta message is received
 	qboolean	firstDemoFrameSkipped;
 	fileHandle_t	demofile;
+	qboolean	demoContainer;		// compressed server demo, see qcommon.h
+	int			demoBlockLen;		// unpacked bytes of the current container block
+	int			demoBlockPos;
 
 	int			timeDemoFrames;		// counter of rendered frames
 	int			timeDemoStart;		// cls.realtime before first frame
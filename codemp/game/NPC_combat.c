@@ -2507,6 +2507,8 @@ void SP_point_combat( gentity_t *self )
 	G_FreeEntity(self);
 }
 
+static navCombatPoint_t navCombatPoints[MAX_COMBAT_POINTS];
+
 void CP_FindCombatPointWaypoints( void )
 {
 	int i;
@@ -2520,9 +2522,52 @@ void CP_FindCombatPointWaypoints( void )
 			Com_Printf( S_COLOR_RED"ERROR: Combat Point at %s has no waypoint!\n", vtos(level.combatPoints[i].origin) );
 		}
 #endif
+		VectorCopy( level.combatPoints[i].origin, navCombatPoints[i].origin );
+		navCombatPoints[i].waypoint = level.combatPoints[i].waypoint;
+	}
+
+	//so they get saved with the routes
+	if ( gameApiVersion >= 2 && trap->Nav_StoreCombatPoints )
+	{
+		trap->Nav_StoreCombatPoints( navCombatPoints, level.numCombatPoints );
 	}
 }
 
+/*
+-------------------------
+CP_RestoreCombatPointWaypoints
+
+Takes the combat point waypoints from the loaded .nav file, returns
+qfalse if they have to be found again
+-------------------------
+*/
+qboolean CP_RestoreCombatPointWaypoints( void )
+{
+	int i;
+
+	if ( gameApiVersion < 2 || !trap->Nav_RestoreCombatPoints || !level.numCombatPoints )
+	{
+		return qfalse;
+	}
+
+	for ( i = 0; i < level.numCombatPoints; i++ )
+	{
+		VectorCopy( level.combatPoints[i].origin, navCombatPoints[i].origin );
+	}
+
+	if ( !trap->Nav_RestoreCombatPoints( navCombatPoints, level.numCombatPoints ) )
+	{
+		return qfalse;
+	}
+
+	for ( i = 0; i < level.numCombatPoints; i++ )
+	{
+		level.combatPoints[i].waypoint = navCombatPoints[i].waypoint;
+	}
+
+	return qtrue;
+}
+
 
 /*
 -------------------------
@@ -58,6 +58,9 @@ static const cvarTable_t gameCvarTable[] = {
 };
 static const size_t gameCvarTableSize = ARRAY_LEN( gameCvarTable );
 
+// sync point for trap->Cvar_Changes, 0 makes the first update check all cvars
+static int cvarChangeSequence;
+
 void G_RegisterCvars( void ) {
 	size_t i = 0;
 	const cvarTable_t *cv = NULL;
@@ -67,23 +70,46 @@ void G_RegisterCvars( void ) {
 		if ( cv->update )
 			cv->update();
 	}
+
+	cvarChangeSequence = 0;
+}
+
+static void G_UpdateCvar( const cvarTable_t *cv ) {
+	int modCount = cv->vmCvar->modificationCount;
+
+	trap->Cvar_Update( cv->vmCvar );
+	if ( cv->vmCvar->modificationCount != modCount ) {
+		if ( cv->update )
+			cv->update();
+
+		if ( cv->trackChange )
+			trap->SendServerCommand( -1, va("print \"Server: %s changed to %s\n\"", cv->cvarName, cv->vmCvar->string ) );
+	}
 }
 
 void G_UpdateCvars( void ) {
 	size_t i = 0;
 	const cvarTable_t *cv = NULL;
 
-	for ( i=0, cv=gameCvarTable; i<gameCvarTableSize; i++, cv++ ) {
-		if ( cv->vmCvar ) {
-			int modCount = cv->vmCvar->modificationCount;
-			trap->Cvar_Update( cv->vmCvar );
-			if ( cv->vmCvar->modificationCount != modCount ) {
-				if ( cv->update )
-					cv->update();
-
-				if ( cv->trackChange )
-					trap->SendServerCommand( -1, va("print \"Server: %s changed to %s\n\"", cv->cvarName, cv->vmCvar->string ) );
+	// only look at the cvars the engine says have changed
+	if ( gameApiVersion >= 2 && trap->Cvar_Changes ) {
+		int handles[64];
+		int numChanged = trap->Cvar_Changes( &cvarChangeSequence, handles, ARRAY_LEN( handles ) );
+		int j;
+
+		if ( numChanged >= 0 ) {
+			for ( j=0; j<numChanged; j++ ) {
+				for ( i=0, cv=gameCvarTable; i<gameCvarTableSize; i++, cv++ ) {
+					if ( cv->vmCvar && cv->vmCvar->handle == handles[j] )
+						G_UpdateCvar( cv );
+				}
 			}
+			return;
 		}
 	}
+
+	for ( i=0, cv=gameCvarTable; i<gameCvarTableSize; i++, cv++ ) {
+		if ( cv->vmCvar )
+			G_UpdateCvar( cv );
+	}
 }
@@ -63,6 +63,7 @@ qboolean G_EntIsDoor( int entityNum );
 qboolean G_EntIsBreakable( int entityNum );
 qboolean G_EntIsRemovableUsable( int entNum );
 void CP_FindCombatPointWaypoints( void );
+qboolean CP_RestoreCombatPointWaypoints( void );
 
 /*
 ================
@@ -375,8 +376,11 @@ void G_InitGame( int levelTime, int randomSeed, int restart ) {
 		//OR: always do a navigator.CheckBlockedEdges() on map startup after nav-load/calc-paths
 		//navigator.pathsCalculated = qtrue;//just to be safe?  Does this get saved out?  No... assumed
 		trap->Nav_SetPathsCalculated(qtrue);
-		//need to do this, because combatpoint waypoints aren't saved out...?
-		CP_FindCombatPointWaypoints();
+		//combatpoint waypoints are saved out with the routes, older .nav files don't have them
+		if ( !CP_RestoreCombatPointWaypoints() )
+		{
+			CP_FindCombatPointWaypoints();
+		}
 		navCalcPathTime = 0;
 
 		/*
@@ -3555,6 +3559,7 @@ GetModuleAPI
 */
 
 gameImport_t *trap = NULL;
+int gameApiVersion = 0;
 
 Q_EXPORT gameExport_t* QDECL GetModuleAPI( int apiVersion, gameImport_t *import )
 {
@@ -3567,10 +3572,11 @@ Q_EXPORT gameExport_t* QDECL GetModuleAPI( int apiVersion, gameImport_t *import
 
 	memset( &ge, 0, sizeof( ge ) );
 
-	if ( apiVersion != GAME_API_VERSION ) {
-		trap->Print( "Mismatched GAME_API_VERSION: expected %i, got %i\n", GAME_API_VERSION, apiVersion );
+	if ( apiVersion < GAME_API_VERSION_MIN || apiVersion > GAME_API_VERSION ) {
+		trap->Print( "Mismatched GAME_API_VERSION: expected %i to %i, got %i\n", GAME_API_VERSION_MIN, GAME_API_VERSION, apiVersion );
 		return NULL;
 	}
+	gameApiVersion = apiVersion;
 
 	ge.InitGame							= G_InitGame;
 	ge.ShutdownGame						= G_ShutdownGame;
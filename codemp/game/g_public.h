@@ -29,7 +29,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #define Q3_INFINITE			16777216
 
-#define	GAME_API_VERSION	1
+#define	GAME_API_VERSION		2
+#define	GAME_API_VERSION_MIN	1	// engines without the version 2 imports, see gameApiVersion
 
 // entity->svFlags
 // the server does not know how to interpret most of the values
@@ -757,6 +758,12 @@ typedef enum gameExportLegacy_e {
 	GAME_GETITEMINDEXBYTAG
 } gameExportLegacy_t;
 
+// combat point waypoint stored with the routes in the .nav file
+typedef struct navCombatPoint_s {
+	vec3_t		origin;
+	int			waypoint;
+} navCombatPoint_t;
+
 typedef struct gameImport_s {
 	// misc
 	void		(*Print)								( const char *msg, ... );
@@ -1093,6 +1100,17 @@ typedef struct gameImport_s {
 	void		(*G2API_CleanEntAttachments)			( void );
 	qboolean	(*G2API_OverrideServer)					( void *serverInstance );
 	void		(*G2API_GetSurfaceName)					( void *ghoul2, int surfNumber, int modelIndex, char *fillBuf );
+
+	// GAME_API_VERSION 2, an older engine's struct ends before these
+
+	// combat point waypoints to write with the next Nav_Save, restore
+	// fills in the waypoints and fails unless all origins match
+	void		(*Nav_StoreCombatPoints)				( const navCombatPoint_t *points, int numPoints );
+	qboolean	(*Nav_RestoreCombatPoints)				( navCombatPoint_t *points, int numPoints );
+
+	// handles of the cvars changed since *sequence, returns -1 when all of
+	// them have to be updated
+	int			(*Cvar_Changes)							( int *sequence, int *handles, int maxHandles );
 } gameImport_t;
 
 typedef struct gameExport_s {
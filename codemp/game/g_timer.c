@@ -27,39 +27,287 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "g_local.h"
 //typedef map		< string, int >	timer_m;
 
-#define MAX_GTIMERS	16384
+/*
+Identifiers are interned once into integer keys, case insensitive like the
+old list search. Most identifiers are literals, so the key of the last
+identifier seen at an address is cached and only checked with a strcmp.
+Every entity keeps its timers in a small open addressed
+table of keys and times, carved out of one pool in power of two blocks.
+Freed blocks are reused for tables of the same size, and when the pool
+runs out the tables are moved together to get the free blocks back.
+*/
+
+#define MAX_GTIMERS			16384
+#define MAX_GTIMER_SLOTS	(MAX_GTIMERS*4)		// tables are at most 3/4 full right after growing
+#define MIN_GTIMER_BLOCK	8					// slots, table sizes double from here
+#define NUM_GTIMER_SIZES	8					// up to 1024 slots per entity
+
+#define MAX_TIMER_NAMES		1024
+#define TIMER_NAME_HASH		(MAX_TIMER_NAMES*2)
+#define TIMER_NAME_CHARS	(MAX_TIMER_NAMES*24)
+#define TIMER_KEY_CACHE		256
 
 typedef struct gtimer_s
 {
-	const char *name;
+	int key;				// 0 for an empty slot
 	int time;
-	struct gtimer_s *next;	// In either free list or current list
 } gtimer_t;
 
-gtimer_t g_timerPool[ MAX_GTIMERS ];
-gtimer_t *g_timers[ MAX_GENTITIES ];
-gtimer_t *g_timerFreeList;
+typedef struct gtimerTable_s
+{
+	gtimer_t *slots;		// NULL without any timers
+	int size;				// index into the block sizes
+	int count;
+} gtimerTable_t;
+
+typedef struct timerName_s
+{
+	const char *name;
+	unsigned int hash;
+	int lookups;			// with g_timerProfile
+} timerName_t;
+
+typedef struct timerKeyCache_s
+{
+	const char *identifier;
+	int key;
+} timerKeyCache_t;
+
+static gtimer_t g_timerPool[ MAX_GTIMER_SLOTS ];
+static int g_timerPoolUsed;
+static gtimer_t *g_timerFreeBlocks[ NUM_GTIMER_SIZES ];	// first slot of each free block links the next one
+static gtimerTable_t g_timers[ MAX_GENTITIES ];
+static qboolean g_timerPoolWarned;
+
+static timerName_t g_timerNames[ MAX_TIMER_NAMES ];		// key - 1
+static int g_numTimerNames;
+static int g_timerNameHash[ TIMER_NAME_HASH ];				// keys, 0 for empty
+static char g_timerNameChars[ TIMER_NAME_CHARS ];
+static int g_timerNameCharsUsed;
+static qboolean g_timerNamesWarned;
+static timerKeyCache_t g_timerKeyCache[ TIMER_KEY_CACHE ];
 
 /*
 -------------------------
-TIMER_Clear
+TIMER_HashName
 -------------------------
 */
 
-void TIMER_Clear( void )
+static unsigned int TIMER_HashName( const char *name )
+{
+	unsigned int hash = 2166136261u;
+	int c;
+
+	while ( (c = *name++) != 0 )
+	{
+		if ( c >= 'A' && c <= 'Z' )
+		{
+			c += 'a' - 'A';
+		}
+		hash = (hash ^ c) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+-------------------------
+TIMER_Intern
+
+Returns the key of an identifier, 0 when no more
+identifiers fit
+-------------------------
+*/
+
+static int TIMER_Intern( const char *identifier )
+{
+	unsigned int hash = TIMER_HashName( identifier );
+	int i = hash & (TIMER_NAME_HASH-1);
+	int key, len;
+
+	while ( (key = g_timerNameHash[i]) != 0 )
+	{
+		timerName_t *n = &g_timerNames[key-1];
+
+		if ( n->hash == hash && !Q_stricmp( n->name, identifier ) )
+		{
+			return key;
+		}
+		i = (i + 1) & (TIMER_NAME_HASH-1);
+	}
+
+	len = strlen( identifier ) + 1;
+	if ( g_numTimerNames >= MAX_TIMER_NAMES || g_timerNameCharsUsed + len > TIMER_NAME_CHARS )
+	{
+		if ( !g_timerNamesWarned )
+		{
+			Com_Printf( S_COLOR_YELLOW"WARNING: out of timer identifiers, ignoring timer %s\n", identifier );
+			g_timerNamesWarned = qtrue;
+		}
+		return 0;
+	}
+
+	// copied, the identifier doesn't have to be a literal
+	memcpy( &g_timerNameChars[g_timerNameCharsUsed], identifier, len );
+	g_timerNames[g_numTimerNames].name = &g_timerNameChars[g_timerNameCharsUsed];
+	g_timerNames[g_numTimerNames].hash = hash;
+	g_timerNames[g_numTimerNames].lookups = 0;
+	g_timerNameCharsUsed += len;
+
+	key = ++g_numTimerNames;
+	g_timerNameHash[i] = key;
+	return key;
+}
+
+/*
+-------------------------
+TIMER_Key
+
+Interns the identifier and counts the lookup when profiling.
+The text is still compared on a cache hit, the identifier may
+be a buffer that was reused for another name.
+-------------------------
+*/
+
+static int TIMER_Key( const char *identifier )
 {
-	int i;
-	for (i = 0; i < MAX_GENTITIES; i++)
+	size_t address = (size_t)identifier;
+	timerKeyCache_t *cache = &g_timerKeyCache[ (address ^ (address >> 8)) & (TIMER_KEY_CACHE-1) ];
+	int key;
+
+	if ( cache->identifier == identifier && !strcmp( identifier, g_timerNames[cache->key-1].name ) )
+	{
+		key = cache->key;
+	}
+	else
+	{
+		// differently cased spellings of a name always end up here
+		key = TIMER_Intern( identifier );
+		if ( key )
+		{
+			cache->identifier = identifier;
+			cache->key = key;
+		}
+	}
+
+	if ( key && g_timerProfile.integer )
 	{
-		g_timers[i] = NULL;
+		g_timerNames[key-1].lookups++;
 	}
+	return key;
+}
+
+static QINLINE int TIMER_BlockSlots( int size )
+{
+	return MIN_GTIMER_BLOCK << size;
+}
+
+static QINLINE int TIMER_Slot( int key, int mask )
+{
+	return (int)((unsigned int)key * 2654435761u) & mask;
+}
+
+static int TIMER_TableAddressCmp( const void *a, const void *b )
+{
+	return (int)(g_timers[*(const int *)a].slots - g_timers[*(const int *)b].slots);
+}
+
+/*
+-------------------------
+TIMER_CompactPool
+
+Moves every table down to the start of the pool,
+so all the free blocks become one free range
+-------------------------
+*/
+
+static void TIMER_CompactPool( void )
+{
+	static int order[ MAX_GENTITIES ];
+	int i, numTables = 0, used = 0;
+
+	for ( i = 0; i < MAX_GENTITIES; i++ )
+	{
+		if ( g_timers[i].slots )
+		{
+			order[numTables++] = i;
+		}
+	}
+
+	// in pool order, a table never moves over one that still has to move
+	qsort( order, numTables, sizeof( order[0] ), TIMER_TableAddressCmp );
+	for ( i = 0; i < numTables; i++ )
+	{
+		gtimerTable_t *table = &g_timers[order[i]];
+		int slots = TIMER_BlockSlots( table->size );
+
+		memmove( &g_timerPool[used], table->slots, slots * sizeof( gtimer_t ) );
+		table->slots = &g_timerPool[used];
+		used += slots;
+	}
+
+	memset( g_timerFreeBlocks, 0, sizeof( g_timerFreeBlocks ) );
+	g_timerPoolUsed = used;
+}
+
+/*
+-------------------------
+TIMER_AllocBlock
+
+May move the other tables
+-------------------------
+*/
+
+static gtimer_t *TIMER_AllocBlock( int size )
+{
+	gtimer_t *block = g_timerFreeBlocks[size];
+	int slots = TIMER_BlockSlots( size );
 
-	for (i = 0; i < MAX_GTIMERS - 1; i++)
+	if ( block )
+	{
+		g_timerFreeBlocks[size] = *(gtimer_t **)block;
+	}
+	else
 	{
-		g_timerPool[i].next = &g_timerPool[i+1];
+		if ( g_timerPoolUsed + slots > MAX_GTIMER_SLOTS )
+		{
+			TIMER_CompactPool();
+		}
+		if ( g_timerPoolUsed + slots > MAX_GTIMER_SLOTS )
+		{
+			return NULL;
+		}
+		block = &g_timerPool[g_timerPoolUsed];
+		g_timerPoolUsed += slots;
 	}
-	g_timerPool[MAX_GTIMERS-1].next = NULL;
-	g_timerFreeList = &g_timerPool[0];
+
+	memset( block, 0, slots * sizeof( gtimer_t ) );
+	return block;
+}
+
+/*
+-------------------------
+TIMER_FreeBlock
+-------------------------
+*/
+
+static void TIMER_FreeBlock( gtimer_t *block, int size )
+{
+	*(gtimer_t **)block = g_timerFreeBlocks[size];
+	g_timerFreeBlocks[size] = block;
+}
+
+/*
+-------------------------
+TIMER_Clear
+-------------------------
+*/
+
+void TIMER_Clear( void )
+{
+	memset( g_timers, 0, sizeof( g_timers ) );
+	memset( g_timerFreeBlocks, 0, sizeof( g_timerFreeBlocks ) );
+	g_timerPoolUsed = 0;
+	g_timerPoolWarned = qfalse;
 }
 
 /*
@@ -73,73 +321,110 @@ void TIMER_Clear2( gentity_t *ent )
 	// rudimentary safety checks, might be other things to check?
 	if ( ent && ent->s.number >= 0 && ent->s.number < MAX_GENTITIES )
 	{
-		gtimer_t *p = g_timers[ent->s.number];
+		gtimerTable_t *table = &g_timers[ent->s.number];
 
 		// No timers at all -> do nothing
-		if (!p)
+		if (!table->slots)
 		{
 			return;
 		}
 
-		// Find the end of this ents timer list
-		while (p->next)
-		{
-			p = p->next;
-		}
-
-		// Splice the lists
-		p->next = g_timerFreeList;
-		g_timerFreeList = g_timers[ent->s.number];
-		g_timers[ent->s.number] = NULL;
+		TIMER_FreeBlock( table->slots, table->size );
+		table->slots = NULL;
+		table->size = 0;
+		table->count = 0;
 		return;
 	}
 }
 
-
-//New C "lookup" func.
-//Returns existing timer in array if
-gtimer_t *TIMER_GetNew(int num, const char *identifier)
+//Returns the timer of this key, NULL if the entity doesn't have it
+static gtimer_t *TIMER_Find( gtimerTable_t *table, int key )
 {
-	gtimer_t *p = g_timers[num];
+	int mask, i;
 
-	// Search for an existing timer with this name
-	while (p)
+	if ( !table->slots || !key )
 	{
-		if (!Q_stricmp(p->name, identifier))
-		{ // Found it
-			return p;
-		}
+		return NULL;
+	}
 
-		p = p->next;
+	mask = TIMER_BlockSlots( table->size ) - 1;
+	for ( i = TIMER_Slot( key, mask ); table->slots[i].key; i = (i + 1) & mask )
+	{
+		if ( table->slots[i].key == key )
+		{
+			return &table->slots[i];
+		}
 	}
+	return NULL;
+}
 
-	// No existing timer with this name was found, so grab one from the free list
-	if (!g_timerFreeList)
-		return NULL;
+//Puts a key into a table that is known to have room for it and not to contain it
+static gtimer_t *TIMER_Insert( gtimer_t *slots, int mask, int key )
+{
+	int i = TIMER_Slot( key, mask );
 
-	p = g_timerFreeList;
-	g_timerFreeList = g_timerFreeList->next;
-	p->next = g_timers[num];
-	g_timers[num] = p;
-	return p;
+	while ( slots[i].key )
+	{
+		i = (i + 1) & mask;
+	}
+	slots[i].key = key;
+	return &slots[i];
 }
 
-//don't return the first free if it doesn't already exist, return null.
-gtimer_t *TIMER_GetExisting(int num, const char *identifier)
+//Returns the timer of this key, adding it if the entity doesn't have it yet.
+//NULL when the pool is exhausted.
+static gtimer_t *TIMER_GetNew( int num, int key )
 {
-	gtimer_t *p = g_timers[num];
+	gtimerTable_t *table = &g_timers[num];
+	gtimer_t *timer = TIMER_Find( table, key );
+	int slots;
+
+	if ( timer || !key )
+	{
+		return timer;
+	}
 
-	while (p)
+	// keep the table at most three quarters full
+	slots = table->slots ? TIMER_BlockSlots( table->size ) : 0;
+	if ( (table->count + 1) * 4 > slots * 3 )
 	{
-		if (!Q_stricmp(p->name, identifier))
-		{ // Found it
-			return p;
+		int size = table->slots ? table->size + 1 : 0;
+		gtimer_t *block;
+		int i;
+
+		if ( size >= NUM_GTIMER_SIZES || (block = TIMER_AllocBlock( size )) == NULL )
+		{
+			if ( !g_timerPoolWarned )
+			{
+				Com_Printf( S_COLOR_YELLOW"WARNING: out of timer slots, dropping timer %s of entity %d\n", g_timerNames[key-1].name, num );
+				g_timerPoolWarned = qtrue;
+			}
+			return NULL;
 		}
 
-		p = p->next;
+		for ( i = 0; i < slots; i++ )
+		{
+			if ( table->slots[i].key )
+			{
+				*TIMER_Insert( block, TIMER_BlockSlots( size ) - 1, table->slots[i].key ) = table->slots[i];
+			}
+		}
+		if ( table->slots )
+		{
+			TIMER_FreeBlock( table->slots, table->size );
+		}
+		table->slots = block;
+		table->size = size;
 	}
 
-	return NULL;
+	table->count++;
+	return TIMER_Insert( table->slots, TIMER_BlockSlots( table->size ) - 1, key );
+}
+
+//don't return the first free if it doesn't already exist, return null.
+static gtimer_t *TIMER_GetExisting( int num, const char *identifier )
+{
+	return TIMER_Find( &g_timers[num], TIMER_Key( identifier ) );
 }
 
 /*
@@ -150,13 +435,12 @@ TIMER_Set
 
 void TIMER_Set( gentity_t *ent, const char *identifier, int duration )
 {
-	gtimer_t *timer = TIMER_GetNew(ent->s.number, identifier);
+	gtimer_t *timer = TIMER_GetNew(ent->s.number, TIMER_Key(identifier));
 
 	if (!timer)
 	{
 		return;
 	}
-	timer->name = identifier;
 	timer->time = level.time + duration;
 }
 
@@ -200,36 +484,40 @@ qboolean TIMER_Done( gentity_t *ent, const char *identifier )
 -------------------------
 TIMER_RemoveHelper
 
-Scans an entities timer list to remove a given
-timer from the list and put it on the free list
+Takes a given timer out of an entities table,
+moving back the timers probed past it
 
 Doesn't do much error checking, only called below
 -------------------------
 */
-void TIMER_RemoveHelper( int num, gtimer_t *timer )
+static void TIMER_RemoveHelper( int num, gtimer_t *timer )
 {
-	gtimer_t *p = g_timers[num];
+	gtimerTable_t *table = &g_timers[num];
+	int mask = TIMER_BlockSlots( table->size ) - 1;
+	int hole = timer - table->slots;
+	int i, home;
 
-	// Special case: first timer in list
-	if (p == timer)
+	if (!--table->count)
 	{
-		g_timers[num] = g_timers[num]->next;
-		p->next = g_timerFreeList;
-		g_timerFreeList = p;
+		// Last one, put the block back on the free list
+		TIMER_FreeBlock( table->slots, table->size );
+		table->slots = NULL;
+		table->size = 0;
 		return;
 	}
 
-	// Find the predecessor
-	while (p->next != timer)
+	for ( i = (hole + 1) & mask; table->slots[i].key; i = (i + 1) & mask )
 	{
-		p = p->next;
-	}
+		home = TIMER_Slot( table->slots[i].key, mask );
 
-	// Rewire
-	p->next = p->next->next;
-	timer->next = g_timerFreeList;
-	g_timerFreeList = timer;
-	return;
+		// move it into the hole unless its home lies cyclically in (hole, i]
+		if ( ((i - home) & mask) >= ((i - hole) & mask) )
+		{
+			table->slots[hole] = table->slots[i];
+			hole = i;
+		}
+	}
+	table->slots[hole].key = 0;
 }
 
 /*
@@ -256,7 +544,7 @@ qboolean TIMER_Done2( gentity_t *ent, const char *identifier, qboolean remove )
 
 	if (res && remove)
 	{
-		// Put it back on the free list
+		// Take it out of the table
 		TIMER_RemoveHelper(ent->s.number, timer);
 	}
 
@@ -295,7 +583,7 @@ void TIMER_Remove( gentity_t *ent, const char *identifier )
 		return;
 	}
 
-	// Put it back on the free list
+	// Take it out of the table
 	TIMER_RemoveHelper(ent->s.number, timer);
 }
 
@@ -314,3 +602,53 @@ qboolean TIMER_Start( gentity_t *self, const char *identifier, int duration )
 	}
 	return qfalse;
 }
+
+static int TIMER_LookupsCmp( const void *a, const void *b )
+{
+	return g_timerNames[*(const int *)b].lookups - g_timerNames[*(const int *)a].lookups;
+}
+
+/*
+-------------------------
+Svcmd_TimerProfile_f
+
+timerprofile [reset]
+
+Lists how often each identifier was looked up while
+g_timerProfile was on, most used first
+-------------------------
+*/
+void Svcmd_TimerProfile_f( void )
+{
+	static int order[MAX_TIMER_NAMES];
+	char arg[MAX_TOKEN_CHARS];
+	int i, total = 0;
+
+	trap->Argv( 1, arg, sizeof( arg ) );
+	if ( !Q_stricmp( arg, "reset" ) )
+	{
+		for ( i = 0; i < g_numTimerNames; i++ )
+		{
+			g_timerNames[i].lookups = 0;
+		}
+		return;
+	}
+
+	for ( i = 0; i < g_numTimerNames; i++ )
+	{
+		order[i] = i;
+		total += g_timerNames[i].lookups;
+	}
+	qsort( order, g_numTimerNames, sizeof( order[0] ), TIMER_LookupsCmp );
+
+	for ( i = 0; i < g_numTimerNames && g_timerNames[order[i]].lookups; i++ )
+	{
+		timerName_t *n = &g_timerNames[order[i]];
+		trap->Print( "%10i %5.1f%% %s\n", n->lookups, n->lookups * 100.0f / total, n->name );
+	}
+	trap->Print( "%i lookups, %i identifiers, %i of %i timer slots in use\n", total, g_numTimerNames, g_timerPoolUsed, MAX_GTIMER_SLOTS );
+	if ( !g_timerProfile.integer )
+	{
+		trap->Print( "Lookups are only counted with g_timerProfile 1\n" );
+	}
+}
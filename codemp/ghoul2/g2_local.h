@@ -260,6 +260,7 @@ void		SaveGhoul2InfoArray();
 
 void		G2API_SetTime(int currentTime, int clock);
 int			G2API_GetTime(int argTime);
+void		G2API_EvaluateSkeletons(CGhoul2Info_v **ghoul2List, const vec3_t *scales, int count);
 
 qhandle_t	G2API_PrecacheGhoul2Model(const char *fileName);
 
@@ -365,6 +366,7 @@ extern qboolean gG2_GBMNoReconstruct;
 extern qboolean gG2_GBMUseSPMethod;
 // From tr_ghoul2.cpp
 void		G2_ConstructGhoulSkeleton( CGhoul2Info_v &ghoul2,const int frameNum,bool checkForNewOrigin,const vec3_t scale);
+void		G2_EvaluateSkeletons( CGhoul2Info_v **ghoul2List, const vec3_t *scales, int count, int time );
 
 qboolean	G2API_SkinlessModel(CGhoul2Info_v& ghoul2, int modelIndex);
 
@@ -222,6 +222,9 @@ void ICARUS_Shutdown( void )
 		iICARUS->Delete();
 		iICARUS = NULL;
 	}
+
+	//Everything is freed, so the pools can go back to the zone
+	ICARUS_PoolRelease();
 }
 
 /*
@@ -22,18 +22,257 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include "icarus.h"
 
+/*
+=============================================================================
+
+Blocks, members, sequences and tasks are small and come and go all the
+time, so they are carved out of slabs per size class instead of going
+through the zone one by one. Freed chunks go back on the free list of
+their class, the slabs themselves are only given back to the zone when
+the ICARUS instance shuts down with no chunks of the class in use.
+
+=============================================================================
+*/
+
+#define ICARUS_SLAB_SIZE		( 32 * 1024 )
+#define ICARUS_SLAB_HEADER		16			// keeps the chunks 16 byte aligned
+#define ICARUS_MALLOC_HEADER	8			// size class of an ICARUS_Malloc block, -1 for the zone
+
+static const int icarusPoolSizes[] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+
+#define ICARUS_POOL_CLASSES		ARRAY_LEN( icarusPoolSizes )
+#define ICARUS_POOL_MAX_SIZE	256
+
+// size class by size in 16 byte steps
+static const byte icarusPoolClass[ICARUS_POOL_MAX_SIZE / 16 + 1] = { 0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7 };
+
+typedef struct icarusChunk_s {
+	struct icarusChunk_s	*next;
+} icarusChunk_t;
+
+typedef struct icarusSlab_s {
+	struct icarusSlab_s		*next;
+} icarusSlab_t;
+
+typedef struct icarusPool_s {
+	icarusChunk_t	*freeList;
+	icarusSlab_t	*slabs;
+	byte			*bump;			// unused end of the newest slab
+	byte			*bumpEnd;
+	int				numSlabs;
+	int				numUsed;
+	int				peakUsed;
+	int				numAllocs;
+} icarusPool_t;
+
+static icarusPool_t	icarusPools[ICARUS_POOL_CLASSES];
+
+/*
+==================
+ICARUS_PoolAllocClass
+==================
+*/
+static void *ICARUS_PoolAllocClass( int poolClass )
+{
+	icarusPool_t	*pool = &icarusPools[poolClass];
+	void			*pMem;
+
+	if ( pool->freeList )
+	{
+		pMem = pool->freeList;
+		pool->freeList = pool->freeList->next;
+	}
+	else
+	{
+		if ( pool->bump + icarusPoolSizes[poolClass] > pool->bumpEnd )
+		{
+			icarusSlab_t *slab = (icarusSlab_t *)Z_Malloc( ICARUS_SLAB_SIZE, TAG_ICARUS5, qfalse );
+
+			slab->next = pool->slabs;
+			pool->slabs = slab;
+			pool->numSlabs++;
+
+			pool->bump = (byte *)slab + ICARUS_SLAB_HEADER;
+			pool->bumpEnd = (byte *)slab + ICARUS_SLAB_SIZE;
+		}
+
+		pMem = pool->bump;
+		pool->bump += icarusPoolSizes[poolClass];
+	}
+
+	pool->numAllocs++;
+	if ( ++pool->numUsed > pool->peakUsed )
+	{
+		pool->peakUsed = pool->numUsed;
+	}
+
+	return pMem;
+}
+
+/*
+==================
+ICARUS_PoolFreeClass
+==================
+*/
+static void ICARUS_PoolFreeClass( void *pMem, int poolClass )
+{
+	icarusPool_t	*pool = &icarusPools[poolClass];
+	icarusChunk_t	*chunk = (icarusChunk_t *)pMem;
+
+	chunk->next = pool->freeList;
+	pool->freeList = chunk;
+	pool->numUsed--;
+}
+
+/*
+==================
+ICARUS_PoolAlloc
+
+Zero filled memory for the ICARUS classes, which know their size again
+when they are deleted.
+==================
+*/
+void *ICARUS_PoolAlloc( size_t size )
+{
+	if ( size > ICARUS_POOL_MAX_SIZE )
+	{
+		return Z_Malloc( size, TAG_ICARUS5, qtrue );
+	}
+
+	void *pMem = ICARUS_PoolAllocClass( icarusPoolClass[ ( size + 15 ) >> 4 ] );
+	memset( pMem, 0, size );
+	return pMem;
+}
+
+/*
+==================
+ICARUS_PoolFree
+==================
+*/
+void ICARUS_PoolFree( void *pMem, size_t size )
+{
+	if ( !pMem )
+	{
+		return;
+	}
+
+	if ( size > ICARUS_POOL_MAX_SIZE )
+	{
+		Z_Free( pMem );
+		return;
+	}
+
+	ICARUS_PoolFreeClass( pMem, icarusPoolClass[ ( size + 15 ) >> 4 ] );
+}
+
+/*
+==================
+ICARUS_PoolRelease
+
+Gives the slabs of every class without chunks in use back to the zone.
+==================
+*/
+void ICARUS_PoolRelease( void )
+{
+	for ( size_t i = 0; i < ICARUS_POOL_CLASSES; i++ )
+	{
+		icarusPool_t	*pool = &icarusPools[i];
+
+		if ( pool->numUsed )
+		{
+			Com_DPrintf( "ICARUS_PoolRelease: %d blocks of %d bytes still in use\n", pool->numUsed, icarusPoolSizes[i] );
+			continue;
+		}
+
+		while ( pool->slabs )
+		{
+			icarusSlab_t *next = pool->slabs->next;
+
+			Z_Free( pool->slabs );
+			pool->slabs = next;
+		}
+
+		pool->freeList = NULL;
+		pool->bump = pool->bumpEnd = NULL;
+		pool->numSlabs = 0;
+	}
+}
+
+/*
+==================
+ICARUS_PoolStats
+==================
+*/
+void ICARUS_PoolStats( void )
+{
+	int		numSlabs = 0;
+
+	for ( size_t i = 0; i < ICARUS_POOL_CLASSES; i++ )
+	{
+		numSlabs += icarusPools[i].numSlabs;
+	}
+
+	if ( !numSlabs )
+	{
+		return;
+	}
+
+	Com_Printf( "ICARUS pools use %d slabs (%.2fMB)\n", numSlabs, (float)numSlabs * ICARUS_SLAB_SIZE / 1024.0f / 1024.0f );
+	Com_Printf( "%6s %6s %8s %8s %10s\n", "size", "slabs", "used", "peak", "allocs" );
+
+	for ( size_t i = 0; i < ICARUS_POOL_CLASSES; i++ )
+	{
+		const icarusPool_t	*pool = &icarusPools[i];
+
+		if ( pool->numSlabs )
+		{
+			Com_Printf( "%6d %6d %8d %8d %10d\n", icarusPoolSizes[i], pool->numSlabs, pool->numUsed, pool->peakUsed, pool->numAllocs );
+		}
+	}
+}
+
 // leave these two as standard mallocs for the moment, there's something weird happening in ICARUS...
 //
 void *ICARUS_Malloc(int iSize)
 {
 	//return gi.Malloc(iSize, TAG_ICARUS);
 	//return malloc(iSize);
-	return Z_Malloc(iSize, TAG_ICARUS5, qfalse);
+	int		iTotal = iSize + ICARUS_MALLOC_HEADER;
+	int		*pHeader;
+
+	if ( iTotal <= ICARUS_POOL_MAX_SIZE )
+	{
+		int poolClass = icarusPoolClass[ ( iTotal + 15 ) >> 4 ];
+
+		pHeader = (int *)ICARUS_PoolAllocClass( poolClass );
+		*pHeader = poolClass;
+	}
+	else
+	{
+		pHeader = (int *)Z_Malloc( iTotal, TAG_ICARUS5, qfalse );
+		*pHeader = -1;
+	}
+
+	return (byte *)pHeader + ICARUS_MALLOC_HEADER;
 }
 
 void ICARUS_Free(void *pMem)
 {
 	//gi.Free(pMem);
 	//free(pMem);
-	Z_Free(pMem);
+	if ( !pMem )
+	{
+		return;
+	}
+
+	int *pHeader = (int *)( (byte *)pMem - ICARUS_MALLOC_HEADER );
+
+	if ( *pHeader < 0 )
+	{
+		Z_Free( pHeader );
+	}
+	else
+	{
+		ICARUS_PoolFreeClass( pHeader, *pHeader );
+	}
 }
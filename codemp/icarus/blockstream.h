@@ -29,6 +29,12 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include <list>
 #include <vector>
 
+// slab pools for the small ICARUS classes, see Memory.cpp
+void *ICARUS_PoolAlloc( size_t size );
+void  ICARUS_PoolFree( void *pMem, size_t size );
+void  ICARUS_PoolRelease( void );
+void  ICARUS_PoolStats( void );
+
 #define	IBI_EXT			".IBI"	//(I)nterpreted (B)lock (I)nstructions
 #define IBI_HEADER_ID	"IBI"
 #define IBI_HEADER_ID_LENGTH 4 // Length of IBI_HEADER_ID + 1 for the null terminating byte.
@@ -78,12 +84,12 @@ public:
 
 	inline void *operator new( size_t size )
 	{	// Allocate the memory.
-		return Z_Malloc( size, TAG_ICARUS4, qtrue );
+		return ICARUS_PoolAlloc( size );
 	}
 	// Overloaded delete operator.
-	inline void operator delete( void *pRawData )
+	inline void operator delete( void *pRawData, size_t size )
 	{	// Free the Memory.
-		Z_Free( pRawData );
+		ICARUS_PoolFree( pRawData, size );
 	}
 
 	CBlockMember *Duplicate( void );
@@ -161,6 +167,16 @@ public:
 	int HasFlag( unsigned char flag )	const	{	return ( m_flags & flag );	}
 	unsigned char GetFlags( void )		const	{	return m_flags;				}
 
+	inline void *operator new( size_t size )
+	{	// Allocate the memory.
+		return ICARUS_PoolAlloc( size );
+	}
+	// Overloaded delete operator.
+	inline void operator delete( void *pRawData, size_t size )
+	{	// Free the Memory.
+		ICARUS_PoolFree( pRawData, size );
+	}
+
 protected:
 
 	blockMember_v				m_members;			//List of all CBlockMembers owned by this list
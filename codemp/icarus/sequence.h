@@ -89,12 +89,12 @@ public:
 
 	inline void *operator new( size_t size )
 	{	// Allocate the memory.
-		return Z_Malloc( size, TAG_ICARUS3, qtrue );
+		return ICARUS_PoolAlloc( size );
 	}
 	// Overloaded delete operator.
-	inline void operator delete( void *pRawData )
+	inline void operator delete( void *pRawData, size_t size )
 	{	// Free the Memory.
-		Z_Free( pRawData );
+		ICARUS_PoolFree( pRawData, size );
 	}
 
 protected:
@@ -110,12 +110,12 @@ public:
 	// Overloaded new operator.
 	inline void *operator new( size_t size )
 	{	// Allocate the memory.
-		return Z_Malloc( size, TAG_ICARUS2, qtrue );
+		return ICARUS_PoolAlloc( size );
 	}
 	// Overloaded delete operator.
-	inline void operator delete( void *pRawData )
+	inline void operator delete( void *pRawData, size_t size )
 	{	// Free the Memory.
-		Z_Free( pRawData );
+		ICARUS_PoolFree( pRawData, size );
 	}
 
 // moved to public on 2/12/2 to allow calling during shutdown
@@ -72,6 +72,16 @@ public:
 	void	SetBlock( CBlock *block )			{	m_block = block;			}
 	void	SetGUID( int id )					{	m_id = id;					}
 
+	inline void *operator new( size_t size )
+	{	// Allocate the memory.
+		return ICARUS_PoolAlloc( size );
+	}
+	// Overloaded delete operator.
+	inline void operator delete( void *pRawData, size_t size )
+	{	// Free the Memory.
+		ICARUS_PoolFree( pRawData, size );
+	}
+
 protected:
 
 	int		m_id;
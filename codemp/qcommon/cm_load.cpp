@@ -285,6 +285,49 @@ void CM_BoundBrush( cbrush_t *b ) {
 }
 
 
+/*
+=================
+CMod_BuildSidePlanes
+
+Copies the side planes of every map brush into rows of normal x, y, z
+and dist for CM_TraceThroughBrush. The box brushes are left out, their
+planes change with every CM_TempBoxModel.
+=================
+*/
+static void CMod_BuildSidePlanes( clipMap_t &cm ) {
+#ifdef CM_SIMD_PLANES
+	cbrush_t	*brush;
+	float		*rows;
+	int			i, j, total, stride;
+
+	total = 0;
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		total += CM_SidePlaneStride( cm.brushes[i].numsides ) * 4;
+	}
+	if ( !total ) {
+		return;
+	}
+
+	rows = (float *)Hunk_Alloc( total * sizeof( *rows ), h_high );
+
+	for ( i = 0, brush = cm.brushes ; i < cm.numBrushes ; i++, brush++ ) {
+		stride = CM_SidePlaneStride( brush->numsides );
+		brush->sidePlanes = rows;
+
+		// the padding stays zeroed, it is never looked at
+		for ( j = 0 ; j < brush->numsides ; j++ ) {
+			const cplane_t *plane = brush->sides[j].plane;
+
+			rows[j] = plane->normal[0];
+			rows[stride + j] = plane->normal[1];
+			rows[stride * 2 + j] = plane->normal[2];
+			rows[stride * 3 + j] = plane->dist;
+		}
+		rows += stride * 4;
+	}
+#endif
+}
+
 /*
 =================
 CMod_LoadBrushes
@@ -320,6 +363,7 @@ void CMod_LoadBrushes( const lump_t *l, clipMap_t &cm ) {
 		CM_BoundBrush( out );
 	}
 
+	CMod_BuildSidePlanes( cm );
 }
 
 /*
@@ -27,6 +27,14 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "cm_public.h"
 #include "qcommon/qcommon.h"
 
+// brush planes are also kept as rows of normals and distances so four
+// sides can be tested at once, only where SSE2 is the baseline so the
+// results match the scalar code to the bit
+#if defined(idx64) && ( defined(__SSE2__) || defined(_M_X64) )
+	#define CM_SIMD_PLANES
+	#include <emmintrin.h>
+#endif
+
 #define	MAX_SUBMODELS			512
 #define	BOX_MODEL_HANDLE		(MAX_SUBMODELS-1)
 #define CAPSULE_MODEL_HANDLE	(MAX_SUBMODELS-2)
@@ -70,8 +78,11 @@ typedef struct cbrush_s {
 	cbrushside_t		*sides;
 	unsigned short		numsides;
 	unsigned short		checkcount;		// to avoid repeated testings
+	float				*sidePlanes;	// normal x, y, z and dist rows of CM_SidePlaneStride entries, NULL if not built
 } cbrush_t;
 
+#define CM_SidePlaneStride( numsides ) ( ( (numsides) + 3 ) & ~3 )
+
 class CCMShader
 {
 public:
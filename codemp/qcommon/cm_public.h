@@ -45,6 +45,7 @@ void		CM_BoxTrace ( trace_t *results, const vec3_t start, const vec3_t end, cons
 void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, clipHandle_t model, int brushmask, const vec3_t origin, const vec3_t angles, int capsule );
 
 byte		*CM_ClusterPVS (int cluster);
+int			CM_NumClusters (void);
 
 int			CM_PointLeafnum( const vec3_t p );
 
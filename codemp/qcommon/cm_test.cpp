@@ -309,6 +309,10 @@ byte	*CM_ClusterPVS (int cluster) {
 	return cmg.visibility + cluster * cmg.clusterBytes;
 }
 
+int CM_NumClusters (void) {
+	return cmg.numClusters;
+}
+
 /*
 ===============================================================================
 
@@ -447,25 +447,19 @@ void CM_TraceThroughPatch( traceWork_t *tw, trace_t &trace, cPatch_t *patch ) {
 
 /*
 ================
-CM_PlaneCollision
+CM_SideCollision
 
-  Returns false for a quick getout
+  Clips the trace against one side, given the distances of the start
+  and end point from its plane. Returns false for a quick getout
 ================
 */
 
-bool CM_PlaneCollision(traceWork_t *tw, cbrushside_t *side)
+static QINLINE bool CM_SideCollision(traceWork_t *tw, cbrushside_t *side, float d1, float d2)
 {
-	float			dist, f;
-	float			d1, d2;
+	float			f;
 
 	cplane_t		*plane = side->plane;
 
-	// adjust the plane distance appropriately for mins/maxs
-	dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
-
-	d1 = DotProduct( tw->start, plane->normal ) - dist;
-	d2 = DotProduct( tw->end, plane->normal ) - dist;
-
 	if (d2 > 0.0f)
 	{
 		// endpoint is not in solid
@@ -528,6 +522,96 @@ bool CM_PlaneCollision(traceWork_t *tw, cbrushside_t *side)
 	return(true);
 }
 
+/*
+================
+CM_PlaneCollision
+
+  Returns false for a quick getout
+================
+*/
+
+bool CM_PlaneCollision(traceWork_t *tw, cbrushside_t *side)
+{
+	float			dist;
+	float			d1, d2;
+
+	cplane_t		*plane = side->plane;
+
+	// adjust the plane distance appropriately for mins/maxs
+	dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
+
+	d1 = DotProduct( tw->start, plane->normal ) - dist;
+	d2 = DotProduct( tw->end, plane->normal ) - dist;
+
+	return CM_SideCollision(tw, side, d1, d2);
+}
+
+#ifdef CM_SIMD_PLANES
+/*
+================
+CM_BrushCollision
+
+  Same as calling CM_PlaneCollision for every side, the plane distances
+  are computed four sides at a time from the rows of brush->sidePlanes.
+  The sums are added in the same order as DotProduct so the results are
+  identical to the scalar code.
+================
+*/
+
+static bool CM_BrushCollision(traceWork_t *tw, cbrush_t *brush)
+{
+	const int		stride = CM_SidePlaneStride( brush->numsides );
+	const float		*nx = brush->sidePlanes;
+	const float		*ny = nx + stride;
+	const float		*nz = ny + stride;
+	const float		*pd = nz + stride;
+	const __m128	zero = _mm_setzero_ps();
+	const __m128	minsX = _mm_set1_ps( tw->size[0][0] ), maxsX = _mm_set1_ps( tw->size[1][0] );
+	const __m128	minsY = _mm_set1_ps( tw->size[0][1] ), maxsY = _mm_set1_ps( tw->size[1][1] );
+	const __m128	minsZ = _mm_set1_ps( tw->size[0][2] ), maxsZ = _mm_set1_ps( tw->size[1][2] );
+	const __m128	startX = _mm_set1_ps( tw->start[0] ), endX = _mm_set1_ps( tw->end[0] );
+	const __m128	startY = _mm_set1_ps( tw->start[1] ), endY = _mm_set1_ps( tw->end[1] );
+	const __m128	startZ = _mm_set1_ps( tw->start[2] ), endZ = _mm_set1_ps( tw->end[2] );
+	float			d1[4], d2[4];
+	int				i, j, count;
+
+	for (i = 0; i < brush->numsides; i += 4)
+	{
+		__m128	x = _mm_loadu_ps( nx + i );
+		__m128	y = _mm_loadu_ps( ny + i );
+		__m128	z = _mm_loadu_ps( nz + i );
+		__m128	mask, ox, oy, oz, dist;
+
+		// pick the corner like tw->offsets[ plane->signbits ]
+		mask = _mm_cmplt_ps( x, zero );
+		ox = _mm_or_ps( _mm_and_ps( mask, maxsX ), _mm_andnot_ps( mask, minsX ) );
+		mask = _mm_cmplt_ps( y, zero );
+		oy = _mm_or_ps( _mm_and_ps( mask, maxsY ), _mm_andnot_ps( mask, minsY ) );
+		mask = _mm_cmplt_ps( z, zero );
+		oz = _mm_or_ps( _mm_and_ps( mask, maxsZ ), _mm_andnot_ps( mask, minsZ ) );
+
+		dist = _mm_sub_ps( _mm_loadu_ps( pd + i ),
+			_mm_add_ps( _mm_add_ps( _mm_mul_ps( ox, x ), _mm_mul_ps( oy, y ) ), _mm_mul_ps( oz, z ) ) );
+
+		_mm_storeu_ps( d1, _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( startX, x ), _mm_mul_ps( startY, y ) ),
+			_mm_mul_ps( startZ, z ) ), dist ) );
+		_mm_storeu_ps( d2, _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( endX, x ), _mm_mul_ps( endY, y ) ),
+			_mm_mul_ps( endZ, z ) ), dist ) );
+
+		// the sides still have to be clipped in order
+		count = Q_min( 4, brush->numsides - i );
+		for (j = 0; j < count; j++)
+		{
+			if (!CM_SideCollision(tw, brush->sides + i + j, d1[j], d2[j]))
+			{
+				return(false);
+			}
+		}
+	}
+	return(true);
+}
+#endif
+
 /*
 ================
 CM_TraceThroughBrush
@@ -569,6 +653,16 @@ void CM_TraceThroughBrush( traceWork_t *tw, trace_t &trace, cbrush_t *brush, boo
 	// find the latest time the trace crosses a plane towards the interior
 	// and the earliest time the trace crosses a plane towards the exterior
 	//
+#ifdef CM_SIMD_PLANES
+	if (brush->sidePlanes)
+	{
+		if (!CM_BrushCollision(tw, brush))
+		{
+			return;
+		}
+	}
+	else
+#endif
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = brush->sides + i;
@@ -37,6 +37,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 typedef struct cmd_s {
 	byte	*data;
 	int		maxsize;
+	int		start;		// executed lines are skipped instead of moving the rest down
 	int		cursize;
 } cmd_t;
 
@@ -137,6 +138,7 @@ void Cbuf_Init (void)
 {
 	cmd_text.data = cmd_text_buf;
 	cmd_text.maxsize = MAX_CMD_BUFFER;
+	cmd_text.start = 0;
 	cmd_text.cursize = 0;
 }
 
@@ -157,7 +159,15 @@ void Cbuf_AddText( const char *text ) {
 		Com_Printf ("Cbuf_AddText: overflow\n");
 		return;
 	}
-	Com_Memcpy(&cmd_text.data[cmd_text.cursize], text, l);
+
+	// move the remaining text to the front once the end is reached
+	if (cmd_text.start + cmd_text.cursize + l >= cmd_text.maxsize)
+	{
+		memmove(cmd_text.data, cmd_text.data + cmd_text.start, cmd_text.cursize);
+		cmd_text.start = 0;
+	}
+
+	Com_Memcpy(&cmd_text.data[cmd_text.start + cmd_text.cursize], text, l);
 	cmd_text.cursize += l;
 }
 
@@ -172,7 +182,6 @@ Adds a \n to the text
 */
 void Cbuf_InsertText( const char *text ) {
 	int		len;
-	int		i;
 
 	len = strlen( text ) + 1;
 	if ( len + cmd_text.cursize > cmd_text.maxsize ) {
@@ -180,16 +189,20 @@ void Cbuf_InsertText( const char *text ) {
 		return;
 	}
 
-	// move the existing command text
-	for ( i = cmd_text.cursize - 1 ; i >= 0 ; i-- ) {
-		cmd_text.data[ i + len ] = cmd_text.data[ i ];
+	// use the space left by executed lines if there is enough,
+	// otherwise move the existing command text
+	if ( cmd_text.start >= len ) {
+		cmd_text.start -= len;
+	} else {
+		memmove( cmd_text.data + len, cmd_text.data + cmd_text.start, cmd_text.cursize );
+		cmd_text.start = 0;
 	}
 
 	// copy the new text in
-	Com_Memcpy( cmd_text.data, text, len - 1 );
+	Com_Memcpy( cmd_text.data + cmd_text.start, text, len - 1 );
 
 	// add a \n
-	cmd_text.data[ len - 1 ] = '\n';
+	cmd_text.data[ cmd_text.start + len - 1 ] = '\n';
 
 	cmd_text.cursize += len;
 }
@@ -210,7 +223,7 @@ void Cbuf_ExecuteText (int exec_when, const char *text)
 			Cmd_ExecuteString (text);
 		} else {
 			Cbuf_Execute();
-			Com_DPrintf(S_COLOR_YELLOW "EXEC_NOW %s\n", cmd_text.data);
+			Com_DPrintf(S_COLOR_YELLOW "EXEC_NOW %s\n", cmd_text.data + cmd_text.start);
 		}
 		break;
 	case EXEC_INSERT:
@@ -281,7 +294,7 @@ void Cbuf_Execute (void)
 		}
 
 		// find a \n or ; line break or comment: // or /* */
-		text = (char *)cmd_text.data;
+		text = (char *)cmd_text.data + cmd_text.start;
 
 		// check for delay, which is not a real command
 		char *p = text;
@@ -318,6 +331,7 @@ void Cbuf_Execute (void)
 								if (gotSemicolonOrNewline && *p && p - text < cmd_text.cursize) {
 									// add this to the list of pending commands
 									pendingCommandsList.emplace_back(p, cmd_text.cursize - (p - text), waitf, num);
+									cmd_text.start = 0;
 									cmd_text.cursize = 0;
 									return;
 								}
@@ -369,17 +383,20 @@ void Cbuf_Execute (void)
 		Com_Memcpy (line, text, i);
 		line[i] = 0;
 
-// delete the text from the command buffer and move remaining commands down
+// delete the text from the command buffer before executing it
 // this is necessary because commands (exec) can insert data at the
 // beginning of the text buffer
 
 		if (i == cmd_text.cursize)
+		{
+			cmd_text.start = 0;
 			cmd_text.cursize = 0;
+		}
 		else
 		{
 			i++;
+			cmd_text.start += i;
 			cmd_text.cursize -= i;
-			memmove (text, text+i, cmd_text.cursize);
 		}
 
 // execute the command line
@@ -476,6 +493,7 @@ static void Cmd_Echo_f (void)
 typedef struct cmd_function_s
 {
 	struct cmd_function_s	*next;
+	struct cmd_function_s	*hashNext;
 	char					*name;
 	char					*description;
 	xcommand_t				function;
@@ -492,6 +510,9 @@ static	bool		cmd_quoted[MAX_STRING_TOKENS];
 
 static	cmd_function_t	*cmd_functions;		// possible commands to execute
 
+#define	CMD_HASH_SIZE	512
+static	cmd_function_t	*cmd_hashTable[CMD_HASH_SIZE];	// the same commands by name
+
 
 /*
 ============
@@ -639,21 +660,39 @@ void Cmd_Args_Sanitize( size_t length, const char *strip, const char *repl )
 	}
 }
 
+/*
+============
+Cmd_EndToken
+
+Copies the token text[0..end) to the argv buffer in one piece
+============
+*/
+static const char *Cmd_EndToken( const char *text, const char *end, char **textOut ) {
+	size_t len = end - text;
+
+	Com_Memcpy( *textOut, text, len );
+	*textOut += len;
+	*(*textOut)++ = 0;
+
+	return end;
+}
+
 /*
 ============
 Cmd_TokenizeString
 
 Parses the given string into command line tokens.
-The text is copied to a seperate buffer and 0 characters
-are inserted in the appropriate place, The argv array
-will point into this temporary buffer.
+Every token is found as a span of the given string first and then
+copied to a seperate buffer with a 0 character after it, the argv
+array will point into this temporary buffer.
 ============
 */
 // NOTE TTimo define that to track tokenization issues
 //#define TKN_DBG
 static void Cmd_TokenizeString2( const char *text_in, qboolean ignoreQuotes, bool nestedQuotes ) {
-	const char	*text;
+	const char	*text, *end;
 	char	*textOut;
+	size_t	len;
 
 #ifdef TKN_DBG
   // FIXME TTimo blunt hook to try to find the tokenization of userinfo
@@ -667,7 +706,13 @@ static void Cmd_TokenizeString2( const char *text_in, qboolean ignoreQuotes, boo
 		return;
 	}
 
-	Q_strncpyz( cmd_cmd, text_in, sizeof(cmd_cmd) );
+	// only copy the string itself, not the whole buffer like strncpy does
+	len = strlen( text_in );
+	if ( len >= sizeof( cmd_cmd ) ) {
+		len = sizeof( cmd_cmd ) - 1;
+	}
+	Com_Memcpy( cmd_cmd, text_in, len );
+	cmd_cmd[len] = 0;
 
 	text = text_in;
 	textOut = cmd_tokenized;
@@ -713,29 +758,18 @@ static void Cmd_TokenizeString2( const char *text_in, qboolean ignoreQuotes, boo
 				cmd_argv[cmd_argc] = textOut;
 				cmd_argc++;
 				text++;
-				const char *textStart = text;
 				int quoteLevel = 0;
-				while (*text) {
-					if (*text == '"') {
-						if (IsOpeningQuote(text, text > textStart)) {
+				for (end = text; *end; end++) {
+					if (*end == '"') {
+						if (IsOpeningQuote(end, end > text))
 							++quoteLevel;
-							*textOut++ = *text++;
-						}
-						else {
-							if (quoteLevel) {
-								--quoteLevel;
-								*textOut++ = *text++;
-							}
-							else {
-								break;
-							}
-						}
-					}
-					else {
-						*textOut++ = *text++;
+						else if (quoteLevel)
+							--quoteLevel;
+						else
+							break;
 					}
 				}
-				*textOut++ = 0;
+				text = Cmd_EndToken(text, end, &textOut);
 				if (!*text) {
 					return;		// all tokens parsed
 				}
@@ -749,10 +783,9 @@ static void Cmd_TokenizeString2( const char *text_in, qboolean ignoreQuotes, boo
 				cmd_argv[cmd_argc] = textOut;
 				cmd_argc++;
 				text++;
-				while (*text && *text != '"') {
-					*textOut++ = *text++;
+				for (end = text; *end && *end != '"'; end++) {
 				}
-				*textOut++ = 0;
+				text = Cmd_EndToken(text, end, &textOut);
 				if (!*text) {
 					return;		// all tokens parsed
 				}
@@ -767,24 +800,22 @@ static void Cmd_TokenizeString2( const char *text_in, qboolean ignoreQuotes, boo
 		cmd_argc++;
 
 		// skip until whitespace, quote, or command
-		while ( *(const unsigned char* /*eurofix*/)text > ' ' ) {
-			if ( !ignoreQuotes && text[0] == '"' ) {
+		for ( end = text ; *(const unsigned char* /*eurofix*/)end > ' ' ; end++ ) {
+			if ( !ignoreQuotes && end[0] == '"' ) {
 				break;
 			}
 
-			if ( text[0] == '/' && text[1] == '/' ) {
+			if ( end[0] == '/' && end[1] == '/' ) {
 				break;
 			}
 
 			// skip /* */ comments
-			if ( text[0] == '/' && text[1] =='*' ) {
+			if ( end[0] == '/' && end[1] =='*' ) {
 				break;
 			}
-
-			*textOut++ = *text++;
 		}
 
-		*textOut++ = 0;
+		text = Cmd_EndToken( text, end, &textOut );
 
 		if ( !*text ) {
 			return;		// all tokens parsed
@@ -815,6 +846,24 @@ void Cmd_TokenizeStringNestedQuotes(const char *text_in) {
 	Cmd_TokenizeString2(text_in, qtrue, true);
 }
 
+/*
+============
+Cmd_HashName
+
+Case insensitive, like the command names
+============
+*/
+static int Cmd_HashName( const char *cmd_name ) {
+	unsigned	hash = 0;
+	int			i;
+
+	for ( i = 0 ; cmd_name[i] ; i++ ) {
+		hash = hash * 31 + tolower( (unsigned char)cmd_name[i] );
+	}
+
+	return ( hash ^ ( hash >> 10 ) ) & ( CMD_HASH_SIZE - 1 );
+}
+
 /*
 ============
 Cmd_FindCommand
@@ -823,7 +872,7 @@ Cmd_FindCommand
 cmd_function_t *Cmd_FindCommand( const char *cmd_name )
 {
 	cmd_function_t *cmd;
-	for( cmd = cmd_functions; cmd; cmd = cmd->next )
+	for( cmd = cmd_hashTable[Cmd_HashName( cmd_name )]; cmd; cmd = cmd->hashNext )
 		if( !Q_stricmp( cmd_name, cmd->name ) )
 			return cmd;
 	return NULL;
@@ -836,6 +885,7 @@ Cmd_AddCommand
 */
 void	Cmd_AddCommand( const char *cmd_name, xcommand_t function, const char *cmd_desc ) {
 	cmd_function_t	*cmd;
+	int				hash;
 
 	// fail if the command already exists
 	if( Cmd_FindCommand( cmd_name ) )
@@ -858,6 +908,10 @@ void	Cmd_AddCommand( const char *cmd_name, xcommand_t function, const char *cmd_
 	cmd->complete = NULL;
 	cmd->next = cmd_functions;
 	cmd_functions = cmd;
+
+	hash = Cmd_HashName( cmd_name );
+	cmd->hashNext = cmd_hashTable[hash];
+	cmd_hashTable[hash] = cmd;
 }
 
 void Cmd_AddCommandList( const cmdList_t *cmdList )
@@ -884,10 +938,10 @@ Cmd_SetCommandCompletionFunc
 ============
 */
 void Cmd_SetCommandCompletionFunc( const char *command, completionFunc_t complete ) {
-	for ( cmd_function_t *cmd=cmd_functions; cmd; cmd=cmd->next ) {
-		if ( !Q_stricmp( command, cmd->name ) )
-			cmd->complete = complete;
-	}
+	cmd_function_t *cmd = Cmd_FindCommand( command );
+
+	if ( cmd )
+		cmd->complete = complete;
 }
 
 /*
@@ -898,7 +952,7 @@ Cmd_RemoveCommand
 void	Cmd_RemoveCommand( const char *cmd_name ) {
 	cmd_function_t	*cmd, **back;
 
-	back = &cmd_functions;
+	back = &cmd_hashTable[Cmd_HashName( cmd_name )];
 	while( 1 ) {
 		cmd = *back;
 		if ( !cmd ) {
@@ -906,14 +960,19 @@ void	Cmd_RemoveCommand( const char *cmd_name ) {
 			return;
 		}
 		if ( !strcmp( cmd_name, cmd->name ) ) {
-			*back = cmd->next;
-			Z_Free(cmd->name);
-			Z_Free(cmd->description);
-			Z_Free (cmd);
-			return;
+			*back = cmd->hashNext;
+			break;
 		}
-		back = &cmd->next;
+		back = &cmd->hashNext;
+	}
+
+	for ( back = &cmd_functions ; *back != cmd ; back = &(*back)->next ) {
 	}
+	*back = cmd->next;
+
+	Z_Free(cmd->name);
+	Z_Free(cmd->description);
+	Z_Free (cmd);
 }
 
 /*
@@ -1015,10 +1074,10 @@ Cmd_CompleteArgument
 ============
 */
 void Cmd_CompleteArgument( const char *command, char *args, int argNum ) {
-	for ( cmd_function_t *cmd=cmd_functions; cmd; cmd=cmd->next ) {
-		if ( !Q_stricmp( command, cmd->name ) && cmd->complete )
-			cmd->complete( args, argNum );
-	}
+	cmd_function_t *cmd = Cmd_FindCommand( command );
+
+	if ( cmd && cmd->complete )
+		cmd->complete( args, argNum );
 }
 
 /*
@@ -1030,6 +1089,7 @@ A complete command line has been parsed, so try to execute it
 */
 void	Cmd_ExecuteString( const char *text ) {
 	cmd_function_t	*cmd, **prev;
+	int				hash;
 
 	// execute the command line
 	Cmd_TokenizeStringNestedQuotes( text );
@@ -1038,14 +1098,15 @@ void	Cmd_ExecuteString( const char *text ) {
 	}
 
 	// check registered command functions
-	for ( prev = &cmd_functions ; *prev ; prev = &cmd->next ) {
+	hash = Cmd_HashName( Cmd_Argv(0) );
+	for ( prev = &cmd_hashTable[hash] ; *prev ; prev = &cmd->hashNext ) {
 		cmd = *prev;
 		if ( !Q_stricmp( Cmd_Argv(0), cmd->name ) ) {
 			// rearrange the links so that the command will be
-			// near the head of the list next time it is used
-			*prev = cmd->next;
-			cmd->next = cmd_functions;
-			cmd_functions = cmd;
+			// near the head of its chain next time it is used
+			*prev = cmd->hashNext;
+			cmd->hashNext = cmd_hashTable[hash];
+			cmd_hashTable[hash] = cmd;
 
 			// perform the action
 			if ( !cmd->function ) {
@@ -1168,6 +1229,70 @@ void Cmd_CompleteCfgName( char *args, int argNum ) {
 	}
 }
 
+/*
+============
+Cmd_Bench_f
+
+cmd_bench [lines]
+
+Runs Cbuf_Execute over a synthetic script of the short lines rcon
+scripts and the game push through the command buffer.
+============
+*/
+static int cmd_benchArgs;
+
+static void Cmd_BenchNop_f( void ) {
+	cmd_benchArgs += Cmd_Argc();
+}
+
+static void Cmd_Bench_f( void ) {
+	static const char *script[] = {
+		"cmd_benchnop say \"hello there\" 1 2 3\n",
+		"cmd_benchnop kick 12;cmd_benchnop \"a \"nested\" quote\" b\n",
+		"// a comment line\n",
+		"cmd_benchnop a b c d e f g h /* comment */ i\n",
+		"CMD_BENCHNOP mixed case;cmd_benchnop\n",
+	};
+	std::string	saved;
+	int			lines, numLines, bytes, msec, start;
+
+	lines = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100000;
+	if ( lines < 1 ) {
+		lines = 1;
+	}
+
+	// keep the rest of the buffer for after the benchmark
+	saved.assign( (const char *)cmd_text.data + cmd_text.start, cmd_text.cursize );
+	cmd_text.start = 0;
+	cmd_text.cursize = 0;
+
+	Cmd_AddCommand( "cmd_benchnop", Cmd_BenchNop_f );
+	cmd_benchArgs = 0;
+	numLines = bytes = msec = 0;
+
+	while ( numLines < lines ) {
+		while ( numLines < lines && cmd_text.cursize < cmd_text.maxsize - MAX_CMD_LINE ) {
+			const char *line = script[numLines % ARRAY_LEN( script )];
+
+			Cbuf_AddText( line );
+			bytes += strlen( line );
+			numLines++;
+		}
+
+		start = Sys_Milliseconds();
+		Cbuf_Execute();
+		msec += Sys_Milliseconds() - start;
+	}
+
+	Cmd_RemoveCommand( "cmd_benchnop" );
+
+	Cbuf_AddText( saved.c_str() );
+
+	msec = Q_max( 1, msec );
+	Com_Printf( "%i lines, %i bytes, %i arguments in %i msec: %.0f lines/s, %.1f MB/s\n",
+		numLines, bytes, cmd_benchArgs, msec, numLines * 1000.0f / msec, bytes / ( msec * 1000.0f ) );
+}
+
 /*
 ============
 Cmd_Init
@@ -1187,5 +1312,6 @@ void Cmd_Init (void) {
 	Cmd_AddCommand( "delaycancel", Cmd_DelayCancel_f, "Cancel a pending delay" );
 	Cmd_AddCommand( "waitf", Cmd_Waitf_f, "Wait a specified number of frames, without pausing all command execution, before executing whatever is entered afterward" );
 	Cmd_AddCommand( "waitfcancel", Cmd_WaitfCancel_f, "Cancel a pending waitf" );
+	Cmd_AddCommand( "cmd_bench", Cmd_Bench_f, "Measure command buffer execution on a synthetic script" );
 }
 
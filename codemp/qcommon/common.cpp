@@ -76,6 +76,7 @@ cvar_t *com_affinity;
 int		time_game;
 int		time_frontend;		// renderer frontend time
 int		time_backend;		// renderer backend time
+int		time_demo;			// server demo writing on the main thread
 
 int			com_frameTime;
 int			com_frameNumber;
@@ -1223,6 +1224,8 @@ void Com_Init( char *commandLine ) {
 #ifndef FINAL_BUILD
 		Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
 #endif
+		Cmd_AddCommand ("msg_huffbench", MSG_HuffBench_f, "Check the huffman codec tables against the tree and measure both" );
+		Cmd_AddCommand ("msg_deltabench", MSG_DeltaBench_f, "Check the delta change masks against the field loop and measure both" );
 		Cmd_AddCommand ("writeconfig", Com_WriteConfig_f, "Write the configuration to file" );
 		Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
 
@@ -1660,8 +1663,9 @@ void Com_Frame( void ) {
 			sv -= time_game;
 			cl -= time_frontend + time_backend;
 
-			Com_Printf ("frame:%i all:%3i sv:%3i ev:%3i cl:%3i gm:%3i rf:%3i bk:%3i\n",
-						 com_frameNumber, all, sv, ev, cl, time_game, time_frontend, time_backend );
+			Com_Printf ("frame:%i all:%3i sv:%3i ev:%3i cl:%3i gm:%3i rf:%3i bk:%3i dm:%3i\n",
+						 com_frameNumber, all, sv, ev, cl, time_game, time_frontend, time_backend, time_demo );
+			time_demo = 0;
 		}
 
 		//
@@ -1729,6 +1733,8 @@ void Com_Shutdown (void)
 
 	Sys_SteamShutdown();
 
+	Com_ShutdownJobs();
+
 	MSG_shutdownHuffman();
 /*
 	// Only used for testing changes to huffman frequency table when tuning.
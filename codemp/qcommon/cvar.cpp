@@ -41,6 +41,12 @@ int			cvar_numIndexes;
 #define FILE_HASH_SIZE		512
 static	cvar_t*		hashTable[FILE_HASH_SIZE];
 
+// cvar_indexes slots in the order their modificationCount changed, so the
+// VMs can sync only the cvars that changed since they last looked
+#define	CVAR_CHANGE_LOG		1024		// must be a power of two
+static	int			cvar_changeLog[CVAR_CHANGE_LOG];
+static	int			cvar_changeCount;	// total, wraps the log
+
 static char *lastMemPool = NULL;
 static int memPoolSize;
 
@@ -75,6 +81,16 @@ static long generateHashValue( const char *fname ) {
 	return hash;
 }
 
+/*
+============
+Cvar_LogChange
+============
+*/
+static void Cvar_LogChange( cvar_t *var ) {
+	cvar_changeLog[cvar_changeCount & ( CVAR_CHANGE_LOG - 1 )] = var - cvar_indexes;
+	cvar_changeCount++;
+}
+
 /*
 ============
 Cvar_ValidateString
@@ -496,6 +512,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, uint32_t flags, c
 		var->description = NULL;
 	var->modified = qtrue;
 	var->modificationCount = 1;
+	Cvar_LogChange( var );
 	var->value = atof (var->string);
 	var->integer = atoi(var->string);
 	var->resetString = CopyString( var_value );
@@ -645,6 +662,7 @@ cvar_t *Cvar_Set2( const char *var_name, const char *value, uint32_t defaultFlag
 			var->latchedString = CopyString(value);
 			var->modified = qtrue;
 			var->modificationCount++;
+			Cvar_LogChange( var );
 			return var;
 		}
 
@@ -668,6 +686,7 @@ cvar_t *Cvar_Set2( const char *var_name, const char *value, uint32_t defaultFlag
 
 	var->modified = qtrue;
 	var->modificationCount++;
+	Cvar_LogChange( var );
 
 	Cvar_FreeString (var->string);	// free the old value string
 
@@ -1506,6 +1525,33 @@ void	Cvar_Update( vmCvar_t *vmCvar ) {
 	vmCvar->integer = cv->integer;
 }
 
+/*
+=====================
+Cvar_Changes
+
+Fills handles with the cvars that changed since *sequence and advances
+*sequence, a handle can be listed more than once. Returns -1 when the
+changes don't fit into handles or have already left the log, the caller
+has to update all of its cvars then. A sequence of 0 starts a new sync.
+=====================
+*/
+int		Cvar_Changes( int *sequence, int *handles, int maxHandles ) {
+	unsigned	pending = (unsigned)cvar_changeCount - (unsigned)*sequence;
+	int			i;
+
+	*sequence = cvar_changeCount;
+
+	if ( pending > CVAR_CHANGE_LOG || pending > (unsigned)Q_max( maxHandles, 0 ) ) {
+		return -1;
+	}
+
+	for ( i = 0 ; i < (int)pending ; i++ ) {
+		handles[i] = cvar_changeLog[( cvar_changeCount - pending + i ) & ( CVAR_CHANGE_LOG - 1 )];
+	}
+
+	return (int)pending;
+}
+
 /*
 ==================
 Cvar_CompleteCvarName
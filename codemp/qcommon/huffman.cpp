@@ -29,23 +29,21 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 static int			bloc = 0;
 
+// the offset based functions only touch the caller's offset, not bloc,
+// so messages can be written and read on several threads at once
 void	Huff_putBit( int bit, byte *fout, int *offset) {
-	bloc = *offset;
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+	int pos = *offset;
+	if ((pos&7) == 0) {
+		fout[(pos>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
-	*offset = bloc;
+	fout[(pos>>3)] |= bit << (pos&7);
+	*offset = pos + 1;
 }
 
 int		Huff_getBit( byte *fin, int *offset) {
-	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
-	return t;
+	int pos = *offset;
+	*offset = pos + 1;
+	return (fin[(pos>>3)] >> (pos&7)) & 0x1;
 }
 
 /* Add a bit to the output file (buffered) */
@@ -270,9 +268,9 @@ int Huff_Receive (node_t *node, int *ch, byte *fin) {
 
 /* Get a symbol */
 void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset) {
-	bloc = *offset;
+	int pos = *offset;
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (get_bit(fin)) {
+		if (Huff_getBit(fin, &pos)) {
 			node = node->right;
 		} else {
 			node = node->left;
@@ -284,7 +282,7 @@ void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset) {
 //		Com_Error(ERR_DROP, "Illegal tree!\n");
 	}
 	*ch = node->symbol;
-	*offset = bloc;
+	*offset = pos;
 }
 
 /* Send the prefix code for this node */
@@ -301,6 +299,16 @@ static void send(node_t *node, node_t *child, byte *fout) {
 	}
 }
 
+/* Send the prefix code for this node at the given offset */
+static void offsetSend(node_t *node, node_t *child, byte *fout, int *offset) {
+	if (node->parent) {
+		offsetSend(node->parent, node, fout, offset);
+	}
+	if (child) {
+		Huff_putBit(node->right == child ? 1 : 0, fout, offset);
+	}
+}
+
 /* Send a symbol */
 void Huff_transmit (huff_t *huff, int ch, byte *fout) {
 	int i;
@@ -316,9 +324,67 @@ void Huff_transmit (huff_t *huff, int ch, byte *fout) {
 }
 
 void Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset) {
-	bloc = *offset;
-	send(huff->loc[ch], NULL, fout);
-	*offset = bloc;
+	offsetSend(huff->loc[ch], NULL, fout, offset);
+}
+
+/*
+==================
+Huff_BuildCodec
+
+Compiles the current trees into codec tables, the codes of the
+compressor for writing and the symbols of the decompressor for every
+value of the first HUFF_LOOKUP_BITS bits for reading. Longer codes are
+walked down the decompressor tree, which must not change afterwards.
+==================
+*/
+void Huff_BuildCodec( huffman_t *huff, huffCodec_t *codec ) {
+	node_t		*node;
+	int			ch, i, bits, length;
+	uint32_t	code;
+
+	Com_Memset( codec, 0, sizeof( *codec ) );
+
+	for ( ch = 0 ; ch < HMAX ; ch++ ) {
+		if ( !huff->compressor.loc[ch] ) {
+			return;		// symbol was never added
+		}
+
+		// walk up to the root, the top edge is the first bit sent
+		code = 0;
+		length = 0;
+		for ( node = huff->compressor.loc[ch] ; node->parent ; node = node->parent ) {
+			if ( length == HUFF_MAX_CODE ) {
+				return;
+			}
+			code = ( code << 1 ) | ( node->parent->right == node ? 1 : 0 );
+			length++;
+		}
+
+		codec->code[ch] = code;
+		codec->length[ch] = length;
+		codec->maxLength = Q_max( codec->maxLength, length );
+	}
+
+	for ( i = 0 ; i < ( 1 << HUFF_LOOKUP_BITS ) ; i++ ) {
+		node = huff->decompressor.tree;
+		for ( bits = 0 ; bits < HUFF_LOOKUP_BITS && node && node->symbol == INTERNAL_NODE ; bits++ ) {
+			node = ( ( i >> bits ) & 1 ) ? node->right : node->left;
+		}
+		if ( !node ) {
+			return;
+		}
+		if ( node->symbol == INTERNAL_NODE ) {
+			codec->lookup[i].symbol = -1;
+			codec->lookup[i].length = 0;
+		} else {
+			codec->lookup[i].symbol = node->symbol;
+			codec->lookup[i].length = bits;
+		}
+	}
+
+	codec->tree = huff->decompressor.tree;
+
+	codec->valid = qtrue;
 }
 
 void Huff_Decompress(msg_t *mbuf, int offset) {
@@ -373,7 +439,7 @@ void Huff_Decompress(msg_t *mbuf, int offset) {
 	Com_Memcpy(mbuf->data + offset, seq, cch);
 }
 
-extern 	int oldsize;
+extern thread_local int oldsize;
 
 void Huff_Compress(msg_t *mbuf, int offset) {
 	int			i, ch, size;
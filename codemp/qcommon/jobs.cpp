@@ -0,0 +1,221 @@
+/*
+===========================================================================
+Copyright (C) 2013 - 2015, OpenJK contributors
+
+This file is part of the OpenJK source code.
+
+OpenJK is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+===========================================================================
+*/
+
+// jobs.cpp -- small worker pool for splitting per-frame work across cores
+
+#include "qcommon/qcommon.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define MAX_JOB_WORKERS		16
+
+static cvar_t					*com_jobThreads;
+
+static std::vector<std::thread>	jobWorkers;
+static std::mutex				jobMutex;
+static std::condition_variable	jobWake;
+static std::condition_variable	jobDone;
+
+// the batch currently being worked on, only one is in flight at a time
+static jobFunc_t				jobFunc;
+static void						*jobData;
+static int						jobCount;
+static std::atomic<int>			jobNext;
+static int						jobFinished;
+static int						jobActive;		// workers that picked up the current batch
+static int						jobGeneration;
+static bool						jobQuit;
+
+/*
+================
+Com_RunJobRange
+
+Pulls indices off the current batch until there are none left.
+Returns the number of indices this thread completed.
+================
+*/
+static int Com_RunJobRange( jobFunc_t func, void *data, int count ) {
+	int done = 0;
+
+	for ( ;; ) {
+		int index = jobNext.fetch_add( 1 );
+		if ( index >= count ) {
+			break;
+		}
+		func( data, index );
+		done++;
+	}
+
+	return done;
+}
+
+/*
+================
+Com_JobWorker
+================
+*/
+static void Com_JobWorker( void ) {
+	int seenGeneration = 0;
+
+	for ( ;; ) {
+		jobFunc_t	func;
+		void		*data;
+		int			count;
+
+		{
+			std::unique_lock<std::mutex> lock( jobMutex );
+			jobWake.wait( lock, [&] { return jobQuit || jobGeneration != seenGeneration; } );
+			if ( jobQuit ) {
+				return;
+			}
+			seenGeneration = jobGeneration;
+			func = jobFunc;
+			data = jobData;
+			count = jobCount;
+			jobActive++;
+		}
+
+		int done = Com_RunJobRange( func, data, count );
+
+		{
+			std::lock_guard<std::mutex> lock( jobMutex );
+			jobFinished += done;
+			jobActive--;
+			if ( !jobActive ) {
+				jobDone.notify_one();
+			}
+		}
+	}
+}
+
+/*
+================
+Com_StartJobWorkers
+
+Workers are only spun up the first time something actually asks for
+parallel work, so configurations that never opt in pay nothing.
+================
+*/
+static void Com_StartJobWorkers( void ) {
+	int numWorkers;
+
+	if ( !com_jobThreads ) {
+		com_jobThreads = Cvar_Get( "com_jobThreads", "0", CVAR_ARCHIVE | CVAR_LATCH, "Number of worker threads for parallel jobs, 0 = one less than the number of cores" );
+	}
+
+	numWorkers = com_jobThreads->integer;
+	if ( numWorkers <= 0 ) {
+		numWorkers = (int)std::thread::hardware_concurrency() - 1;
+	}
+	numWorkers = Com_Clampi( 0, MAX_JOB_WORKERS, numWorkers );
+
+	jobQuit = false;
+	for ( int i = 0; i < numWorkers; i++ ) {
+		jobWorkers.push_back( std::thread( Com_JobWorker ) );
+	}
+
+	Com_DPrintf( "Started %i job worker threads\n", numWorkers );
+}
+
+/*
+================
+Com_JobWorkers
+
+Number of threads, including the caller, that Com_RunJobs will spread work over.
+================
+*/
+int Com_JobWorkers( void ) {
+	return (int)jobWorkers.size() + 1;
+}
+
+/*
+================
+Com_RunJobs
+
+Calls func( data, index ) for every index in [0, count) using the worker
+pool and the calling thread, and returns once all of them have finished.
+Only the main thread may call this.  Jobs run concurrently, so they must
+not call Com_Error, Com_Printf or anything else that touches shared state.
+================
+*/
+void Com_RunJobs( jobFunc_t func, void *data, int count ) {
+	if ( count <= 0 ) {
+		return;
+	}
+
+	if ( !com_jobThreads ) {
+		Com_StartJobWorkers();
+	}
+
+	if ( count == 1 || jobWorkers.empty() ) {
+		for ( int i = 0; i < count; i++ ) {
+			func( data, i );
+		}
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock( jobMutex );
+
+		// a worker that woke up late may still hold the previous batch,
+		// don't reset the index counter underneath it
+		jobDone.wait( lock, [] { return !jobActive; } );
+
+		jobFunc = func;
+		jobData = data;
+		jobCount = count;
+		jobFinished = 0;
+		jobNext.store( 0 );
+		jobGeneration++;
+	}
+	jobWake.notify_all();
+
+	int done = Com_RunJobRange( func, data, count );
+
+	std::unique_lock<std::mutex> lock( jobMutex );
+	jobFinished += done;
+	jobDone.wait( lock, [] { return jobFinished == jobCount; } );
+}
+
+/*
+================
+Com_ShutdownJobs
+================
+*/
+void Com_ShutdownJobs( void ) {
+	if ( jobWorkers.empty() ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( jobMutex );
+		jobQuit = true;
+	}
+	jobWake.notify_all();
+
+	for ( size_t i = 0; i < jobWorkers.size(); i++ ) {
+		jobWorkers[i].join();
+	}
+	jobWorkers.clear();
+}
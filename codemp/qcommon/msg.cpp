@@ -26,10 +26,13 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "qcommon/qcommon.h"
 #include "server/server.h"
 
+#include <atomic>
+
 //#define _NEWHUFFTABLE_		// Build "c:\\netchan.bin"
 //#define _USINGNEWHUFFTABLE_		// Build a new frequency table to cut and paste.
 
 static huffman_t		msgHuff;
+static huffCodec_t		msgCodec;		// msgHuff compiled into tables
 
 static qboolean			msgInit = qfalse;
 #ifdef _NEWHUFFTABLE_
@@ -45,14 +48,17 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
+// snapshots may be written from several job workers at once, so the
+// debug counters are kept per thread
 #ifndef FINAL_BUILD
-	int gLastBitIndex = 0;
+	thread_local int gLastBitIndex = 0;
 #endif
 
-int oldsize = 0;
+thread_local int oldsize = 0;
 
 bool g_nOverrideChecked = false;
 void MSG_CheckNETFPSFOverrides(qboolean psfOverrides);
+static void MSG_BuildFieldMaps( void );
 
 void MSG_initHuffman();
 
@@ -65,6 +71,8 @@ void MSG_Init( msg_t *buf, byte *data, int length ) {
 		//Then for psf overrides
 		MSG_CheckNETFPSFOverrides(qtrue);
 
+		MSG_BuildFieldMaps();
+
 		g_nOverrideChecked = true;
 	}
 
@@ -87,6 +95,8 @@ void MSG_InitOOB( msg_t *buf, byte *data, int length ) {
 		//Then for psf overrides
 		MSG_CheckNETFPSFOverrides(qtrue);
 
+		MSG_BuildFieldMaps();
+
 		g_nOverrideChecked = true;
 	}
 
@@ -133,10 +143,91 @@ bit functions
 
 int	overflows;
 
+/*
+=================
+MSG_WriteHuffTree
+
+Writes the low bits of value to a bitstream message, the whole bytes
+are coded by walking msgHuff from the leaves up.
+=================
+*/
+static void MSG_WriteHuffTree( msg_t *msg, int value, int bits ) {
+	int	i, nbits;
+
+	if (bits&7) {
+		nbits = bits&7;
+		for(i=0;i<nbits;i++) {
+			Huff_putBit((value&1), msg->data, &msg->bit);
+			value = (value>>1);
+		}
+		bits = bits - nbits;
+	}
+	if (bits) {
+		for(i=0;i<bits;i+=8) {
+#ifdef _NEWHUFFTABLE_
+			fwrite(&value, 1, 1, fp);
+#endif // _NEWHUFFTABLE_
+			Huff_offsetTransmit (&msgHuff.compressor, (value&0xff), msg->data, &msg->bit);
+			value = (value>>8);
+		}
+	}
+}
+
+/*
+=================
+MSG_WriteHuffCodec
+
+Same output as MSG_WriteHuffTree, the codes come from msgCodec and are
+collected in a 64 bit buffer. Only the bytes the tree walker would touch
+are written, a partial first byte keeps the bits already in it.
+=================
+*/
+static void MSG_WriteHuffCodec( msg_t *msg, int value, int bits ) {
+	uint32_t	v = (uint32_t)value;
+	uint64_t	acc;
+	byte		*out;
+	int			have, nbits, ch, i;
+
+	out = msg->data + ( msg->bit >> 3 );
+	have = msg->bit & 7;
+	acc = have ? *out : 0;
+
+	nbits = bits & 7;
+	if ( nbits ) {
+		acc |= (uint64_t)( v & ( ( 1 << nbits ) - 1 ) ) << have;
+		have += nbits;
+		v >>= nbits;
+		bits -= nbits;
+	}
+
+	for ( i = 0 ; i < bits ; i += 8 ) {
+		ch = v & 0xff;
+		acc |= (uint64_t)msgCodec.code[ch] << have;
+		have += msgCodec.length[ch];
+		v >>= 8;
+
+		if ( have >= 32 ) {
+			out[0] = (byte)acc;
+			out[1] = (byte)( acc >> 8 );
+			out[2] = (byte)( acc >> 16 );
+			out[3] = (byte)( acc >> 24 );
+			out += 4;
+			acc >>= 32;
+			have -= 32;
+		}
+	}
+
+	msg->bit = (int)( ( out - msg->data ) << 3 ) + have;
+
+	// the last byte may only be partly used
+	for ( ; have > 0 ; have -= 8 ) {
+		*out++ = (byte)acc;
+		acc >>= 8;
+	}
+}
+
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
-	int	i;
-
 	oldsize += bits;
 
 	// this isn't an exact overflow check, but close enough
@@ -194,33 +285,182 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		}
 	} else {
 		value &= (0xffffffff>>(32-bits));
-		if (bits&7) {
-			int nbits;
-			nbits = bits&7;
-			for(i=0;i<nbits;i++) {
-				Huff_putBit((value&1), msg->data, &msg->bit);
-				value = (value>>1);
+		if ( msgCodec.valid ) {
+			MSG_WriteHuffCodec( msg, value, bits );
+		} else {
+			MSG_WriteHuffTree( msg, value, bits );
+		}
+		msg->cursize = (msg->bit>>3)+1;
+	}
+}
+
+/*
+=================
+MSG_WriteBitRun
+
+Appends bits that were already written to another message starting at
+bit 0.  The huffman coding of MSG_WriteBits doesn't depend on where in
+the message the bits land, so this gives the same stream as writing the
+values again.
+=================
+*/
+void MSG_WriteBitRun( msg_t *msg, const byte *data, int bits ) {
+	int		i, n, shift;
+	int		pos;
+	byte	v, *out;
+
+	if ( bits <= 0 ) {
+		return;
+	}
+
+	if ( msg->oob ) {
+		Com_Error( ERR_DROP, "MSG_WriteBitRun: oob message" );
+	}
+
+	if ( msg->maxsize - msg->cursize < 4 + ( ( bits + 7 ) >> 3 ) ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	pos = msg->bit;
+	for ( i = 0 ; bits > 0 ; i++, bits -= n ) {
+		n = bits < 8 ? bits : 8;
+		v = data[i] & ( ( 1 << n ) - 1 );
+		out = msg->data + ( pos >> 3 );
+		shift = pos & 7;
+		if ( !shift ) {
+			out[0] = v;
+		} else {
+			out[0] |= v << shift;
+			if ( shift + n > 8 ) {
+				out[1] = v >> ( 8 - shift );
 			}
-			bits = bits - nbits;
 		}
-		if (bits) {
-			for(i=0;i<bits;i+=8) {
+		pos += n;
+	}
+
+	msg->bit = pos;
+	msg->cursize = ( pos >> 3 ) + 1;
+}
+
+/*
+=================
+MSG_ReadHuffTree
+
+Reads bits written by MSG_WriteHuffTree, one bit at a time down msgHuff.
+=================
+*/
+static int MSG_ReadHuffTree( msg_t *msg, int bits ) {
+	int			value;
+	int			get;
+	int			i, nbits;
+	value = 0;
+
+	nbits = 0;
+	if (bits&7) {
+		nbits = bits&7;
+		for(i=0;i<nbits;i++) {
+			value |= (Huff_getBit(msg->data, &msg->bit)<<i);
+		}
+		bits = bits - nbits;
+	}
+	if (bits) {
+		for(i=0;i<bits;i+=8) {
+			Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit);
 #ifdef _NEWHUFFTABLE_
-				fwrite(&value, 1, 1, fp);
+			fwrite(&get, 1, 1, fp);
 #endif // _NEWHUFFTABLE_
-				Huff_offsetTransmit (&msgHuff.compressor, (value&0xff), msg->data, &msg->bit);
-				value = (value>>8);
+			value |= (get<<(i+nbits));
+		}
+	}
+
+	return value;
+}
+
+/*
+=================
+MSG_PeekBits
+
+Gets the next 57 or more bits of a message, without reading past the
+end of its buffer.
+=================
+*/
+static QINLINE uint64_t MSG_PeekBits( const msg_t *msg, int pos ) {
+	const byte	*in = msg->data + ( pos >> 3 );
+	uint64_t	window = 0;
+	int			i, count;
+
+	count = Q_min( 8, msg->maxsize - ( pos >> 3 ) );
+	for ( i = 0 ; i < count ; i++ ) {
+		window |= (uint64_t)in[i] << ( i * 8 );
+	}
+
+	return window >> ( pos & 7 );
+}
+
+/*
+=================
+MSG_ReadHuffCodec
+
+Same result as MSG_ReadHuffTree, codes up to HUFF_LOOKUP_BITS long are
+looked up at once and only longer ones walk the tree. The bits come from a 64 bit buffer that is refilled when it gets
+shorter than the longest code.
+=================
+*/
+static int MSG_ReadHuffCodec( msg_t *msg, int bits ) {
+	const huffLookup_t	*entry;
+	const node_t		*node;
+	uint64_t			window;
+	int					pos, avail, used, symbol, value, nbits, i;
+
+	pos = msg->bit;
+	window = MSG_PeekBits( msg, pos );
+	avail = 64 - ( pos & 7 );
+
+	value = 0;
+	nbits = bits & 7;
+	if ( nbits ) {
+		value = (int)( window & ( ( 1 << nbits ) - 1 ) );
+		window >>= nbits;
+		avail -= nbits;
+		pos += nbits;
+		bits -= nbits;
+	}
+
+	for ( i = 0 ; i < bits ; i += 8 ) {
+		if ( avail < msgCodec.maxLength ) {
+			window = MSG_PeekBits( msg, pos );
+			avail = 64 - ( pos & 7 );
+		}
+
+		entry = &msgCodec.lookup[window & ( ( 1 << HUFF_LOOKUP_BITS ) - 1 )];
+		symbol = entry->symbol;
+		used = entry->length;
+		if ( symbol < 0 ) {
+			node = msgCodec.tree;
+			while ( node && node->symbol == INTERNAL_NODE ) {
+				node = ( ( window >> used ) & 1 ) ? node->right : node->left;
+				used++;
+			}
+			if ( !node ) {
+				continue;	// like Huff_offsetReceive, a zero and no bits taken
 			}
+			symbol = node->symbol;
 		}
-		msg->cursize = (msg->bit>>3)+1;
+
+		value |= symbol << ( i + nbits );
+		window >>= used;
+		avail -= used;
+		pos += used;
 	}
+
+	msg->bit = pos;
+	return value;
 }
 
 int MSG_ReadBits( msg_t *msg, int bits ) {
 	int			value;
-	int			get;
 	qboolean	sgn;
-	int			i, nbits;
 	value = 0;
 
 	if ( bits < 0 ) {
@@ -250,24 +490,14 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 			Com_Error(ERR_DROP, "can't read %d bits\n", bits);
 		}
 	} else {
-		nbits = 0;
-		if (bits&7) {
-			nbits = bits&7;
-			for(i=0;i<nbits;i++) {
-				value |= (Huff_getBit(msg->data, &msg->bit)<<i);
-			}
-			bits = bits - nbits;
-		}
-		if (bits) {
-			for(i=0;i<bits;i+=8) {
-				Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit);
-#ifdef _NEWHUFFTABLE_
-				fwrite(&get, 1, 1, fp);
-#endif // _NEWHUFFTABLE_
-				value |= (get<<(i+nbits));
-			}
+		if ( msgCodec.valid ) {
+			value = MSG_ReadHuffCodec( msg, bits );
+		} else {
+			value = MSG_ReadHuffTree( msg, bits );
 		}
 		msg->readcount = (msg->bit>>3)+1;
+		// the sign has always been taken from the whole bytes only
+		bits -= bits & 7;
 	}
 	if ( sgn && bits > 0 && bits < 32 ) {
 		if ( value & ( 1 << ( bits - 1 ) ) ) {
@@ -788,7 +1018,7 @@ typedef struct netField_s {
 	size_t	offset;
 	int		bits;		// 0 = float
 #ifndef FINAL_BUILD
-	unsigned	mCount;
+	std::atomic<unsigned>	mCount;
 #endif
 } netField_t;
 
@@ -995,6 +1225,144 @@ netField_t	entityStateFields[] =
 #define	FLOAT_INT_BITS	13
 #define	FLOAT_INT_BIAS	(1<<(FLOAT_INT_BITS-1))
 
+/*
+=============================================================================
+
+change masks
+
+The fields of entityState_t and playerState_t are all 32 bits, so the
+fields that changed are found by comparing whole structs a word at a
+time, four at once with SSE2. A field map turns the word of a changed
+field into its place in the field list.
+
+=============================================================================
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+	#define MSG_SIMD_CHANGEMASK
+	#include <emmintrin.h>
+#endif
+
+#define MAX_NETFIELD_WORDS	( sizeof( playerState_t ) / 4 )
+#define MAX_NETFIELDS		256
+
+typedef struct netFieldMap_s {
+	netField_t	*fields;
+	int			numWords;							// size of the struct
+	short		wordField[MAX_NETFIELD_WORDS];		// -1 for words that aren't sent
+} netFieldMap_t;
+
+typedef struct netChangeMask_s {
+	uint32_t	bits[MAX_NETFIELDS / 32];			// in field list order
+	int			lc;									// last changed field + 1
+} netChangeMask_t;
+
+#define MSG_FieldChanged( mask, i ) ( (mask)->bits[(i) >> 5] & ( 1u << ( (i) & 31 ) ) )
+
+/*
+==================
+MSG_BuildFieldMap
+==================
+*/
+static void MSG_BuildFieldMap( netFieldMap_t *map, netField_t *fields, int numFields, size_t size ) {
+	int		i;
+
+	assert( size / 4 <= MAX_NETFIELD_WORDS && numFields <= MAX_NETFIELDS );
+
+	map->fields = fields;
+	map->numWords = (int)( size / 4 );
+	for ( i = 0 ; i < map->numWords ; i++ ) {
+		map->wordField[i] = -1;
+	}
+	for ( i = 0 ; i < numFields ; i++ ) {
+		assert( !( fields[i].offset & 3 ) );
+		map->wordField[fields[i].offset / 4] = i;
+	}
+}
+
+/*
+==================
+MSG_MarkFieldChanged
+==================
+*/
+static QINLINE void MSG_MarkFieldChanged( const netFieldMap_t *map, int word, netChangeMask_t *mask ) {
+	int		i = map->wordField[word];
+
+	if ( i < 0 ) {
+		return;
+	}
+
+	mask->bits[i >> 5] |= 1u << ( i & 31 );
+	if ( i >= mask->lc ) {
+		mask->lc = i + 1;
+	}
+#ifndef FINAL_BUILD
+	map->fields[i].mCount.fetch_add( 1, std::memory_order_relaxed );
+#endif
+}
+
+/*
+==================
+MSG_ChangeMask
+
+Finds the fields of map that differ between from and to.
+==================
+*/
+static void MSG_ChangeMask( const netFieldMap_t *map, const void *from, const void *to, netChangeMask_t *mask ) {
+	const int	*fromW = (const int *)from;
+	const int	*toW = (const int *)to;
+	int			w;
+
+	if ( !map->fields ) {
+		MSG_BuildFieldMaps();
+	}
+
+	Com_Memset( mask, 0, sizeof( *mask ) );
+
+	w = 0;
+#ifdef MSG_SIMD_CHANGEMASK
+	for ( ; w + 4 <= map->numWords ; w += 4 ) {
+		__m128i	a = _mm_loadu_si128( (const __m128i *)( fromW + w ) );
+		__m128i	b = _mm_loadu_si128( (const __m128i *)( toW + w ) );
+		int		diff = ~_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( a, b ) ) ) & 15;
+		int		k;
+
+		if ( !diff ) {
+			continue;
+		}
+		for ( k = 0 ; k < 4 ; k++ ) {
+			if ( diff & ( 1 << k ) ) {
+				MSG_MarkFieldChanged( map, w + k, mask );
+			}
+		}
+	}
+#endif
+	for ( ; w < map->numWords ; w++ ) {
+		if ( fromW[w] != toW[w] ) {
+			MSG_MarkFieldChanged( map, w, mask );
+		}
+	}
+}
+
+/*
+==================
+MSG_UnchangedRun
+
+Number of unchanged fields from i on, before lc and at most 7, so they
+can go out as one write of raw zero bits.
+==================
+*/
+static QINLINE int MSG_UnchangedRun( const netChangeMask_t *mask, int i ) {
+	int		run;
+
+	for ( run = 1 ; run < 7 && i + run < mask->lc && !MSG_FieldChanged( mask, i + run ) ; run++ ) {
+	}
+
+	return run;
+}
+
+static netFieldMap_t	entityStateMap;
+
 /*
 ==================
 MSG_WriteDeltaEntity
@@ -1011,9 +1379,10 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 	int			i, lc;
 	int			numFields;
 	netField_t	*field;
-	int			trunc;
+	int			trunc, run;
 	float		fullFloat;
-	int			*fromF, *toF;
+	int			*toF;
+	netChangeMask_t	changed;
 
 	numFields = (int)ARRAY_LEN( entityStateFields );
 
@@ -1037,18 +1406,8 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 		Com_Error (ERR_FATAL, "MSG_WriteDeltaEntity: Bad entity number: %i", to->number );
 	}
 
-	lc = 0;
-	// build the change vector as bytes so it is endian independent
-	for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
-		toF = (int *)( (byte *)to + field->offset );
-		if ( *fromF != *toF ) {
-			lc = i+1;
-#ifndef FINAL_BUILD
-			field->mCount++;
-#endif
-		}
-	}
+	MSG_ChangeMask( &entityStateMap, from, to, &changed );
+	lc = changed.lc;
 
 	if ( lc == 0 ) {
 		// nothing at all changed
@@ -1071,14 +1430,16 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 	oldsize += numFields;
 
 	for ( i = 0, field = entityStateFields ; i < lc ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
-		toF = (int *)( (byte *)to + field->offset );
-
-		if ( *fromF == *toF ) {
-			MSG_WriteBits( msg, 0, 1 );	// no change
+		if ( !MSG_FieldChanged( &changed, i ) ) {
+			run = MSG_UnchangedRun( &changed, i );
+			MSG_WriteBits( msg, 0, run );	// no change
+			i += run - 1;
+			field += run - 1;
 			continue;
 		}
 
+		toF = (int *)( (byte *)to + field->offset );
+
 		MSG_WriteBits( msg, 1, 1 );	// changed
 
 		if ( field->bits == 0 ) {
@@ -1844,6 +2205,28 @@ netField_t	playerStateFields[] =
 #endif//_OPTIMIZED_VEHICLE_NETWORKING
 //=====_OPTIMIZED_VEHICLE_NETWORKING=======================================================================
 
+static netFieldMap_t	playerStateMap;
+#ifdef _OPTIMIZED_VEHICLE_NETWORKING
+static netFieldMap_t	pilotPlayerStateMap;
+static netFieldMap_t	vehPlayerStateMap;
+#endif
+
+/*
+==================
+MSG_BuildFieldMaps
+
+The field order never changes, the overrides only change the bits.
+==================
+*/
+static void MSG_BuildFieldMaps( void ) {
+	MSG_BuildFieldMap( &entityStateMap, entityStateFields, (int)ARRAY_LEN( entityStateFields ), sizeof( entityState_t ) );
+	MSG_BuildFieldMap( &playerStateMap, playerStateFields, (int)ARRAY_LEN( playerStateFields ), sizeof( playerState_t ) );
+#ifdef _OPTIMIZED_VEHICLE_NETWORKING
+	MSG_BuildFieldMap( &pilotPlayerStateMap, pilotPlayerStateFields, (int)ARRAY_LEN( pilotPlayerStateFields ), sizeof( playerState_t ) );
+	MSG_BuildFieldMap( &vehPlayerStateMap, vehPlayerStateFields, (int)ARRAY_LEN( vehPlayerStateFields ), sizeof( playerState_t ) );
+#endif
+}
+
 typedef struct bitStorage_s bitStorage_t;
 
 struct bitStorage_s
@@ -2073,9 +2456,11 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	int				numFields;
 	netField_t		*field;
 	netField_t		*PSFields = playerStateFields;
-	int				*fromF, *toF;
+	netFieldMap_t	*PSMap = &playerStateMap;
+	int				*toF;
 	float			fullFloat;
-	int				trunc, lc;
+	int				trunc, lc, run;
+	netChangeMask_t	changed;
 #ifdef _ONEBIT_COMBO
 	int				bitComboMask = 0;
 	int				numBitsInMask = 0;
@@ -2092,6 +2477,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	{//a vehicle playerstate
 		numFields = (int)ARRAY_LEN( vehPlayerStateFields );
 		PSFields = vehPlayerStateFields;
+		PSMap = &vehPlayerStateMap;
 	}
 	else
 	{//regular client playerstate
@@ -2101,6 +2487,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 			MSG_WriteBits( msg, 1, 1 );	// Pilot player state
 			numFields = (int)ARRAY_LEN( pilotPlayerStateFields );
 			PSFields = pilotPlayerStateFields;
+			PSMap = &pilotPlayerStateMap;
 		}
 		else
 		{//normal client
@@ -2113,17 +2500,8 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	numFields = (int)ARRAY_LEN( playerStateFields );
 #endif// _OPTIMIZED_VEHICLE_NETWORKING
 
-	lc = 0;
-	for ( i = 0, field = PSFields ; i < numFields ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
-		toF = (int *)( (byte *)to + field->offset );
-		if ( *fromF != *toF ) {
-			lc = i+1;
-#ifndef FINAL_BUILD
-			field->mCount++;
-#endif
-		}
-	}
+	MSG_ChangeMask( PSMap, from, to, &changed );
+	lc = changed.lc;
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
@@ -2134,7 +2512,6 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	oldsize += numFields - lc;
 
 	for ( i = 0, field = PSFields ; i < lc ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
 
 #ifdef _ONEBIT_COMBO
@@ -2145,12 +2522,20 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 			numBitsInMask++;
 			continue;
 		}
-#endif
 
-		if ( *fromF == *toF ) {
+		if ( !MSG_FieldChanged( &changed, i ) ) {
 			MSG_WriteBits( msg, 0, 1 );	// no change
 			continue;
 		}
+#else
+		if ( !MSG_FieldChanged( &changed, i ) ) {
+			run = MSG_UnchangedRun( &changed, i );
+			MSG_WriteBits( msg, 0, run );	// no change
+			i += run - 1;
+			field += run - 1;
+			continue;
+		}
+#endif
 
 		MSG_WriteBits( msg, 1, 1 );	// changed
 
@@ -3043,6 +3428,11 @@ void MSG_initHuffman() {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+
+#ifndef _NEWHUFFTABLE_
+	// the table dump needs every byte to go through the tree walker
+	Huff_BuildCodec( &msgHuff, &msgCodec );
+#endif
 }
 
 #else
@@ -3078,6 +3468,7 @@ void MSG_initHuffman() {
 	}
 	Com_Printf("};\n");
 	FS_FreeFile( data );
+	Huff_BuildCodec( &msgHuff, &msgCodec );
 	Cbuf_AddText( "condump dump.txt\n" );
 }
 
@@ -3093,6 +3484,248 @@ void MSG_shutdownHuffman()
 #endif // _NEWHUFFTABLE_
 }
 
+/*
+=================
+MSG_HuffCheck
+
+Writes and reads random bit fields with both the tree walker and the
+codec tables and compares the streams. Random garbage is decoded by
+both as well. Returns the number of mismatches.
+=================
+*/
+#define HUFFCHECK_MSGLEN	1400		// about the size of a full snapshot
+
+static int MSG_HuffCheck( int iterations ) {
+	static byte	treeData[HUFFCHECK_MSGLEN + 64], codecData[HUFFCHECK_MSGLEN + 64];
+	int			fieldBits[256], fieldValues[256];
+	msg_t		tree, codec;
+	int			i, j, numFields, errors;
+
+	errors = 0;
+	for ( i = 0 ; i < iterations ; i++ ) {
+		MSG_Init( &tree, treeData, sizeof( treeData ) );
+		MSG_Init( &codec, codecData, sizeof( codecData ) );
+
+		// random widths up to a full long, written with both coders
+		numFields = 1 + rand() % ARRAY_LEN( fieldBits );
+		for ( j = 0 ; j < numFields ; j++ ) {
+			int bits = 1 + rand() % 32;
+			int value = (int)( ( (unsigned)rand() << 16 ) ^ (unsigned)rand() );
+
+			if ( bits < 32 ) {
+				value &= ( 1 << bits ) - 1;
+			}
+			fieldBits[j] = bits;
+			fieldValues[j] = value;
+			MSG_WriteHuffTree( &tree, value, bits );
+			MSG_WriteHuffCodec( &codec, value, bits );
+		}
+
+		if ( tree.bit != codec.bit || memcmp( treeData, codecData, ( tree.bit + 7 ) >> 3 ) ) {
+			errors++;
+			continue;
+		}
+
+		// read them back both ways
+		tree.bit = codec.bit = 0;
+		for ( j = 0 ; j < numFields ; j++ ) {
+			int treeValue = MSG_ReadHuffTree( &tree, fieldBits[j] );
+			int codecValue = MSG_ReadHuffCodec( &codec, fieldBits[j] );
+
+			if ( treeValue != fieldValues[j] || codecValue != fieldValues[j] || tree.bit != codec.bit ) {
+				errors++;
+				break;
+			}
+		}
+
+		// garbage has to decode the same way too
+		for ( j = 0 ; j < HUFFCHECK_MSGLEN ; j++ ) {
+			treeData[j] = rand();
+		}
+		tree.bit = codec.bit = 0;
+		codec.data = treeData;
+		while ( tree.bit < ( HUFFCHECK_MSGLEN - 8 ) * 8 ) {
+			int bits = 1 + rand() % 32;
+
+			if ( MSG_ReadHuffTree( &tree, bits ) != MSG_ReadHuffCodec( &codec, bits ) || tree.bit != codec.bit ) {
+				errors++;
+				break;
+			}
+		}
+	}
+
+	return errors;
+}
+
+/*
+=================
+MSG_HuffBench_f
+
+msg_huffbench [iterations]
+
+Checks the codec tables against the tree walker, then measures both on
+snapshot sized messages.
+=================
+*/
+void MSG_HuffBench_f( void ) {
+	static byte	data[HUFFCHECK_MSGLEN + 64];
+	static int	fieldBits[HUFFCHECK_MSGLEN], fieldValues[HUFFCHECK_MSGLEN];
+	msg_t		msg;
+	int			iterations, errors, numFields, bytes, pass, i, j, start;
+	float		msec[2][2];
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+
+	if ( !msgCodec.valid ) {
+		Com_Printf( "The huffman codec tables are not in use.\n" );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000;
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	errors = MSG_HuffCheck( iterations );
+	Com_Printf( "%i random messages checked, %i mismatches, longest code %i bits\n", iterations, errors, msgCodec.maxLength );
+
+	// a mix of the field widths snapshots use
+	numFields = 0;
+	bytes = 0;
+	while ( bytes < HUFFCHECK_MSGLEN - 8 ) {
+		static const int widths[] = { 1, 8, 16, 32, 10, 24 };
+		int bits = widths[rand() % ARRAY_LEN( widths )];
+
+		fieldBits[numFields] = bits;
+		fieldValues[numFields] = (int)( ( (unsigned)rand() << 16 ) ^ (unsigned)rand() ) & ( bits < 32 ? ( 1 << bits ) - 1 : -1 );
+		numFields++;
+
+		MSG_Init( &msg, data, sizeof( data ) );
+		for ( j = 0 ; j < numFields ; j++ ) {
+			MSG_WriteHuffTree( &msg, fieldValues[j], fieldBits[j] );
+		}
+		bytes = ( msg.bit + 7 ) >> 3;
+	}
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		start = Sys_Milliseconds();
+		for ( i = 0 ; i < iterations ; i++ ) {
+			MSG_Init( &msg, data, sizeof( data ) );
+			for ( j = 0 ; j < numFields ; j++ ) {
+				if ( pass ) {
+					MSG_WriteHuffCodec( &msg, fieldValues[j], fieldBits[j] );
+				} else {
+					MSG_WriteHuffTree( &msg, fieldValues[j], fieldBits[j] );
+				}
+			}
+		}
+		msec[pass][0] = Q_max( 1, Sys_Milliseconds() - start );
+
+		start = Sys_Milliseconds();
+		for ( i = 0 ; i < iterations ; i++ ) {
+			msg.bit = 0;
+			for ( j = 0 ; j < numFields ; j++ ) {
+				if ( pass ) {
+					MSG_ReadHuffCodec( &msg, fieldBits[j] );
+				} else {
+					MSG_ReadHuffTree( &msg, fieldBits[j] );
+				}
+			}
+		}
+		msec[pass][1] = Q_max( 1, Sys_Milliseconds() - start );
+	}
+
+	Com_Printf( "%i byte messages, MB/s of coded data:\n", bytes );
+	Com_Printf( "tree:  write %8.1f  read %8.1f\n", bytes * (float)iterations / ( msec[0][0] * 1000.0f ), bytes * (float)iterations / ( msec[0][1] * 1000.0f ) );
+	Com_Printf( "codec: write %8.1f  read %8.1f\n", bytes * (float)iterations / ( msec[1][0] * 1000.0f ), bytes * (float)iterations / ( msec[1][1] * 1000.0f ) );
+}
+
+/*
+=================
+MSG_DeltaBench_f
+
+msg_deltabench [iterations]
+
+Compares the change masks against the field by field loop on random
+entity states and measures both.
+=================
+*/
+#define DELTABENCH_STATES	256
+
+void MSG_DeltaBench_f( void ) {
+	static entityState_t	from[DELTABENCH_STATES], to[DELTABENCH_STATES];
+	const int				numFields = (int)ARRAY_LEN( entityStateFields );
+	netChangeMask_t			changed;
+	int						iterations, errors, pass, i, j, k, lc, start;
+	int						msec[2];
+	volatile int			sum;	// keeps the loops from being optimized out
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 10000;
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	// most entities change a few fields per snapshot, some none at all
+	for ( i = 0 ; i < DELTABENCH_STATES ; i++ ) {
+		for ( j = 0 ; j < (int)( sizeof( from[i] ) / 4 ) ; j++ ) {
+			( (int *)&from[i] )[j] = rand();
+		}
+		to[i] = from[i];
+		for ( k = rand() % 6 ; k > 0 ; k-- ) {
+			j = rand() % numFields;
+			*(int *)( (byte *)&to[i] + entityStateFields[j].offset ) ^= 1 + rand();
+		}
+	}
+
+	errors = 0;
+	for ( i = 0 ; i < DELTABENCH_STATES ; i++ ) {
+		MSG_ChangeMask( &entityStateMap, &from[i], &to[i], &changed );
+
+		lc = 0;
+		for ( j = 0 ; j < numFields ; j++ ) {
+			qboolean differs = *(int *)( (byte *)&from[i] + entityStateFields[j].offset ) != *(int *)( (byte *)&to[i] + entityStateFields[j].offset ) ? qtrue : qfalse;
+
+			if ( differs ) {
+				lc = j + 1;
+			}
+			if ( differs != ( MSG_FieldChanged( &changed, j ) ? qtrue : qfalse ) ) {
+				errors++;
+			}
+		}
+		if ( lc != changed.lc ) {
+			errors++;
+		}
+	}
+	Com_Printf( "%i entity states checked, %i mismatches\n", DELTABENCH_STATES, errors );
+
+	sum = 0;
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		start = Sys_Milliseconds();
+		for ( k = 0 ; k < iterations ; k++ ) {
+			for ( i = 0 ; i < DELTABENCH_STATES ; i++ ) {
+				if ( pass ) {
+					MSG_ChangeMask( &entityStateMap, &from[i], &to[i], &changed );
+					sum += changed.lc;
+					continue;
+				}
+
+				lc = 0;
+				for ( j = 0 ; j < numFields ; j++ ) {
+					if ( *(int *)( (byte *)&from[i] + entityStateFields[j].offset ) != *(int *)( (byte *)&to[i] + entityStateFields[j].offset ) ) {
+						lc = j + 1;
+					}
+				}
+				sum += lc;
+			}
+		}
+		msec[pass] = Q_max( 1, Sys_Milliseconds() - start );
+	}
+
+	Com_Printf( "%i deltas: field loop %i msec, change mask %i msec\n", iterations * DELTABENCH_STATES, msec[0], msec[1] );
+}
+
 /*
 =================
 MSG_ReportChangeVectors_f
@@ -3110,16 +3743,14 @@ void MSG_ReportChangeVectors_f( void ) {
 	Com_Printf("Entity State Fields:\n");
 	for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ )
 	{
-		Com_Printf("%s\t\t%d\n", field->name, field->mCount);
-		field->mCount = 0;
+		Com_Printf("%s\t\t%u\n", field->name, field->mCount.exchange( 0 ));
 	}
 
 	Com_Printf("\nPlayer State Fields:\n");
 	numFields = (int)ARRAY_LEN( playerStateFields );
 	for ( i = 0, field = playerStateFields ; i < numFields ; i++, field++ )
 	{
-		Com_Printf("%s\t\t%d\n", field->name, field->mCount);
-		field->mCount = 0;
+		Com_Printf("%s\t\t%u\n", field->name, field->mCount.exchange( 0 ));
 	}
 
 }
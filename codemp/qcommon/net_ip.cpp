@@ -24,6 +24,12 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include "qcommon/qcommon.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #ifdef _WIN32
 	#include <winsock.h>
 
@@ -71,6 +77,12 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include <sys/filio.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <time.h>
+#define NET_MMSG	// epoll, recvmmsg and sendmmsg are available
+#endif
+
 typedef int SOCKET;
 #define INVALID_SOCKET                -1
 #define SOCKET_ERROR                        -1
@@ -96,6 +108,7 @@ static cvar_t	*net_ip;
 static cvar_t	*net_port;
 
 static cvar_t	*net_dropsim;
+static cvar_t	*net_recvThread;
 
 static struct sockaddr_in	socksRelayAddr;
 
@@ -106,6 +119,57 @@ static SOCKET	socks_socket = INVALID_SOCKET;
 static	int		numIP;
 static	byte	localIP[MAX_IPS][4];
 
+// receive thread, see NET_RecvThread
+#define	NET_RECV_QUEUE			512		// must be a power of two
+#define	NET_RECV_PACKETLEN		4096	// bigger datagrams are dropped as oversize
+
+typedef struct netRecvSlot_s {
+	struct sockaddr_in	from;
+	socklen_t			fromlen;
+	int					length;
+	int					time;			// Sys_Milliseconds when it was read
+	byte				data[NET_RECV_PACKETLEN];
+} netRecvSlot_t;
+
+static std::thread				netRecvThread;
+static std::mutex				netRecvMutex;
+static std::condition_variable	netRecvWake;
+static std::atomic<bool>		netRecvQuit;
+static std::atomic<unsigned>	netRecvHead;		// written by the receive thread only
+static std::atomic<unsigned>	netRecvTail;		// written by the main thread only
+static std::atomic<int>			netRecvDropped;
+static netRecvSlot_t			*netRecvQueue;
+static int						netPacketTime;		// arrival time of the packet being dispatched
+
+#ifdef NET_MMSG
+#define	NET_BATCH				32		// datagrams per recvmmsg/sendmmsg call
+#define	NET_BATCH_PACKETLEN		2048	// bigger outgoing packets skip the send batch
+
+static cvar_t	*net_batch;
+
+static int		epoll_fd = -1;
+
+// incoming ring
+static byte					netRecvData[NET_BATCH][MAX_MSGLEN + 1];
+static struct sockaddr_in	netRecvFrom[NET_BATCH];
+static struct iovec			netRecvIov[NET_BATCH];
+static struct mmsghdr		netRecvMsgs[NET_BATCH];
+
+// outgoing batch, filled by Sys_SendPacket between NET_BeginSendBatch and NET_FlushSendBatch
+static qboolean				netSendBatching;
+static int					netSendCount;
+static byte					netSendData[NET_BATCH][NET_BATCH_PACKETLEN];
+static struct sockaddr_in	netSendTo[NET_BATCH];
+static netadrtype_t			netSendType[NET_BATCH];
+static struct iovec			netSendIov[NET_BATCH];
+static struct mmsghdr		netSendMsgs[NET_BATCH];
+
+static void NET_Bench_f( void );
+#endif
+
+static void NET_StartRecvThread( void );
+static void NET_StopRecvThread( void );
+
 //=============================================================================
 
 /*
@@ -236,6 +300,42 @@ qboolean Sys_StringToAdr( const char *s, netadr_t *a ) {
 
 //=============================================================================
 
+/*
+==================
+NET_FinishPacket
+
+Sets up net_from and net_message for a datagram of ret bytes
+==================
+*/
+static qboolean NET_FinishPacket( struct sockaddr_in *from, socklen_t fromlen, int ret, netadr_t *net_from, msg_t *net_message ) {
+	memset( from->sin_zero, 0, 8 );
+
+	if ( usingSocks && memcmp( from, &socksRelayAddr, fromlen ) == 0 ) {
+		if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
+			return qfalse;
+		}
+		net_from->type = NA_IP;
+		net_from->ip[0] = net_message->data[4];
+		net_from->ip[1] = net_message->data[5];
+		net_from->ip[2] = net_message->data[6];
+		net_from->ip[3] = net_message->data[7];
+		memcpy( &net_from->port, &net_message->data[8], 2 );
+		net_message->readcount = 10;
+	}
+	else {
+		SockadrToNetadr( from, net_from );
+		net_message->readcount = 0;
+	}
+
+	if( ret >= net_message->maxsize ) {
+		Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
+		return qfalse;
+	}
+
+	net_message->cursize = ret;
+	return qtrue;
+}
+
 /*
 ==================
 NET_GetPacket
@@ -272,37 +372,118 @@ qboolean NET_GetPacket( netadr_t *net_from, msg_t *net_message, fd_set *fdr ) {
 		return qfalse;
 	}
 
-	memset( from.sin_zero, 0, 8 );
+	return NET_FinishPacket( &from, fromlen, ret, net_from, net_message );
+}
 
-	if ( usingSocks && memcmp( &from, &socksRelayAddr, fromlen ) == 0 ) {
-		if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
-			return qfalse;
-		}
-		net_from->type = NA_IP;
-		net_from->ip[0] = net_message->data[4];
-		net_from->ip[1] = net_message->data[5];
-		net_from->ip[2] = net_message->data[6];
-		net_from->ip[3] = net_message->data[7];
-		memcpy( &net_from->port, &net_message->data[8], 2 );
-		net_message->readcount = 10;
+//=============================================================================
+
+static char socksBuf[4096];
+
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( netadrtype_t type ) {
+	int err = socketError;
+
+	// wouldblock is silent
+	if( err == EAGAIN ) {
+		return;
 	}
-	else {
-		SockadrToNetadr( &from, net_from );
-		net_message->readcount = 0;
+
+	// some PPP links do not allow broadcasts and return an error
+	if( err == EADDRNOTAVAIL && type == NA_BROADCAST ) {
+		return;
 	}
 
-	if( ret >= net_message->maxsize ) {
-		Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
-		return qfalse;
+	Com_Printf( "NET_SendPacket: %s\n", NET_ErrorString() );
+}
+
+#ifdef NET_MMSG
+/*
+==================
+NET_FlushSendBatch
+
+Sends everything Sys_SendPacket queued up since NET_BeginSendBatch
+and goes back to sending packets right away.
+==================
+*/
+void NET_FlushSendBatch( void ) {
+	int		sent, ret;
+
+	netSendBatching = qfalse;
+
+	if ( ip_socket == INVALID_SOCKET ) {
+		netSendCount = 0;
+		return;
 	}
 
-	net_message->cursize = ret;
-	return qtrue;
+	for ( sent = 0 ; sent < netSendCount ; ) {
+		ret = sendmmsg( ip_socket, &netSendMsgs[sent], netSendCount - sent, 0 );
+		if ( ret == SOCKET_ERROR ) {
+			// the first packet failed, report it and carry on with the rest
+			NET_SendError( netSendType[sent] );
+			sent++;
+			continue;
+		}
+		sent += ret;
+	}
+
+	netSendCount = 0;
 }
 
-//=============================================================================
+/*
+==================
+NET_BeginSendBatch
 
-static char socksBuf[4096];
+Queue packets from Sys_SendPacket until NET_FlushSendBatch and
+send them with as few syscalls as possible.
+==================
+*/
+void NET_BeginSendBatch( void ) {
+	if ( netSendCount ) {
+		NET_FlushSendBatch();
+	}
+
+	netSendBatching = (qboolean)( net_batch && net_batch->integer && ip_socket != INVALID_SOCKET );
+}
+
+/*
+==================
+NET_QueuePacket
+==================
+*/
+static void NET_QueuePacket( const void *header, int headerLength, int length, const void *data, struct sockaddr_in *addr, netadrtype_t type ) {
+	int		i = netSendCount++;
+
+	if ( headerLength ) {
+		memcpy( netSendData[i], header, headerLength );
+	}
+	memcpy( netSendData[i] + headerLength, data, length );
+	netSendTo[i] = *addr;
+	netSendType[i] = type;
+
+	netSendIov[i].iov_base = netSendData[i];
+	netSendIov[i].iov_len = headerLength + length;
+	memset( &netSendMsgs[i], 0, sizeof( netSendMsgs[i] ) );
+	netSendMsgs[i].msg_hdr.msg_name = &netSendTo[i];
+	netSendMsgs[i].msg_hdr.msg_namelen = sizeof( netSendTo[i] );
+	netSendMsgs[i].msg_hdr.msg_iov = &netSendIov[i];
+	netSendMsgs[i].msg_hdr.msg_iovlen = 1;
+
+	if ( netSendCount == NET_BATCH ) {
+		NET_FlushSendBatch();
+		netSendBatching = qtrue;
+	}
+}
+#else
+void NET_BeginSendBatch( void ) {
+}
+
+void NET_FlushSendBatch( void ) {
+}
+#endif
 
 /*
 ==================
@@ -324,6 +505,32 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 
 	NetadrToSockadr( &to, &addr );
 
+#ifdef NET_MMSG
+	if ( netSendBatching ) {
+		if ( length + 10 <= NET_BATCH_PACKETLEN ) {
+			if( usingSocks && to.type == NA_IP ) {
+				byte header[10];
+
+				header[0] = 0;	// reserved
+				header[1] = 0;
+				header[2] = 0;	// fragment (not fragmented)
+				header[3] = 1;	// address type: IPV4
+				memcpy( &header[4], &addr.sin_addr, 4 );
+				memcpy( &header[8], &addr.sin_port, 2 );
+				NET_QueuePacket( header, 10, length, data, &socksRelayAddr, to.type );
+			}
+			else {
+				NET_QueuePacket( NULL, 0, length, data, &addr, to.type );
+			}
+			return;
+		}
+
+		// too big for a batch slot, keep the order and send it on its own
+		NET_FlushSendBatch();
+		netSendBatching = qtrue;
+	}
+#endif
+
 	if( usingSocks && to.type == NA_IP ) {
 		socksBuf[0] = 0;	// reserved
 		socksBuf[1] = 0;
@@ -338,19 +545,7 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 		ret = sendto( ip_socket, (const char *)data, length, 0, (sockaddr *)&addr, sizeof(addr) );
 	}
 	if( ret == SOCKET_ERROR ) {
-		int err = socketError;
-
-		// wouldblock is silent
-		if( err == EAGAIN ) {
-			return;
-		}
-
-		// some PPP links do not allow broadcasts and return an error
-		if( err == EADDRNOTAVAIL && to.type == NA_BROADCAST ) {
-			return;
-		}
-
-		Com_Printf( "NET_SendPacket: %s\n", NET_ErrorString() );
+		NET_SendError( to.type );
 	}
 }
 
@@ -849,6 +1044,53 @@ void NET_OpenIP( void )
 	}
 }
 
+#ifdef NET_MMSG
+/*
+====================
+NET_OpenEpoll
+====================
+*/
+static void NET_OpenEpoll( void ) {
+	struct epoll_event	ev;
+
+	if ( ip_socket == INVALID_SOCKET ) {
+		return;
+	}
+
+	epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+	if ( epoll_fd == -1 ) {
+		Com_Printf( "WARNING: NET_OpenEpoll: epoll_create1: %s\n", NET_ErrorString() );
+		return;
+	}
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.fd = ip_socket;
+	if ( epoll_ctl( epoll_fd, EPOLL_CTL_ADD, ip_socket, &ev ) == -1 ) {
+		Com_Printf( "WARNING: NET_OpenEpoll: epoll_ctl: %s\n", NET_ErrorString() );
+		close( epoll_fd );
+		epoll_fd = -1;
+	}
+}
+
+/*
+====================
+NET_CloseEpoll
+====================
+*/
+static void NET_CloseEpoll( void ) {
+	if ( netSendCount ) {
+		NET_FlushSendBatch();
+	}
+	netSendBatching = qfalse;
+
+	if ( epoll_fd != -1 ) {
+		close( epoll_fd );
+		epoll_fd = -1;
+	}
+}
+#endif
+
 //===================================================================
 
 /*
@@ -897,6 +1139,14 @@ static qboolean NET_GetCvars( void ) {
 
 	net_dropsim = Cvar_Get( "net_dropsim", "", CVAR_TEMP);
 
+	net_recvThread = Cvar_Get( "net_recvThread", "0", CVAR_LATCH | CVAR_ARCHIVE, "Read the game socket on its own thread so packets are timestamped on arrival" );
+	modified += net_recvThread->modified;
+	net_recvThread->modified = qfalse;
+
+#ifdef NET_MMSG
+	net_batch = Cvar_Get( "net_batch", "1", CVAR_ARCHIVE, "Wait with epoll and move packets with recvmmsg/sendmmsg" );
+#endif
+
 	return modified ? qtrue : qfalse;
 }
 
@@ -943,6 +1193,12 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if ( stop ) {
+		NET_StopRecvThread();
+
+#ifdef NET_MMSG
+		NET_CloseEpoll();
+#endif
+
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -957,6 +1213,13 @@ void NET_Config( qboolean enableNetworking ) {
 	if ( start ) {
 		if ( net_enabled->integer )
 			NET_OpenIP();
+
+#ifdef NET_MMSG
+		NET_OpenEpoll();
+#endif
+
+		if ( net_recvThread->integer )
+			NET_StartRecvThread();
 	}
 }
 
@@ -980,6 +1243,9 @@ void NET_Init( void ) {
 	NET_Config( qtrue );
 
 	Cmd_AddCommand ("net_restart", NET_Restart_f, "Restart the networking sub-system" );
+#ifdef NET_MMSG
+	Cmd_AddCommand ("net_bench", NET_Bench_f, "Measure packets per second over loopback with and without batching" );
+#endif
 }
 
 /*
@@ -999,6 +1265,26 @@ void NET_Shutdown( void ) {
 #endif
 }
 
+/*
+====================
+NET_DispatchPacket
+====================
+*/
+static void NET_DispatchPacket( netadr_t *from, msg_t *netmsg )
+{
+	if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+	{
+		// com_dropsim->value percent of incoming packets get dropped.
+		if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
+			return;          // drop this packet
+	}
+
+	if(com_sv_running->integer)
+		Com_RunAndTimeServerPacket(from, netmsg);
+	else
+		CL_PacketEvent(*from, netmsg);
+}
+
 /*
 ====================
 NET_Event
@@ -1018,22 +1304,265 @@ void NET_Event(fd_set *fdr)
 		MSG_Init(&netmsg, bufData, sizeof(bufData));
 
 		if(NET_GetPacket(&from, &netmsg, fdr))
+			NET_DispatchPacket(&from, &netmsg);
+		else
+			break;
+	}
+}
+
+#ifdef NET_MMSG
+/*
+====================
+NET_ReceiveBatch
+
+Reads up to NET_BATCH datagrams from sock into the receive ring with one
+syscall.  Returns the number read, or -1 if nothing could be read.
+====================
+*/
+static int NET_ReceiveBatch( SOCKET sock )
+{
+	int i, count, err;
+
+	for(i = 0; i < NET_BATCH; i++)
+	{
+		netRecvIov[i].iov_base = netRecvData[i];
+		netRecvIov[i].iov_len = sizeof(netRecvData[i]);
+		memset(&netRecvMsgs[i], 0, sizeof(netRecvMsgs[i]));
+		netRecvMsgs[i].msg_hdr.msg_name = &netRecvFrom[i];
+		netRecvMsgs[i].msg_hdr.msg_namelen = sizeof(netRecvFrom[i]);
+		netRecvMsgs[i].msg_hdr.msg_iov = &netRecvIov[i];
+		netRecvMsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	count = recvmmsg(sock, netRecvMsgs, NET_BATCH, MSG_DONTWAIT, NULL);
+	if(count == SOCKET_ERROR)
+	{
+		err = socketError;
+		if(err != EAGAIN && err != ECONNRESET)
+			Com_Printf("NET_ReceiveBatch: %s\n", NET_ErrorString());
+		return -1;
+	}
+
+	return count;
+}
+
+/*
+====================
+NET_EventBatch
+
+Like NET_Event, but drains the socket NET_BATCH datagrams at a time.
+====================
+*/
+static void NET_EventBatch(void)
+{
+	netadr_t from;
+	msg_t netmsg;
+	int i, count;
+
+	while(ip_socket != INVALID_SOCKET)
+	{
+		count = NET_ReceiveBatch(ip_socket);
+		if(count <= 0)
+			break;
+
+		for(i = 0; i < count; i++)
 		{
-			if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+			MSG_Init(&netmsg, netRecvData[i], sizeof(netRecvData[i]));
+
+			if(NET_FinishPacket(&netRecvFrom[i], netRecvMsgs[i].msg_hdr.msg_namelen, netRecvMsgs[i].msg_len, &from, &netmsg))
+				NET_DispatchPacket(&from, &netmsg);
+		}
+
+		if(count < NET_BATCH)
+			break;		// socket is empty
+	}
+}
+#endif
+
+/*
+=============================================================================
+
+RECEIVE THREAD
+
+With net_recvThread the game socket is read by a thread of its own that
+copies datagrams into a single producer, single consumer ring along with
+the time they arrived.  The main thread only ever touches the ring, so
+packets keep being picked up while a frame or a map load runs long, and
+the server can measure pings without rounding to whole frames.
+
+=============================================================================
+*/
+
+/*
+====================
+NET_RecvThread
+====================
+*/
+static void NET_RecvThread( SOCKET sock )
+{
+	byte discard[NET_RECV_PACKETLEN];
+
+	while(!netRecvQuit.load(std::memory_order_relaxed))
+	{
+		struct timeval timeout;
+		fd_set fdr;
+		bool received = false;
+
+		// wake up now and then to see if we should quit
+		FD_ZERO(&fdr);
+		FD_SET(sock, &fdr);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100000;
+
+		if(select(sock + 1, &fdr, NULL, NULL, &timeout) <= 0)
+			continue;
+
+		// drain the socket
+		while(1)
+		{
+			unsigned head = netRecvHead.load(std::memory_order_relaxed);
+			netRecvSlot_t *slot = &netRecvQueue[head & (NET_RECV_QUEUE - 1)];
+			bool full = head - netRecvTail.load(std::memory_order_acquire) >= NET_RECV_QUEUE;
+			int ret;
+
+			slot->fromlen = sizeof(slot->from);
+			if(full)
 			{
-				// com_dropsim->value percent of incoming packets get dropped.
-				if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
-					continue;          // drop this packet
+				struct sockaddr_in from;
+				socklen_t fromlen = sizeof(from);
+
+				ret = recvfrom(sock, (char *)discard, sizeof(discard), 0, (struct sockaddr *)&from, &fromlen);
+				if(ret == SOCKET_ERROR)
+					break;
+				netRecvDropped++;
+				continue;
 			}
 
-			if(com_sv_running->integer)
-				Com_RunAndTimeServerPacket(&from, &netmsg);
-			else
-				CL_PacketEvent(from, &netmsg);
+			// errors can't be printed from here, they show up as missing packets
+			ret = recvfrom(sock, (char *)slot->data, sizeof(slot->data), 0, (struct sockaddr *)&slot->from, &slot->fromlen);
+			if(ret == SOCKET_ERROR)
+				break;
+
+			slot->length = ret;
+			slot->time = Sys_Milliseconds();
+			netRecvHead.store(head + 1, std::memory_order_release);
+			received = true;
 		}
-		else
+
+		if(received)
+		{
+			std::lock_guard<std::mutex> lock(netRecvMutex);
+			netRecvWake.notify_one();
+		}
+	}
+}
+
+/*
+====================
+NET_StartRecvThread
+====================
+*/
+static void NET_StartRecvThread( void )
+{
+	if(ip_socket == INVALID_SOCKET || netRecvThread.joinable())
+		return;
+
+	netRecvQueue = (netRecvSlot_t *)Z_Malloc(NET_RECV_QUEUE * sizeof(netRecvSlot_t), TAG_GENERAL, qfalse);
+	netRecvHead.store(0);
+	netRecvTail.store(0);
+	netRecvDropped.store(0);
+	netRecvQuit.store(false);
+
+	netRecvThread = std::thread(NET_RecvThread, ip_socket);
+	Com_Printf("Started the network receive thread\n");
+}
+
+/*
+====================
+NET_StopRecvThread
+
+Packets still in the queue are lost, just like the ones in the socket.
+====================
+*/
+static void NET_StopRecvThread( void )
+{
+	if(!netRecvThread.joinable())
+		return;
+
+	netRecvQuit.store(true);
+	netRecvThread.join();
+
+	Z_Free(netRecvQueue);
+	netRecvQueue = NULL;
+}
+
+/*
+====================
+NET_EventRecvQueue
+
+Dispatches everything the receive thread has queued up.
+====================
+*/
+static void NET_EventRecvQueue( void )
+{
+	byte bufData[NET_RECV_PACKETLEN];
+	struct sockaddr_in sockFrom;
+	socklen_t fromlen;
+	netadr_t from;
+	msg_t netmsg;
+	int length, dropped;
+
+	dropped = netRecvDropped.exchange(0);
+	if(dropped)
+		Com_Printf("Warning: network receive queue was full, dropped %i packets\n", dropped);
+
+	while(netRecvQueue)
+	{
+		unsigned tail = netRecvTail.load(std::memory_order_relaxed);
+		netRecvSlot_t *slot;
+
+		if(tail == netRecvHead.load(std::memory_order_acquire))
 			break;
+
+		// hand the slot back before the packet is handled, so an error
+		// thrown from the server doesn't get it dispatched again
+		slot = &netRecvQueue[tail & (NET_RECV_QUEUE - 1)];
+		MSG_Init(&netmsg, bufData, sizeof(bufData));
+		length = slot->length;
+		memcpy(bufData, slot->data, length);
+		sockFrom = slot->from;
+		fromlen = slot->fromlen;
+		netPacketTime = slot->time;
+		netRecvTail.store(tail + 1, std::memory_order_release);
+
+		if(NET_FinishPacket(&sockFrom, fromlen, length, &from, &netmsg))
+			NET_DispatchPacket(&from, &netmsg);
 	}
+
+	netPacketTime = 0;
+}
+
+/*
+====================
+NET_ReceiveThreadActive
+====================
+*/
+qboolean NET_ReceiveThreadActive( void )
+{
+	return netRecvThread.joinable() ? qtrue : qfalse;
+}
+
+/*
+====================
+NET_PacketTime
+
+Sys_Milliseconds when the packet that is being dispatched arrived, or 0
+if it didn't come from the receive thread.
+====================
+*/
+int NET_PacketTime( void )
+{
+	return netPacketTime;
 }
 
 /*
@@ -1052,6 +1581,43 @@ void NET_Sleep( int msec ) {
 	if (msec < 0)
 		msec = 0;
 
+	netPacketTime = 0;
+
+#ifdef NET_MMSG
+	// a batch that was cut short by an error still has to go out
+	if ( netSendBatching || netSendCount ) {
+		NET_FlushSendBatch();
+	}
+#endif
+
+	if ( netRecvThread.joinable() ) {
+		{
+			std::unique_lock<std::mutex> lock( netRecvMutex );
+			netRecvWake.wait_for( lock, std::chrono::milliseconds( msec ), [] {
+				return netRecvHead.load() != netRecvTail.load() || netRecvDropped.load() != 0;
+			} );
+		}
+		NET_EventRecvQueue();
+		return;
+	}
+
+#ifdef NET_MMSG
+
+	if ( net_batch->integer && epoll_fd != -1 ) {
+		struct epoll_event ev;
+
+		retval = epoll_wait( epoll_fd, &ev, 1, msec );
+		if ( retval == SOCKET_ERROR ) {
+			if ( socketError != EINTR )
+				Com_Printf( "Warning: epoll_wait() syscall failed: %s\n", NET_ErrorString() );
+		}
+		else if ( retval > 0 ) {
+			NET_EventBatch();
+		}
+		return;
+	}
+#endif
+
 	FD_ZERO(&fdset);
 	if (ip_socket != INVALID_SOCKET) {
 		FD_SET(ip_socket, &fdset); // network socket
@@ -1079,6 +1645,125 @@ void NET_Sleep( int msec ) {
 		NET_Event(&fdset);
 }
 
+#ifdef NET_MMSG
+#define NET_BENCH_BURST		64
+
+static double NET_BenchSeconds( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+====================
+NET_Bench_f
+
+Floods a private loopback socket from a second one and times sending and
+receiving with one syscall per packet against the batched calls.  The game
+socket isn't touched, so clients keep getting their packets read.
+====================
+*/
+static void NET_Bench_f( void ) {
+	static const char	payload[] = "\xff\xff\xff\xffgetstatus\n";
+	struct sockaddr_in	dest, from;
+	socklen_t			len;
+	struct mmsghdr		msgs[NET_BENCH_BURST];
+	struct iovec		iov;
+	byte				buf[MAX_MSGLEN + 1];
+	SOCKET				sender, receiver;
+	u_long				_true = 1;
+	int					packets, batched, i, n;
+
+	packets = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100000;
+	packets = Com_Clampi( NET_BENCH_BURST, 10000000, packets );
+
+	receiver = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( receiver == INVALID_SOCKET ) {
+		Com_Printf( "NET_Bench_f: socket: %s\n", NET_ErrorString() );
+		return;
+	}
+
+	memset( &dest, 0, sizeof( dest ) );
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	dest.sin_port = 0;
+
+	len = sizeof( dest );
+	if ( ioctlsocket( receiver, FIONBIO, &_true ) == SOCKET_ERROR
+		|| bind( receiver, (const struct sockaddr *)&dest, sizeof( dest ) ) == SOCKET_ERROR
+		|| getsockname( receiver, (struct sockaddr *)&dest, &len ) == SOCKET_ERROR ) {
+		Com_Printf( "NET_Bench_f: %s\n", NET_ErrorString() );
+		closesocket( receiver );
+		return;
+	}
+
+	sender = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( sender == INVALID_SOCKET ) {
+		Com_Printf( "NET_Bench_f: socket: %s\n", NET_ErrorString() );
+		closesocket( receiver );
+		return;
+	}
+
+	iov.iov_base = (void *)payload;
+	iov.iov_len = sizeof( payload ) - 1;
+	memset( msgs, 0, sizeof( msgs ) );
+	for ( i = 0 ; i < NET_BENCH_BURST ; i++ ) {
+		msgs[i].msg_hdr.msg_name = &dest;
+		msgs[i].msg_hdr.msg_namelen = sizeof( dest );
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for ( batched = 0 ; batched < 2 ; batched++ ) {
+		double	sendTime = 0, recvTime = 0, start;
+		int		sent = 0, received = 0;
+
+		while ( sent < packets ) {
+			// the burst has to fit in the socket buffer, or the kernel drops some
+			start = NET_BenchSeconds();
+			if ( batched ) {
+				n = sendmmsg( sender, msgs, NET_BENCH_BURST, 0 );
+				if ( n > 0 ) {
+					sent += n;
+				}
+			} else {
+				for ( i = 0 ; i < NET_BENCH_BURST ; i++ ) {
+					if ( sendto( sender, payload, sizeof( payload ) - 1, 0, (struct sockaddr *)&dest, sizeof( dest ) ) != SOCKET_ERROR ) {
+						sent++;
+					}
+				}
+			}
+			sendTime += NET_BenchSeconds() - start;
+
+			start = NET_BenchSeconds();
+			if ( batched ) {
+				while ( ( n = NET_ReceiveBatch( receiver ) ) > 0 ) {
+					received += n;
+				}
+			} else {
+				for ( ;; ) {
+					len = sizeof( from );
+					if ( recvfrom( receiver, (char *)buf, sizeof( buf ), 0, (struct sockaddr *)&from, &len ) == SOCKET_ERROR ) {
+						break;
+					}
+					received++;
+				}
+			}
+			recvTime += NET_BenchSeconds() - start;
+		}
+
+		Com_Printf( "%-18s send %9.0f pps, receive %9.0f pps (%i/%i packets)\n",
+			batched ? "recvmmsg/sendmmsg:" : "recvfrom/sendto:",
+			sendTime > 0 ? sent / sendTime : 0.0, recvTime > 0 ? received / recvTime : 0.0,
+			received, sent );
+	}
+
+	closesocket( sender );
+	closesocket( receiver );
+}
+#endif
+
 /*
 ====================
 NET_Restart_f
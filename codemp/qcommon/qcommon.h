@@ -56,6 +56,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteBitRun( msg_t *msg, const byte *data, int bits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -101,6 +102,8 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct pl
 #ifndef FINAL_BUILD
 void MSG_ReportChangeVectors_f( void );
 #endif
+void MSG_HuffBench_f( void );
+void MSG_DeltaBench_f( void );
 
 //============================================================================
 
@@ -148,8 +151,12 @@ const char	*NET_AdrToString (netadr_t a);
 qboolean	NET_StringToAdr ( const char *s, netadr_t *a);
 qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_message);
 void		NET_Sleep(int msec);
+qboolean	NET_ReceiveThreadActive( void );
+int			NET_PacketTime( void );		// arrival time of the current packet with net_recvThread
 
 void		Sys_SendPacket( int length, const void *data, netadr_t to );
+void		NET_BeginSendBatch( void );	// queue Sys_SendPacket calls ...
+void		NET_FlushSendBatch( void );	// ... and send them together
 //Does NOT parse port numbers, only base addresses.
 qboolean	Sys_StringToAdr( const char *s, netadr_t *a );
 qboolean	Sys_IsLANAddress (netadr_t adr);
@@ -164,6 +171,31 @@ void		Sys_ShowIP(void);
 #define MAX_DOWNLOAD_WINDOW			8		// max of eight download frames
 #define MAX_DOWNLOAD_BLKSIZE		2048	// 2048 byte block chunks
 
+/*
+Compressed container for server side demos, written with sv_demoCompress 1.
+
+header		DEMO_CONTAINER_MAGIC, DEMO_CONTAINER_VERSION
+blocks		int type, int packedLen, int rawLen, int time, packedLen bytes of zlib data
+index		a DEMO_BLOCK_INDEX block of { time, file offset } for every keyframe
+trailer		int offset of the index block, DEMO_INDEX_MAGIC
+
+DEMO_BLOCK_MESSAGES unpack to the usual demo stream of { sequence, length, message }.
+DEMO_BLOCK_KEYFRAME unpack to a single gamestate record that playback can start
+from, the messages block after it starts with a non-delta snapshot.  Linear
+playback skips keyframes.  Times are msec since the start of the recording.
+*/
+#define DEMO_CONTAINER_MAGIC		0x5A444B4A	// "JKDZ"
+#define DEMO_INDEX_MAGIC			0x58444B4A	// "JKDX"
+#define DEMO_CONTAINER_VERSION		1
+
+#define DEMO_BLOCK_MESSAGES			1
+#define DEMO_BLOCK_KEYFRAME			2
+#define DEMO_BLOCK_INDEX			3
+
+#define DEMO_BLOCK_SIZE				( 128 * 1024 )							// max unpacked size
+#define DEMO_BLOCK_PACKED_SIZE		( DEMO_BLOCK_SIZE + ( DEMO_BLOCK_SIZE >> 8 ) + 64 )	// >= zlib's compressBound
+#define DEMO_MAX_KEYFRAMES			( DEMO_BLOCK_SIZE / 8 )					// so the index fits a block
+
 
 /*
 Netchan handles packet fragmentation and out of order / duplicate suppression
@@ -478,6 +510,9 @@ void	Cvar_Register( vmCvar_t *vmCvar, const char *varName, const char *defaultVa
 void	Cvar_Update( vmCvar_t *vmCvar );
 // updates an interpreted modules' version of a cvar
 
+int		Cvar_Changes( int *sequence, int *handles, int maxHandles );
+// lists the handles of the cvars changed since *sequence, -1 if all may have
+
 cvar_t	*Cvar_Set2(const char *var_name, const char *value, uint32_t defaultFlags, qboolean force);
 //
 
@@ -630,6 +665,9 @@ qboolean FS_FindPureDLL(const char *name);
 
 int		FS_Write( const void *buffer, int len, fileHandle_t f );
 
+FILE	*FS_FileForHandle( fileHandle_t f );
+// the stdio file behind a handle that isn't in a pak, for writing it from another thread
+
 int		FS_Read( void *buffer, int len, fileHandle_t f );
 // properly handles partial reads and reads from other dlls
 
@@ -812,6 +850,7 @@ extern	cvar_t	*sv_paused;
 extern	int		time_game;
 extern	int		time_frontend;
 extern	int		time_backend;		// renderer backend time
+extern	int		time_demo;			// server demo writing on the main thread
 
 extern	int		com_frameTime;
 
@@ -1038,6 +1077,25 @@ typedef struct huffman_s {
 	huff_t		decompressor;
 } huffman_t;
 
+// flat tables for a tree that no longer changes, codes are stored in the
+// order their bits go out so they can be or'ed into a bit buffer
+#define HUFF_LOOKUP_BITS	11
+#define HUFF_MAX_CODE		32		// longer codes leave the codec invalid
+
+typedef struct huffLookup_s {
+	short		symbol;		// -1 if the code is longer than HUFF_LOOKUP_BITS
+	short		length;
+} huffLookup_t;
+
+typedef struct huffCodec_s {
+	qboolean		valid;
+	int				maxLength;
+	uint32_t		code[HMAX];
+	byte			length[HMAX];
+	node_t			*tree;		// decompressor root for the long codes
+	huffLookup_t	lookup[1<<HUFF_LOOKUP_BITS];
+} huffCodec_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1048,6 +1106,7 @@ void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset);
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset);
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
+void	Huff_BuildCodec( huffman_t *huff, huffCodec_t *codec );
 
 extern huffman_t clientHuffTables;
 
@@ -1065,6 +1124,12 @@ inline int Round(float value)
 bool PD_Store ( const char *name, const void *data, size_t size );
 const void *PD_Load ( const char *name, size_t *size );
 
+// Worker pool for splitting independent per-frame work, see jobs.cpp
+typedef void (*jobFunc_t)( void *data, int index );
+void		Com_RunJobs( jobFunc_t func, void *data, int count );
+int			Com_JobWorkers( void );
+void		Com_ShutdownJobs( void );
+
 uint32_t ConvertUTF8ToUTF32( char *utf8CurrentChar, char **utf8NextChar );
 
 #include "sys/sys_public.h"
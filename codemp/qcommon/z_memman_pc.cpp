@@ -39,6 +39,7 @@ const static char *psTagStrings[TAG_COUNT+1]=	// +1 because TAG_COUNT will itsel
 
 static void Z_Details_f(void);
 void CIN_CloseAllVideos();
+void ICARUS_PoolStats(void);
 
 
 // This handles zone memory allocation.
@@ -66,6 +67,51 @@ static inline zoneTail_t *ZoneTailFromHeader(zoneHeader_t *pHeader)
 	return (zoneTail_t*) ( (char*)pHeader + sizeof(*pHeader) + pHeader->iSize );
 }
 
+// The hunk tags only ever go away as a whole with Z_TagFree, so their blocks
+//	are bump allocated from big chunks (arenas) rather than getting a malloc each.
+//	Arena blocks keep the usual header and tail but aren't linked into the tag
+//	list, instead pPrev is NULL and pNext points at the owning chunk. A chunk
+//	goes back to the system once all of its blocks are freed.
+//
+#define ZONE_ARENA_CHUNK_SIZE	(1024*1024)
+#define ZONE_ARENA_MAX_BLOCK	(ZONE_ARENA_CHUNK_SIZE/4)	// anything larger gets its own malloc
+#define ZONE_ARENA_ALIGN		16
+#define ZONE_ARENA_SPARE_CHUNKS	32							// freed chunks kept for the next map
+#define ZONE_FREED_MAGIC		0x78563412					// arena block that has been freed
+
+typedef struct zoneArenaChunk_s
+{
+struct	zoneArenaChunk_s	*pNext;
+struct	zoneArenaChunk_s	*pPrev;
+		memtag_t			eTag;
+		int					iUsed;		// bytes handed out so far
+		int					iLive;		// blocks not freed yet
+} zoneArenaChunk_t;
+
+#define ZONE_ARENA_CHUNK_HEADER	((sizeof(zoneArenaChunk_t) + ZONE_ARENA_ALIGN - 1) & ~(ZONE_ARENA_ALIGN - 1))
+#define ZONE_ARENA_CHUNK_SPACE	(ZONE_ARENA_CHUNK_SIZE - (int)ZONE_ARENA_CHUNK_HEADER)
+
+static inline bool Zone_IsArenaTag(memtag_t eTag)
+{
+	return eTag == TAG_HUNK_MARK1 || eTag == TAG_HUNK_MARK2;
+}
+
+// only valid for non-static blocks, those have no links either
+static inline bool Zone_IsArenaBlock(zoneHeader_t *pHeader)
+{
+	return pHeader->pPrev == NULL;
+}
+
+static inline int Zone_ArenaBlockSize(int iSize)
+{
+	return (sizeof(zoneHeader_t) + iSize + sizeof(zoneTail_t) + ZONE_ARENA_ALIGN - 1) & ~(ZONE_ARENA_ALIGN - 1);
+}
+
+static inline zoneHeader_t *Zone_ArenaBlock(zoneArenaChunk_t *pChunk, int iOffset)
+{
+	return (zoneHeader_t *) ( (char*)pChunk + ZONE_ARENA_CHUNK_HEADER + iOffset );
+}
+
 #ifdef DETAILED_ZONE_DEBUG_CODE
 map <void*,int> mapAllocatedZones;
 #endif
@@ -88,7 +134,11 @@ typedef struct zoneStats_s
 typedef struct zone_s
 {
 	zoneStats_t				Stats;
-	zoneHeader_t			Header;
+	zoneHeader_t			Headers[TAG_COUNT];		// malloced blocks of each tag
+	zoneArenaChunk_t		*pArenas[TAG_COUNT];	// arena chunks of each tag, newest first
+	zoneArenaChunk_t		*pSpareChunks;			// freed chunks, saves the OS mapping them in again
+	int						iArenaChunks;
+	int						iSpareChunks;
 } zone_t;
 
 cvar_t	*com_validateZone;
@@ -98,6 +148,31 @@ zone_t	TheZone = {};
 
 // Scans through the linked list of mallocs and makes sure no data has been overwritten
 
+static void Zone_ValidateBlock(zoneHeader_t *pMemory)
+{
+	#ifdef DETAILED_ZONE_DEBUG_CODE
+	// this won't happen here, but wtf?
+	int& iAllocCount = mapAllocatedZones[pMemory];
+	if (iAllocCount <= 0)
+	{
+		Com_Error(ERR_FATAL, "Z_Validate(): Bad block allocation count!");
+		return;
+	}
+	#endif
+
+	if(pMemory->iMagic != ZONE_MAGIC)
+	{
+		Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone header!");
+		return;
+	}
+
+	if (ZoneTailFromHeader(pMemory)->iMagic != ZONE_MAGIC)
+	{
+		Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone tail!");
+		return;
+	}
+}
+
 void Z_Validate(void)
 {
 	if(!com_validateZone || !com_validateZone->integer)
@@ -105,32 +180,27 @@ void Z_Validate(void)
 		return;
 	}
 
-	zoneHeader_t *pMemory = TheZone.Header.pNext;
-	while (pMemory)
+	for (int i=0; i<TAG_COUNT; i++)
 	{
-		#ifdef DETAILED_ZONE_DEBUG_CODE
-		// this won't happen here, but wtf?
-		int& iAllocCount = mapAllocatedZones[pMemory];
-		if (iAllocCount <= 0)
-		{
-			Com_Error(ERR_FATAL, "Z_Validate(): Bad block allocation count!");
-			return;
-		}
-		#endif
-
-		if(pMemory->iMagic != ZONE_MAGIC)
+		zoneHeader_t *pMemory = TheZone.Headers[i].pNext;
+		while (pMemory)
 		{
-			Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone header!");
-			return;
+			Zone_ValidateBlock(pMemory);
+			pMemory = pMemory->pNext;
 		}
 
-		if (ZoneTailFromHeader(pMemory)->iMagic != ZONE_MAGIC)
+		// arena blocks follow each other, freed ones still hold their size
+		for (zoneArenaChunk_t *pChunk = TheZone.pArenas[i]; pChunk; pChunk = pChunk->pNext)
 		{
-			Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone tail!");
-			return;
+			for (int iOffset = 0; iOffset < pChunk->iUsed; iOffset += Zone_ArenaBlockSize(pMemory->iSize))
+			{
+				pMemory = Zone_ArenaBlock(pChunk, iOffset);
+				if (pMemory->iMagic != ZONE_FREED_MAGIC)
+				{
+					Zone_ValidateBlock(pMemory);
+				}
+			}
 		}
-
-		pMemory = pMemory->pNext;
 	}
 }
 
@@ -171,20 +241,13 @@ StaticMem_t gNumberString[] = {
 };
 
 qboolean gbMemFreeupOccured = qfalse;
-void *Z_Malloc(int iSize, memtag_t eTag, qboolean bZeroit /* = qfalse */, int iUnusedAlign /* = 4 */)
+
+// Gets memory from the system, dumping caches if that fails
+//
+static zoneHeader_t *Zone_SystemMalloc(int iRealSize, qboolean bZeroit, int iSize, memtag_t eTag)
 {
 	gbMemFreeupOccured = qfalse;
 
-	if (iSize == 0)
-	{
-		zoneHeader_t *pMemory = (zoneHeader_t *) &gZeroMalloc;
-		return &pMemory[1];
-	}
-
-	// Add in tracking info
-	//
-	int iRealSize = (iSize + sizeof(zoneHeader_t) + sizeof(zoneTail_t));
-
 	// Allocate a chunk...
 	//
 	zoneHeader_t *pMemory = NULL;
@@ -282,17 +345,92 @@ void *Z_Malloc(int iSize, memtag_t eTag, qboolean bZeroit /* = qfalse */, int iU
 		}
 	}
 
-	// Link in
+	return pMemory;
+}
+
+// Carves a block out of the newest arena chunk of the tag
+//
+static zoneHeader_t *Zone_ArenaMalloc(int iSize, memtag_t eTag, qboolean bZeroit)
+{
+	int iBlockSize = Zone_ArenaBlockSize(iSize);
+	zoneArenaChunk_t *pChunk = TheZone.pArenas[eTag];
+
+	if (!pChunk || pChunk->iUsed + iBlockSize > ZONE_ARENA_CHUNK_SPACE)
+	{
+		if (TheZone.pSpareChunks)
+		{
+			pChunk = TheZone.pSpareChunks;
+			TheZone.pSpareChunks = pChunk->pNext;
+			TheZone.iSpareChunks--;
+		}
+		else
+		{
+			pChunk = (zoneArenaChunk_t *) Zone_SystemMalloc(ZONE_ARENA_CHUNK_SIZE, qfalse, ZONE_ARENA_CHUNK_SIZE, eTag);
+		}
+		pChunk->eTag	= eTag;
+		pChunk->iUsed	= 0;
+		pChunk->iLive	= 0;
+		pChunk->pPrev	= NULL;
+		pChunk->pNext	= TheZone.pArenas[eTag];
+		if (pChunk->pNext)
+		{
+			pChunk->pNext->pPrev = pChunk;
+		}
+		TheZone.pArenas[eTag] = pChunk;
+		TheZone.iArenaChunks++;
+	}
+
+	zoneHeader_t *pMemory = Zone_ArenaBlock(pChunk, pChunk->iUsed);
+	pChunk->iUsed += iBlockSize;
+	pChunk->iLive++;
+
+	pMemory->pPrev	= NULL;
+	pMemory->pNext	= (zoneHeader_t *) pChunk;
+
+	if (bZeroit)
+	{
+		memset(&pMemory[1], 0, iSize);
+	}
+
+	return pMemory;
+}
+
+void *Z_Malloc(int iSize, memtag_t eTag, qboolean bZeroit /* = qfalse */, int iUnusedAlign /* = 4 */)
+{
+	gbMemFreeupOccured = qfalse;
+
+	if (iSize == 0)
+	{
+		zoneHeader_t *pMemory = (zoneHeader_t *) &gZeroMalloc;
+		return &pMemory[1];
+	}
+
+	// Add in tracking info
+	//
+	int iRealSize = (iSize + sizeof(zoneHeader_t) + sizeof(zoneTail_t));
+
+	zoneHeader_t *pMemory;
+	if (Zone_IsArenaTag(eTag) && iSize <= ZONE_ARENA_MAX_BLOCK)
+	{
+		pMemory = Zone_ArenaMalloc(iSize, eTag, bZeroit);
+	}
+	else
+	{
+		pMemory = Zone_SystemMalloc(iRealSize, bZeroit, iSize, eTag);
+
+		// Link in
+		pMemory->pNext  = TheZone.Headers[eTag].pNext;
+		TheZone.Headers[eTag].pNext = pMemory;
+		if (pMemory->pNext)
+		{
+			pMemory->pNext->pPrev = pMemory;
+		}
+		pMemory->pPrev = &TheZone.Headers[eTag];
+	}
+
 	pMemory->iMagic	= ZONE_MAGIC;
 	pMemory->eTag	= eTag;
 	pMemory->iSize	= iSize;
-	pMemory->pNext  = TheZone.Header.pNext;
-	TheZone.Header.pNext = pMemory;
-	if (pMemory->pNext)
-	{
-		pMemory->pNext->pPrev = pMemory;
-	}
-	pMemory->pPrev = &TheZone.Header;
 	//
 	// add tail...
 	//
@@ -349,6 +487,12 @@ void Z_MorphMallocTag( void *pvAddress, memtag_t eDesiredTag )
 		return;	// won't get here
 	}
 
+	if (Zone_IsArenaBlock(pMemory))
+	{
+		Com_Error(ERR_FATAL, "Z_MorphMallocTag(): Can't morph a TAG_%s block!", psTagStrings[pMemory->eTag]);
+		return;	// won't get here
+	}
+
 	// DEC existing tag stats...
 	//
 //	TheZone.Stats.iCurrent	- unchanged
@@ -360,6 +504,21 @@ void Z_MorphMallocTag( void *pvAddress, memtag_t eDesiredTag )
 	//
 	pMemory->eTag = eDesiredTag;
 
+	// ... and move to the list of the new tag
+	//
+	pMemory->pPrev->pNext = pMemory->pNext;
+	if (pMemory->pNext)
+	{
+		pMemory->pNext->pPrev = pMemory->pPrev;
+	}
+	pMemory->pNext = TheZone.Headers[eDesiredTag].pNext;
+	TheZone.Headers[eDesiredTag].pNext = pMemory;
+	if (pMemory->pNext)
+	{
+		pMemory->pNext->pPrev = pMemory;
+	}
+	pMemory->pPrev = &TheZone.Headers[eDesiredTag];
+
 	// INC new tag stats...
 	//
 //	TheZone.Stats.iCurrent	- unchanged
@@ -368,6 +527,54 @@ void Z_MorphMallocTag( void *pvAddress, memtag_t eDesiredTag )
 	TheZone.Stats.iCountsPerTag	[pMemory->eTag]++;
 }
 
+static void Zone_FreeArenaChunk(zoneArenaChunk_t *pChunk)
+{
+	if (pChunk->pPrev)
+	{
+		pChunk->pPrev->pNext = pChunk->pNext;
+	}
+	else
+	{
+		TheZone.pArenas[pChunk->eTag] = pChunk->pNext;
+	}
+	if (pChunk->pNext)
+	{
+		pChunk->pNext->pPrev = pChunk->pPrev;
+	}
+
+	TheZone.iArenaChunks--;
+
+	if (TheZone.iSpareChunks < ZONE_ARENA_SPARE_CHUNKS)
+	{
+		pChunk->pNext = TheZone.pSpareChunks;
+		TheZone.pSpareChunks = pChunk;
+		TheZone.iSpareChunks++;
+	}
+	else
+	{
+		free (pChunk);
+	}
+}
+
+static void Zone_FreeArenaBlock(zoneHeader_t *pMemory)
+{
+	zoneArenaChunk_t *pChunk = (zoneArenaChunk_t *) pMemory->pNext;
+
+	pMemory->iMagic = ZONE_FREED_MAGIC;
+
+	if (--pChunk->iLive == 0)
+	{
+		if (pChunk == TheZone.pArenas[pChunk->eTag])
+		{
+			pChunk->iUsed = 0;	// newest one, keep it for the next blocks
+		}
+		else
+		{
+			Zone_FreeArenaChunk(pChunk);
+		}
+	}
+}
+
 static void Zone_FreeBlock(zoneHeader_t *pMemory)
 {
 	if (pMemory->eTag != TAG_STATIC)	// belt and braces, should never hit this though
@@ -379,19 +586,26 @@ static void Zone_FreeBlock(zoneHeader_t *pMemory)
 		TheZone.Stats.iSizesPerTag	[pMemory->eTag] -= pMemory->iSize;
 		TheZone.Stats.iCountsPerTag	[pMemory->eTag]--;
 
-		// Sanity checks...
-		//
-		assert(pMemory->pPrev->pNext == pMemory);
-		assert(!pMemory->pNext || (pMemory->pNext->pPrev == pMemory));
-
-		// Unlink and free...
-		//
-		pMemory->pPrev->pNext = pMemory->pNext;
-		if(pMemory->pNext)
+		if (Zone_IsArenaBlock(pMemory))
 		{
-			pMemory->pNext->pPrev = pMemory->pPrev;
+			Zone_FreeArenaBlock(pMemory);
+		}
+		else
+		{
+			// Sanity checks...
+			//
+			assert(pMemory->pPrev->pNext == pMemory);
+			assert(!pMemory->pNext || (pMemory->pNext->pPrev == pMemory));
+
+			// Unlink and free...
+			//
+			pMemory->pPrev->pNext = pMemory->pNext;
+			if(pMemory->pNext)
+			{
+				pMemory->pNext->pPrev = pMemory->pPrev;
+			}
+			free (pMemory);
 		}
-		free (pMemory);
 
 
 		#ifdef DETAILED_ZONE_DEBUG_CODE
@@ -485,15 +699,51 @@ void Z_TagFree(memtag_t eTag)
 //	int iZoneBlocks = TheZone.Stats.iCount;
 //#endif
 
-	zoneHeader_t *pMemory = TheZone.Header.pNext;
-	while (pMemory)
+	for (int i = 0; i < TAG_COUNT; i++)
 	{
-		zoneHeader_t *pNext = pMemory->pNext;
-		if ( (eTag == TAG_ALL) || (pMemory->eTag == eTag))
+		if (eTag != TAG_ALL && eTag != (memtag_t)i)
 		{
+			continue;
+		}
+
+		zoneHeader_t *pMemory = TheZone.Headers[i].pNext;
+		while (pMemory)
+		{
+			zoneHeader_t *pNext = pMemory->pNext;
 			Zone_FreeBlock(pMemory);
+			pMemory = pNext;
+		}
+
+		if (!TheZone.pArenas[i])
+		{
+			continue;
+		}
+
+		#ifdef DETAILED_ZONE_DEBUG_CODE
+		for (zoneArenaChunk_t *pChunk = TheZone.pArenas[i]; pChunk; pChunk = pChunk->pNext)
+		{
+			for (int iOffset = 0; iOffset < pChunk->iUsed; iOffset += Zone_ArenaBlockSize(pMemory->iSize))
+			{
+				pMemory = Zone_ArenaBlock(pChunk, iOffset);
+				if (pMemory->iMagic != ZONE_FREED_MAGIC)
+				{
+					mapAllocatedZones[pMemory]--;
+				}
+			}
+		}
+		#endif
+
+		// whatever is left of the tag lives in the arena, so drop it all at once
+		//
+		TheZone.Stats.iCount	-= TheZone.Stats.iCountsPerTag[i];
+		TheZone.Stats.iCurrent	-= TheZone.Stats.iSizesPerTag[i];
+		TheZone.Stats.iCountsPerTag[i]	= 0;
+		TheZone.Stats.iSizesPerTag[i]	= 0;
+
+		while (TheZone.pArenas[i])
+		{
+			Zone_FreeArenaChunk(TheZone.pArenas[i]);
 		}
-		pMemory = pNext;
 	}
 
 // these stupid pragmas don't work here???!?!?!
@@ -548,6 +798,17 @@ static void Z_Stats_f(void)
 									TheZone.Stats.iPeak,
 									         (float)TheZone.Stats.iPeak / 1024.0f / 1024.0f
 				);
+
+	if (TheZone.iArenaChunks || TheZone.iSpareChunks)
+	{
+		Com_Printf("Hunk arenas hold %d chunks (%.2fMB), %d spare\n",
+									TheZone.iArenaChunks,
+									         (float)TheZone.iArenaChunks * ZONE_ARENA_CHUNK_SIZE / 1024.0f / 1024.0f,
+																TheZone.iSpareChunks
+					);
+	}
+
+	ICARUS_PoolStats();
 }
 
 // Gives a detailed breakdown of the memory blocks in the zone
@@ -599,6 +860,14 @@ void Com_ShutdownZoneMemory(void)
 		assert(!TheZone.Stats.iCount);
 		assert(!TheZone.Stats.iCurrent);
 	}
+
+	while (TheZone.pSpareChunks)
+	{
+		zoneArenaChunk_t *pNext = TheZone.pSpareChunks->pNext;
+		free (TheZone.pSpareChunks);
+		TheZone.pSpareChunks = pNext;
+	}
+	TheZone.iSpareChunks = 0;
 }
 
 // Initialises the zone memory system
@@ -606,7 +875,10 @@ void Com_ShutdownZoneMemory(void)
 void Com_InitZoneMemory( void )
 {
 	memset(&TheZone, 0, sizeof(TheZone));
-	TheZone.Header.iMagic = ZONE_MAGIC;
+	for (int i=0; i<TAG_COUNT; i++)
+	{
+		TheZone.Headers[i].iMagic = ZONE_MAGIC;
+	}
 }
 
 void Com_InitZoneMemoryVars( void ) {
@@ -673,16 +945,28 @@ void Com_TouchMemory( void ) {
 
 	sum = 0;
 
-	zoneHeader_t *pMemory = TheZone.Header.pNext;
-	while (pMemory)
+	for (int iTag=0; iTag<TAG_COUNT; iTag++)
 	{
-		byte *pMem = (byte *) &pMemory[1];
-		j = pMemory->iSize >> 2;
-		for (i=0; i<j; i+=64){
-			sum += ((int*)pMem)[i];
+		zoneHeader_t *pMemory = TheZone.Headers[iTag].pNext;
+		while (pMemory)
+		{
+			byte *pMem = (byte *) &pMemory[1];
+			j = pMemory->iSize >> 2;
+			for (i=0; i<j; i+=64){
+				sum += ((int*)pMem)[i];
+			}
+
+			pMemory = pMemory->pNext;
 		}
 
-		pMemory = pMemory->pNext;
+		for (zoneArenaChunk_t *pChunk = TheZone.pArenas[iTag]; pChunk; pChunk = pChunk->pNext)
+		{
+			int *pMem = (int *) Zone_ArenaBlock(pChunk, 0);
+			j = pChunk->iUsed >> 2;
+			for (i=0; i<j; i+=64){
+				sum += pMem[i];
+			}
+		}
 	}
 
 //	end = Sys_Milliseconds();
@@ -244,6 +244,7 @@ typedef struct refexport_s {
 
 	struct {
 		float				(*Font_StrLenPixels)					( const char *text, const int iFontIndex, const float scale );
+		void				(*G2API_EvaluateSkeletons)				( CGhoul2Info_v **ghoul2List, const vec3_t *scales, int count );
 	} ext;
 
 } refexport_t;
@@ -187,6 +187,12 @@ int	G2API_GetTime(int argTime) // this may or may not return arg depending on gh
 }
 //rww - RAGDOLL_END
 
+// transforms the bones of all these instances for the current ghoul2 time
+void G2API_EvaluateSkeletons(CGhoul2Info_v **ghoul2List, const vec3_t *scales, int count)
+{
+	G2_EvaluateSkeletons(ghoul2List, scales, count, G2API_GetTime(0));
+}
+
 //rww - Stuff to allow association of ghoul2 instances to entity numbers.
 //This way, on listen servers when both the client and server are doing
 //ghoul2 operations, we can copy relevant data off the client instance
@@ -2028,7 +2034,7 @@ void G2API_CollisionDetectCache(CollisionRecord_t *collRecMap, CGhoul2Info_v &gh
 				{ //reworked so we only alloc once!
 					//if we have a pointer, but not a ghoul2_zonetransalloc flag, then that means
 					//it is a miniheap pointer. Just stomp over it.
-					int iSize = g2.currentModel->mdxm->numSurfaces * 4;
+					int iSize = g2.currentModel->mdxm->numSurfaces * sizeof(size_t);
 					g2.mTransformedVertsArray = (size_t *)Z_Malloc(iSize, TAG_GHOUL2, qtrue);
 				}
 
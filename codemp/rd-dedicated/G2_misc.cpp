@@ -26,6 +26,18 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "server/server.h"
 #include "ghoul2/g2_local.h"
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
+// the SSE2 skinning kernel gives the same results as the scalar one to the bit
+#if defined(idx64) && ( defined(__SSE2__) || defined(_M_X64) )
+#define G2_SIMD_SKINNING
+#include <emmintrin.h>
+#endif
+
+extern cvar_t *r_Ghoul2TraceBVH;
+
 #ifdef _G2_GORE
 #include "ghoul2/G2_gore.h"
 
@@ -386,43 +398,109 @@ int G2_DecideTraceLod(CGhoul2Info &ghoul2, int useLod)
 	return returnLod;
 }
 
-void R_TransformEachSurface( const mdxmSurface_t *surface, vec3_t scale, IHeapAllocator *G2VertSpace, size_t *TransformedVertsArray,CBoneCache *boneCache)
+/*
+Transformed verts of a surface are stored as five planes of G2_VERT_STRIDE
+floats each (x, y, z, s, t), so the skinning kernel can write four vertices
+with one store per component. Use G2_GetTransformedVert to gather a vertex.
+The bvh of the surface for the traces follows the planes.
+*/
+#define G2_VERT_STRIDE(numVerts)	(((numVerts)+3)&~3)
+
+static inline void G2_GetTransformedVert( const float *verts, int stride, int index, vec3_t out )
 {
-	int				 j, k;
-	mdxmVertex_t 	*v;
-	float			*TransformedVerts;
+	out[0] = verts[index];
+	out[1] = verts[stride + index];
+	out[2] = verts[stride * 2 + index];
+}
 
-	//
-	// deform the vertexes by the lerped bones
-	//
-	int *piBoneReferences = (int*) ((byte*)surface + surface->ofsBoneReferences);
+// the reference version, also used where SSE2 is not available
+static void G2_SkinVertsScalar( const mdxmSurface_t *surface, const mdxaBone_t * const *bones, const vec3_t scale, float *TransformedVerts )
+{
+	const int						numVerts = surface->numVerts;
+	const int						stride = G2_VERT_STRIDE(numVerts);
+	const mdxmVertex_t				*v = (mdxmVertex_t *) ((byte *)surface + surface->ofsVerts);
+	const mdxmVertexTexCoord_t		*pTexCoords = (mdxmVertexTexCoord_t *) &v[numVerts];
+	int								j, k;
 
-	// alloc some space for the transformed verts to get put in
-	TransformedVerts = (float *)G2VertSpace->MiniHeapAlloc(surface->numVerts * 5 * 4);
-	TransformedVertsArray[surface->thisSurfaceIndex] = (size_t)TransformedVerts;
-	if (!TransformedVerts)
+	for ( j = 0; j < numVerts; j++, v++ )
 	{
-		Com_Error(ERR_DROP, "Ran out of transform space for Ghoul2 Models. Adjust MiniHeapSize in SV_SpawnServer.\n");
+		vec3_t			tempVert;
+
+		VectorClear( tempVert );
+
+		const int iNumWeights = G2_GetVertWeights( v );
+
+		float fTotalWeight = 0.0f;
+		for ( k = 0 ; k < iNumWeights ; k++ )
+		{
+			int		iBoneIndex	= G2_GetVertBoneIndex( v, k );
+			float	fBoneWeight	= G2_GetVertBoneWeight( v, k, fTotalWeight, iNumWeights );
+
+			const mdxaBone_t &bone = *bones[iBoneIndex];
+
+			tempVert[0] += fBoneWeight * ( DotProduct( bone.matrix[0], v->vertCoords ) + bone.matrix[0][3] );
+			tempVert[1] += fBoneWeight * ( DotProduct( bone.matrix[1], v->vertCoords ) + bone.matrix[1][3] );
+			tempVert[2] += fBoneWeight * ( DotProduct( bone.matrix[2], v->vertCoords ) + bone.matrix[2][3] );
+		}
+
+		// copy tranformed verts into temp space
+		TransformedVerts[j] = tempVert[0] * scale[0];
+		TransformedVerts[stride + j] = tempVert[1] * scale[1];
+		TransformedVerts[stride * 2 + j] = tempVert[2] * scale[2];
+		// we will need the S & T coors too for hitlocation and hitmaterial stuff
+		TransformedVerts[stride * 3 + j] = pTexCoords[j].texCoords[0];
+		TransformedVerts[stride * 4 + j] = pTexCoords[j].texCoords[1];
 	}
+}
 
-	// whip through and actually transform each vertex
-	const int numVerts = surface->numVerts;
-	v = (mdxmVertex_t *) ((byte *)surface + surface->ofsVerts);
-	mdxmVertexTexCoord_t *pTexCoords = (mdxmVertexTexCoord_t *) &v[numVerts];
+#ifdef G2_SIMD_SKINNING
+/*
+The bones of the surface are transposed once, so a register holds one
+matrix column for all three rows and a vert is skinned in a single register
+with the same order of operations as the scalar version; the results are
+bit identical. Four skinned verts are transposed back into the x, y and z
+planes at a time. TransformedVerts must be 16 byte aligned.
+*/
+static void G2_SkinVertsSIMD( const mdxmSurface_t *surface, const mdxaBone_t * const *bones, const vec3_t scale, float *TransformedVerts )
+{
+	__m128							boneColumns[iMAX_G2_BONEREFS_PER_SURFACE][4];
+	const int						numBones = Q_min( surface->numBoneReferences, iMAX_G2_BONEREFS_PER_SURFACE );
+	const int						numVerts = surface->numVerts;
+	const int						stride = G2_VERT_STRIDE(numVerts);
+	const mdxmVertex_t				*v = (mdxmVertex_t *) ((byte *)surface + surface->ofsVerts);
+	const mdxmVertexTexCoord_t		*pTexCoords = (mdxmVertexTexCoord_t *) &v[numVerts];
+	const __m128					scaleX = _mm_set1_ps( scale[0] );
+	const __m128					scaleY = _mm_set1_ps( scale[1] );
+	const __m128					scaleZ = _mm_set1_ps( scale[2] );
+	int								i, j, k, lane;
 
-	// optimisation issue
-	if ((scale[0] != 1.0) || (scale[1] != 1.0) || (scale[2] != 1.0))
+	for ( i = 0; i < numBones; i++ )
 	{
-		for ( j = 0; j < numVerts; j++ )
-		{
-			vec3_t			tempVert, tempNormal;
-//			mdxmWeight_t	*w;
+		__m128 c0 = _mm_loadu_ps( bones[i]->matrix[0] );
+		__m128 c1 = _mm_loadu_ps( bones[i]->matrix[1] );
+		__m128 c2 = _mm_loadu_ps( bones[i]->matrix[2] );
+		__m128 c3 = _mm_setzero_ps();
+
+		_MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+
+		boneColumns[i][0] = c0;
+		boneColumns[i][1] = c1;
+		boneColumns[i][2] = c2;
+		boneColumns[i][3] = c3;
+	}
 
-			VectorClear( tempVert );
-			VectorClear( tempNormal );
-//			w = v->weights;
+	for ( j = 0; j < numVerts; j += 4 )
+	{
+		__m128 skinned[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		const int numLanes = Q_min( 4, numVerts - j );
 
+		for ( lane = 0; lane < numLanes; lane++, v++ )
+		{
+			const __m128 vx = _mm_set1_ps( v->vertCoords[0] );
+			const __m128 vy = _mm_set1_ps( v->vertCoords[1] );
+			const __m128 vz = _mm_set1_ps( v->vertCoords[2] );
 			const int iNumWeights = G2_GetVertWeights( v );
+			__m128 tempVert = _mm_setzero_ps();
 
 			float fTotalWeight = 0.0f;
 			for ( k = 0 ; k < iNumWeights ; k++ )
@@ -430,71 +508,507 @@ void R_TransformEachSurface( const mdxmSurface_t *surface, vec3_t scale, IHeapAl
 				int		iBoneIndex	= G2_GetVertBoneIndex( v, k );
 				float	fBoneWeight	= G2_GetVertBoneWeight( v, k, fTotalWeight, iNumWeights );
 
-				const mdxaBone_t &bone=EvalBoneCache(piBoneReferences[iBoneIndex],boneCache);
+				const __m128 *column = boneColumns[iBoneIndex];
+				__m128 t = _mm_add_ps( _mm_mul_ps( column[0], vx ), _mm_mul_ps( column[1], vy ) );
+				t = _mm_add_ps( t, _mm_mul_ps( column[2], vz ) );
+				t = _mm_add_ps( t, column[3] );
+				tempVert = _mm_add_ps( tempVert, _mm_mul_ps( _mm_set1_ps( fBoneWeight ), t ) );
+			}
+			skinned[lane] = tempVert;
+		}
+
+		_MM_TRANSPOSE4_PS( skinned[0], skinned[1], skinned[2], skinned[3] );
+
+		_mm_store_ps( &TransformedVerts[j], _mm_mul_ps( skinned[0], scaleX ) );
+		_mm_store_ps( &TransformedVerts[stride + j], _mm_mul_ps( skinned[1], scaleY ) );
+		_mm_store_ps( &TransformedVerts[stride * 2 + j], _mm_mul_ps( skinned[2], scaleZ ) );
+	}
+
+	// we will need the S & T coors too for hitlocation and hitmaterial stuff
+	for ( j = 0; j < numVerts; j++ )
+	{
+		TransformedVerts[stride * 3 + j] = pTexCoords[j].texCoords[0];
+		TransformedVerts[stride * 4 + j] = pTexCoords[j].texCoords[1];
+	}
+}
+#endif
+
+/*
+Surfaces with enough triangles get a bounding volume hierarchy for the
+traces. The tree is built once per surface from the bind pose and kept
+until the models are freed. Its node bounds follow the vertex planes of
+every transformed surface and are fitted to the skinned verts by the first
+trace that needs them. The traversal only collects candidate triangles;
+they are tested in their original order by the same code as before, so
+the collision records come out the same.
+*/
+#define G2_BVH_MIN_TRIS		32		// smaller surfaces are traced triangle by triangle
+#define G2_BVH_LEAF_TRIS	4
+#define G2_BVH_EPSILON		0.01f	// the bounds are grown by this much so rounding never culls a hit
+
+typedef struct g2BVHNode_s {
+	int		first;		// first entry in triangles for a leaf, the left child otherwise (the right one follows it)
+	int		numTris;	// 0 for an inner node
+} g2BVHNode_t;
+
+typedef struct g2SurfaceBVH_s {
+	std::vector<g2BVHNode_t>	nodes;		// children always come after their parent
+	std::vector<int>			triangles;	// ordered by leaf
+} g2SurfaceBVH_t;
+
+// follows the planes of a transformed surface, with the node bounds after it
+typedef struct g2TransformedBVH_s {
+	const g2SurfaceBVH_t	*bvh;		// NULL if the surface is traced triangle by triangle
+	int						fitted;
+} g2TransformedBVH_t;
+
+static std::map<const mdxmSurface_t *, g2SurfaceBVH_t *> g2SurfaceBVHs;
+static std::vector<int> g2TraceCandidates;
+
+// the bvhs point into the model data, so they go when any model is freed
+void G2_FreeSurfaceBVHs( void )
+{
+	for ( std::map<const mdxmSurface_t *, g2SurfaceBVH_t *>::iterator it = g2SurfaceBVHs.begin(); it != g2SurfaceBVHs.end(); ++it )
+	{
+		delete it->second;
+	}
+	g2SurfaceBVHs.clear();
+}
+
+struct G2_BVHCentroidLess
+{
+	const vec3_t	*centroids;
+	int				axis;
+
+	bool operator()( int a, int b ) const
+	{
+		if ( centroids[a][axis] != centroids[b][axis] )
+		{
+			return centroids[a][axis] < centroids[b][axis];
+		}
+		return a < b;
+	}
+};
+
+static void G2_BuildBVHNode( g2SurfaceBVH_t *bvh, int nodeNum, int first, int numTris, const vec3_t *centroids )
+{
+	vec3_t	mins, maxs;
+	int		i, axis;
+
+	if ( numTris <= G2_BVH_LEAF_TRIS )
+	{
+		bvh->nodes[nodeNum].first = first;
+		bvh->nodes[nodeNum].numTris = numTris;
+		return;
+	}
+
+	// split at the median of the longest axis of the centroids
+	ClearBounds( mins, maxs );
+	for ( i = first; i < first + numTris; i++ )
+	{
+		AddPointToBounds( centroids[bvh->triangles[i]], mins, maxs );
+	}
+	axis = 0;
+	for ( i = 1; i < 3; i++ )
+	{
+		if ( maxs[i] - mins[i] > maxs[axis] - mins[axis] )
+		{
+			axis = i;
+		}
+	}
+
+	const int half = numTris / 2;
+	G2_BVHCentroidLess less = { centroids, axis };
+	std::nth_element( bvh->triangles.begin() + first, bvh->triangles.begin() + first + half, bvh->triangles.begin() + first + numTris, less );
+
+	const int left = (int)bvh->nodes.size();
+	bvh->nodes.resize( left + 2 );
+	bvh->nodes[nodeNum].first = left;
+	bvh->nodes[nodeNum].numTris = 0;
+
+	G2_BuildBVHNode( bvh, left, first, half, centroids );
+	G2_BuildBVHNode( bvh, left + 1, first + half, numTris - half, centroids );
+}
+
+static const g2SurfaceBVH_t *G2_SurfaceBVH( const mdxmSurface_t *surface )
+{
+	if ( surface->numTriangles < G2_BVH_MIN_TRIS )
+	{
+		return NULL;
+	}
+
+	std::map<const mdxmSurface_t *, g2SurfaceBVH_t *>::const_iterator it = g2SurfaceBVHs.find( surface );
+	if ( it != g2SurfaceBVHs.end() )
+	{
+		return it->second;
+	}
+
+	const mdxmVertex_t		*v = (mdxmVertex_t *) ((byte *)surface + surface->ofsVerts);
+	const mdxmTriangle_t	*tris = (mdxmTriangle_t *) ((byte *)surface + surface->ofsTriangles);
+	std::vector<float>		centroidData( surface->numTriangles * 3 );
+	vec3_t					*centroids = (vec3_t *)&centroidData[0];
+	g2SurfaceBVH_t			*bvh = new g2SurfaceBVH_t;
+	int						i;
+
+	bvh->triangles.resize( surface->numTriangles );
+	for ( i = 0; i < surface->numTriangles; i++ )
+	{
+		VectorAdd( v[tris[i].indexes[0]].vertCoords, v[tris[i].indexes[1]].vertCoords, centroids[i] );
+		VectorAdd( v[tris[i].indexes[2]].vertCoords, centroids[i], centroids[i] );
+		bvh->triangles[i] = i;
+	}
+
+	bvh->nodes.resize( 1 );
+	G2_BuildBVHNode( bvh, 0, 0, surface->numTriangles, centroids );
+
+	g2SurfaceBVHs[surface] = bvh;
+	return bvh;
+}
+
+// space for the skinned verts of a surface, the bvh header and the node bounds, plus the alignment
+static int G2_TransformedSurfaceSize( const mdxmSurface_t *surface, const g2SurfaceBVH_t *bvh )
+{
+	return G2_VERT_STRIDE(surface->numVerts) * 5 * 4 + sizeof( g2TransformedBVH_t ) + ( bvh ? (int)bvh->nodes.size() * 6 * 4 : 0 ) + 15;
+}
+
+static inline g2TransformedBVH_t *G2_TransformedBVH( const mdxmSurface_t *surface, const float *verts )
+{
+	return (g2TransformedBVH_t *)&verts[G2_VERT_STRIDE(surface->numVerts) * 5];
+}
+
+// fits the node bounds to the skinned verts, leaves first
+static void G2_FitBVH( const mdxmSurface_t *surface, const float *verts, g2TransformedBVH_t *header )
+{
+	const g2SurfaceBVH_t	*bvh = header->bvh;
+	const mdxmTriangle_t	*tris = (mdxmTriangle_t *) ((byte *)surface + surface->ofsTriangles);
+	const int				stride = G2_VERT_STRIDE(surface->numVerts);
+	float					*bounds = (float *)( header + 1 );
+	int						i, j, k;
+
+	for ( i = (int)bvh->nodes.size() - 1; i >= 0; i-- )
+	{
+		const g2BVHNode_t	&node = bvh->nodes[i];
+		float				*b = &bounds[i * 6];
 
-				tempVert[0] += fBoneWeight * ( DotProduct( bone.matrix[0], v->vertCoords ) + bone.matrix[0][3] );
-				tempVert[1] += fBoneWeight * ( DotProduct( bone.matrix[1], v->vertCoords ) + bone.matrix[1][3] );
-				tempVert[2] += fBoneWeight * ( DotProduct( bone.matrix[2], v->vertCoords ) + bone.matrix[2][3] );
+		if ( node.numTris )
+		{
+			ClearBounds( b, b + 3 );
+			for ( j = node.first; j < node.first + node.numTris; j++ )
+			{
+				for ( k = 0; k < 3; k++ )
+				{
+					vec3_t point;
+					G2_GetTransformedVert( verts, stride, tris[bvh->triangles[j]].indexes[k], point );
+					AddPointToBounds( point, b, b + 3 );
+				}
+			}
+		}
+		else
+		{
+			const float *l = &bounds[node.first * 6];
+			const float *r = l + 6;
 
-				tempNormal[0] += fBoneWeight * DotProduct( bone.matrix[0], v->normal );
-				tempNormal[1] += fBoneWeight * DotProduct( bone.matrix[1], v->normal );
-				tempNormal[2] += fBoneWeight * DotProduct( bone.matrix[2], v->normal );
+			for ( k = 0; k < 3; k++ )
+			{
+				b[k] = Q_min( l[k], r[k] );
+				b[k + 3] = Q_max( l[k + 3], r[k + 3] );
 			}
-			int pos = j * 5;
+		}
+	}
+
+	header->fitted = 1;
+}
+
+// the part of a trace that decides whether a box can be skipped
+struct G2_BVHSegment
+{
+	vec3_t	start;
+	vec3_t	dir;
+
+	bool Misses( const float *bounds ) const
+	{
+		float tmin = 0.0f, tmax = 1.0f;
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			const float lo = bounds[k] - G2_BVH_EPSILON;
+			const float hi = bounds[k + 3] + G2_BVH_EPSILON;
 
-			// copy tranformed verts into temp space
-			TransformedVerts[pos++] = tempVert[0] * scale[0];
-			TransformedVerts[pos++] = tempVert[1] * scale[1];
-			TransformedVerts[pos++] = tempVert[2] * scale[2];
-			// we will need the S & T coors too for hitlocation and hitmaterial stuff
-			TransformedVerts[pos++] = pTexCoords[j].texCoords[0];
-			TransformedVerts[pos] = pTexCoords[j].texCoords[1];
+			if ( fabs( dir[k] ) < 1e-8f )
+			{
+				if ( start[k] < lo || start[k] > hi )
+				{
+					return true;
+				}
+				continue;
+			}
 
-			v++;// = (mdxmVertex_t *)&v->weights[/*v->numWeights*/surface->maxVertBoneWeights];
+			float t0 = ( lo - start[k] ) / dir[k];
+			float t1 = ( hi - start[k] ) / dir[k];
+			if ( t0 > t1 )
+			{
+				const float temp = t0;
+				t0 = t1;
+				t1 = temp;
+			}
+			tmin = Q_max( tmin, t0 );
+			tmax = Q_min( tmax, t1 );
+			if ( tmin > tmax )
+			{
+				return true;
+			}
 		}
+		return false;
 	}
-	else
+};
+
+// G2_RadiusTracePolys rejects a triangle when all its verts are outside the
+// same side of 0 < s, t, u < 1, so a box entirely outside one side can go
+struct G2_BVHRadius
+{
+	vec3_t	start;
+	vec3_t	axes[3];		// s, t and u
+	float	offsets[3];
+
+	bool Misses( const float *bounds ) const
 	{
-		int pos = 0;
-	  	for ( j = 0; j < numVerts; j++ )
+		static const float epsilon = 0.001f;
+
+		for ( int i = 0; i < 3; i++ )
 		{
-			vec3_t			tempVert, tempNormal;
-//			const mdxmWeight_t	*w;
+			float lo = offsets[i], hi = offsets[i];
 
-			VectorClear( tempVert );
-			VectorClear( tempNormal );
-//			w = v->weights;
+			for ( int k = 0; k < 3; k++ )
+			{
+				const float a = ( bounds[k] - G2_BVH_EPSILON - start[k] ) * axes[i][k];
+				const float b = ( bounds[k + 3] + G2_BVH_EPSILON - start[k] ) * axes[i][k];
+				lo += Q_min( a, b );
+				hi += Q_max( a, b );
+			}
+			if ( hi < -epsilon || lo > 1.0f + epsilon )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
 
-			const int iNumWeights = G2_GetVertWeights( v );
+/*
+==================
+G2_BVHCandidates
 
-			float fTotalWeight = 0.0f;
-			for ( k = 0 ; k < iNumWeights ; k++ )
+Fills g2TraceCandidates with the triangles in the boxes the trace touches,
+in ascending order. Returns -1 if the surface has no bvh.
+==================
+*/
+template <typename T>
+static int G2_BVHCandidates( const mdxmSurface_t *surface, const float *verts, const T &trace )
+{
+	g2TransformedBVH_t	*header = G2_TransformedBVH( surface, verts );
+	int					stack[64];
+	int					depth = 0;
+
+	if ( !header->bvh || !r_Ghoul2TraceBVH->integer )
+	{
+		return -1;
+	}
+	if ( !header->fitted )
+	{
+		G2_FitBVH( surface, verts, header );
+	}
+
+	const g2SurfaceBVH_t	*bvh = header->bvh;
+	const float				*bounds = (float *)( header + 1 );
+
+	g2TraceCandidates.clear();
+	stack[depth++] = 0;
+	while ( depth )
+	{
+		const int			nodeNum = stack[--depth];
+		const g2BVHNode_t	&node = bvh->nodes[nodeNum];
+
+		if ( trace.Misses( &bounds[nodeNum * 6] ) )
+		{
+			continue;
+		}
+
+		if ( node.numTris )
+		{
+			g2TraceCandidates.insert( g2TraceCandidates.end(), bvh->triangles.begin() + node.first, bvh->triangles.begin() + node.first + node.numTris );
+		}
+		else
+		{
+			assert( depth + 2 <= (int)ARRAY_LEN( stack ) );
+			stack[depth++] = node.first + 1;
+			stack[depth++] = node.first;
+		}
+	}
+
+	std::sort( g2TraceCandidates.begin(), g2TraceCandidates.end() );
+	return (int)g2TraceCandidates.size();
+}
+
+void R_TransformEachSurface( const mdxmSurface_t *surface, vec3_t scale, IHeapAllocator *G2VertSpace, size_t *TransformedVertsArray,CBoneCache *boneCache)
+{
+	const mdxaBone_t	*bones[iMAX_G2_BONEREFS_PER_SURFACE];
+	float				*TransformedVerts;
+	int					i;
+
+	//
+	// deform the vertexes by the lerped bones
+	//
+	const int *piBoneReferences = (int*) ((byte*)surface + surface->ofsBoneReferences);
+	const int numBoneReferences = Q_min( surface->numBoneReferences, iMAX_G2_BONEREFS_PER_SURFACE );
+
+	for ( i = 0; i < numBoneReferences; i++ )
+	{
+		bones[i] = &EvalBoneCache( piBoneReferences[i], boneCache );
+	}
+
+	// alloc some space for the transformed verts to get put in, aligned for the kernel
+	const g2SurfaceBVH_t *bvh = G2_SurfaceBVH( surface );
+	TransformedVerts = (float *)G2VertSpace->MiniHeapAlloc( G2_TransformedSurfaceSize( surface, bvh ) );
+	if (!TransformedVerts)
+	{
+		Com_Error(ERR_DROP, "Ran out of transform space for Ghoul2 Models. Adjust MiniHeapSize in SV_SpawnServer.\n");
+	}
+	TransformedVerts = (float *)( ( (size_t)TransformedVerts + 15 ) & ~(size_t)15 );
+	TransformedVertsArray[surface->thisSurfaceIndex] = (size_t)TransformedVerts;
+	G2_TransformedBVH( surface, TransformedVerts )->bvh = bvh;
+	G2_TransformedBVH( surface, TransformedVerts )->fitted = 0;
+
+	// whip through and actually transform each vertex
+#ifdef G2_SIMD_SKINNING
+	G2_SkinVertsSIMD( surface, bones, scale, TransformedVerts );
+#else
+	G2_SkinVertsScalar( surface, bones, scale, TransformedVerts );
+#endif
+}
+
+/*
+=================
+G2_SkinBench_f
+
+g2_skinbench [iterations]
+
+Skins every surface of the loaded ghoul2 models with random bones through
+the scalar and the SSE2 kernel, checks that the results match and times
+both.
+=================
+*/
+void G2_SkinBench_f( void )
+{
+#ifdef G2_SIMD_SKINNING
+	const mdxaBone_t	*bones[iMAX_G2_BONEREFS_PER_SURFACE];
+	static mdxaBone_t	randomBones[iMAX_G2_BONEREFS_PER_SURFACE];
+	std::vector<const mdxmSurface_t *>	surfaces;
+	std::vector<float>	scalarVerts, simdVerts;
+	const vec3_t		scale = { 1.0f, 1.0f, 1.0f };
+	int					iterations, numVerts, errors, pass, start, msec[2];
+	int					i, j, k;
+	size_t				maxFloats = 4;
+
+	iterations = ri->Cmd_Argc() > 1 ? atoi( ri->Cmd_Argv( 1 ) ) : 100;
+	if ( iterations < 1 )
+	{
+		iterations = 1;
+	}
+
+	for ( i = 0; i < iMAX_G2_BONEREFS_PER_SURFACE; i++ )
+	{
+		for ( j = 0; j < 3; j++ )
+		{
+			for ( k = 0; k < 4; k++ )
 			{
-				int		iBoneIndex	= G2_GetVertBoneIndex( v, k );
-				float	fBoneWeight	= G2_GetVertBoneWeight( v, k, fTotalWeight, iNumWeights );
+				randomBones[i].matrix[j][k] = ( rand() / (float)RAND_MAX ) * 2.0f - 1.0f;
+			}
+		}
+		bones[i] = &randomBones[i];
+	}
+
+	// every surface of every lod
+	numVerts = 0;
+	for ( i = 1; i < tr.numModels; i++ )
+	{
+		const model_t *mod = tr.models[i];
+
+		if ( mod->type != MOD_MDXM || !mod->mdxm )
+		{
+			continue;
+		}
 
-				const mdxaBone_t &bone=EvalBoneCache(piBoneReferences[iBoneIndex],boneCache);
+		const byte *lodData = (byte *)mod->mdxm + mod->mdxm->ofsLODs;
+		for ( j = 0; j < mod->mdxm->numLODs; j++ )
+		{
+			const mdxmLODSurfOffset_t *indexes = (mdxmLODSurfOffset_t *)( lodData + sizeof( mdxmLOD_t ) );
 
-				tempVert[0] += fBoneWeight * ( DotProduct( bone.matrix[0], v->vertCoords ) + bone.matrix[0][3] );
-				tempVert[1] += fBoneWeight * ( DotProduct( bone.matrix[1], v->vertCoords ) + bone.matrix[1][3] );
-				tempVert[2] += fBoneWeight * ( DotProduct( bone.matrix[2], v->vertCoords ) + bone.matrix[2][3] );
+			for ( k = 0; k < mod->mdxm->numSurfaces; k++ )
+			{
+				const mdxmSurface_t *surface = (mdxmSurface_t *)( (byte *)indexes + indexes->offsets[k] );
 
-				tempNormal[0] += fBoneWeight * DotProduct( bone.matrix[0], v->normal );
-				tempNormal[1] += fBoneWeight * DotProduct( bone.matrix[1], v->normal );
-				tempNormal[2] += fBoneWeight * DotProduct( bone.matrix[2], v->normal );
+				surfaces.push_back( surface );
+				numVerts += surface->numVerts;
+				maxFloats = Q_max( maxFloats, (size_t)G2_VERT_STRIDE(surface->numVerts) * 5 );
 			}
+			lodData += ((mdxmLOD_t *)lodData)->ofsEnd;
+		}
+	}
+
+	if ( surfaces.empty() )
+	{
+		Com_Printf( "No ghoul2 models are loaded.\n" );
+		return;
+	}
 
-			// copy tranformed verts into temp space
-			TransformedVerts[pos++] = tempVert[0];
-			TransformedVerts[pos++] = tempVert[1];
-			TransformedVerts[pos++] = tempVert[2];
-			// we will need the S & T coors too for hitlocation and hitmaterial stuff
-			TransformedVerts[pos++] = pTexCoords[j].texCoords[0];
-			TransformedVerts[pos++] = pTexCoords[j].texCoords[1];
+	// over allocated so the kernel output can be aligned
+	scalarVerts.resize( maxFloats + 4 );
+	simdVerts.resize( maxFloats + 4 );
+	float *scalarOut = (float *)( ( (size_t)scalarVerts.data() + 15 ) & ~(size_t)15 );
+	float *simdOut = (float *)( ( (size_t)simdVerts.data() + 15 ) & ~(size_t)15 );
 
-			v++;// = (mdxmVertex_t *)&v->weights[/*v->numWeights*/surface->maxVertBoneWeights];
+	errors = 0;
+	for ( i = 0; i < (int)surfaces.size(); i++ )
+	{
+		const int stride = G2_VERT_STRIDE(surfaces[i]->numVerts);
+
+		G2_SkinVertsScalar( surfaces[i], bones, scale, scalarOut );
+		G2_SkinVertsSIMD( surfaces[i], bones, scale, simdOut );
+		for ( j = 0; j < 5; j++ )
+		{
+			if ( memcmp( scalarOut + stride * j, simdOut + stride * j, surfaces[i]->numVerts * sizeof( float ) ) )
+			{
+				errors++;
+				break;
+			}
 		}
 	}
+	Com_Printf( "%i surfaces, %i verts checked, %i mismatches\n", (int)surfaces.size(), numVerts, errors );
+
+	for ( pass = 0; pass < 2; pass++ )
+	{
+		start = ri->Milliseconds();
+		for ( i = 0; i < iterations; i++ )
+		{
+			for ( j = 0; j < (int)surfaces.size(); j++ )
+			{
+				if ( pass )
+				{
+					G2_SkinVertsSIMD( surfaces[j], bones, scale, simdOut );
+				}
+				else
+				{
+					G2_SkinVertsScalar( surfaces[j], bones, scale, scalarOut );
+				}
+			}
+		}
+		msec[pass] = Q_max( 1, ri->Milliseconds() - start );
+	}
+
+	Com_Printf( "Mverts/s: scalar %8.2f  sse2 %8.2f\n", numVerts * (float)iterations / ( msec[0] * 1000.0f ), numVerts * (float)iterations / ( msec[1] * 1000.0f ) );
+#else
+	Com_Printf( "This build skins with the scalar kernel only.\n" );
+#endif
 }
 
 void G2_TransformSurfaces(int surfaceNum, surfaceInfo_v &rootSList,
@@ -643,7 +1157,6 @@ void G2_TransformModel(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale,
 	}
 }
 
-
 // work out how much space a triangle takes
 static float	G2_AreaOfTri(const vec3_t A, const vec3_t B, const vec3_t C)
 {
@@ -825,15 +1338,15 @@ void G2_GorePolys( const mdxmSurface_t *surface, CTraceSurface &TS, const mdxmSu
 
 	float *verts = (float *)TS.TransformedVertsArray[surface->thisSurfaceIndex];
 	int numVerts = surface->numVerts;
+	const int stride = G2_VERT_STRIDE(numVerts);
 	int flags=15;
 	assert(numVerts<MAX_GORE_VERTS);
 	for ( j = 0; j < numVerts; j++ )
 	{
-		int pos=j*5;
 		vec3_t delta;
-		delta[0]=verts[pos+0]-TS.rayStart[0];
-		delta[1]=verts[pos+1]-TS.rayStart[1];
-		delta[2]=verts[pos+2]-TS.rayStart[2];
+		delta[0]=verts[j]-TS.rayStart[0];
+		delta[1]=verts[stride+j]-TS.rayStart[1];
+		delta[2]=verts[stride*2+j]-TS.rayStart[2];
 		float s=DotProduct(delta,saxis)+0.5f;
 		float t=DotProduct(delta,taxis)+0.5f;
 		int vflags=0;
@@ -891,10 +1404,13 @@ void G2_GorePolys( const mdxmSurface_t *surface, CTraceSurface &TS, const mdxmSu
 		if (!TS.gore->frontFaces || !TS.gore->backFaces)
 		{
 			// we need to back/front face cull
-			vec3_t e1,e2,n;
+			vec3_t p0,p1,p2,e1,e2,n;
 
-			VectorSubtract(&verts[tris[j].indexes[1]*5],&verts[tris[j].indexes[0]*5],e1);
-			VectorSubtract(&verts[tris[j].indexes[2]*5],&verts[tris[j].indexes[0]*5],e2);
+			G2_GetTransformedVert(verts,stride,tris[j].indexes[0],p0);
+			G2_GetTransformedVert(verts,stride,tris[j].indexes[1],p1);
+			G2_GetTransformedVert(verts,stride,tris[j].indexes[2],p2);
+			VectorSubtract(p1,p0,e1);
+			VectorSubtract(p2,p0,e2);
 			CrossProduct(e1,e2,n);
 			if (DotProduct(TS.rayEnd,n)>0.0f)
 			{
@@ -1067,20 +1583,30 @@ static SVertexTemp GoreVerts[MAX_GORE_VERTS];
 // now we're at poly level, check each model space transformed poly against the model world transfomed ray
 static bool G2_TracePolys(const mdxmSurface_t *surface, const mdxmSurfHierarchy_t *surfInfo, CTraceSurface &TS)
 {
-	int				j, numTris;
+	int				c, j, numTris;
+	G2_BVHSegment	segment;
 
 	// whip through and actually transform each vertex
 	const mdxmTriangle_t *tris = (mdxmTriangle_t *) ((byte *)surface + surface->ofsTriangles);
 	const float *verts = (float *)TS.TransformedVertsArray[surface->thisSurfaceIndex];
-	numTris = surface->numTriangles;
-	for ( j = 0; j < numTris; j++ )
+	const int stride = G2_VERT_STRIDE(surface->numVerts);
+
+	// only look at the triangles near the ray if the surface has a bvh
+	VectorCopy(TS.rayStart, segment.start);
+	VectorSubtract(TS.rayEnd, TS.rayStart, segment.dir);
+	const int numCandidates = G2_BVHCandidates(surface, verts, segment);
+	numTris = numCandidates < 0 ? surface->numTriangles : numCandidates;
+	for ( c = 0; c < numTris; c++ )
 	{
+		j = numCandidates < 0 ? c : g2TraceCandidates[c];
+
 		float			face;
 		vec3_t	hitPoint, normal;
 		// determine actual coords for this triangle
-		const float *point1 = &verts[(tris[j].indexes[0] * 5)];
-		const float *point2 = &verts[(tris[j].indexes[1] * 5)];
-		const float *point3 = &verts[(tris[j].indexes[2] * 5)];
+		vec3_t point1, point2, point3;
+		G2_GetTransformedVert(verts, stride, tris[j].indexes[0], point1);
+		G2_GetTransformedVert(verts, stride, tris[j].indexes[1], point2);
+		G2_GetTransformedVert(verts, stride, tris[j].indexes[2], point3);
 		// did we hit it?
 		int i;
 		if (G2_SegmentTriangleTest(TS.rayStart, TS.rayEnd, point1, point2, point3, qtrue, qtrue, hitPoint, normal, &face))
@@ -1119,9 +1645,10 @@ static bool G2_TracePolys(const mdxmSurface_t *surface, const mdxmSurfHierarchy_
 					newCol.mMaterial = newCol.mLocation = 0;
 
 					// Determine our location within the texture, and barycentric coordinates
-					G2_BuildHitPointST(point1, point1[3], point1[4],
-									   point2, point2[3], point2[4],
-									   point3, point3[3], point3[4],
+					const float *st = &verts[stride * 3];
+					G2_BuildHitPointST(point1, st[tris[j].indexes[0]], st[stride + tris[j].indexes[0]],
+									   point2, st[tris[j].indexes[1]], st[stride + tris[j].indexes[1]],
+									   point3, st[tris[j].indexes[2]], st[stride + tris[j].indexes[2]],
 									   hitPoint, &x_pos, &y_pos,newCol.mBarycentricI,newCol.mBarycentricJ);
 
 /*
@@ -1194,6 +1721,46 @@ static bool G2_TracePolys(const mdxmSurface_t *surface, const mdxmSurfHierarchy_
 	return false;
 }
 
+// the side flags of a vert for G2_RadiusTracePolys, a set bit means it is off that side of the splotch
+static inline int G2_RadiusVertFlags( const float *verts, int stride, int index, const vec3_t rayStart, const vec3_t saxis, const vec3_t taxis, const vec3_t rayDir )
+{
+	vec3_t delta;
+	delta[0]=verts[index]-rayStart[0];
+	delta[1]=verts[stride+index]-rayStart[1];
+	delta[2]=verts[stride*2+index]-rayStart[2];
+	const float s=DotProduct(delta,saxis)+0.5f;
+	const float t=DotProduct(delta,taxis)+0.5f;
+	const float u=DotProduct(delta,rayDir);
+	int vflags=0;
+
+	if (s>0)
+	{
+		vflags|=1;
+	}
+	if (s<1)
+	{
+		vflags|=2;
+	}
+	if (t>0)
+	{
+		vflags|=4;
+	}
+	if (t<1)
+	{
+		vflags|=8;
+	}
+	if (u>0)
+	{
+		vflags|=16;
+	}
+	if (u<1)
+	{
+		vflags|=32;
+	}
+
+	return ~vflags;
+}
+
 // now we're at poly level, check each model space transformed poly against the model world transfomed ray
 static bool G2_RadiusTracePolys(
 								const mdxmSurface_t *surface,
@@ -1242,6 +1809,7 @@ static bool G2_RadiusTracePolys(
 
 	const float * const verts = (float *)TS.TransformedVertsArray[surface->thisSurfaceIndex];
 	const int numVerts = surface->numVerts;
+	const int stride = G2_VERT_STRIDE(numVerts);
 
 	int flags=63;
 	//rayDir/=lengthSquared(raydir);
@@ -1250,64 +1818,59 @@ static bool G2_RadiusTracePolys(
 	v3RayDir[1]/=f;
 	v3RayDir[2]/=f;
 
-	for ( j = 0; j < numVerts; j++ )
+	// a triangle is hit unless all its verts are off the same side of the splotch,
+	// so with a bvh only the verts of the triangles near the ray are looked at
+	G2_BVHRadius radius;
+	VectorCopy(TS.rayStart, radius.start);
+	VectorCopy(saxis, radius.axes[0]);
+	VectorCopy(taxis, radius.axes[1]);
+	VectorCopy(v3RayDir, radius.axes[2]);
+	radius.offsets[0] = radius.offsets[1] = 0.5f;
+	radius.offsets[2] = 0.0f;
+	const int numCandidates = G2_BVHCandidates(surface, verts, radius);
+	// GoreVerts only has room for the flags of MAX_GORE_VERTS verts
+	const bool storedFlags = numCandidates < 0 && numVerts <= MAX_GORE_VERTS;
+
+	if (numCandidates < 0)
 	{
-		const int pos=j*5;
-		vec3_t delta;
-		delta[0]=verts[pos+0]-TS.rayStart[0];
-		delta[1]=verts[pos+1]-TS.rayStart[1];
-		delta[2]=verts[pos+2]-TS.rayStart[2];
-		const float s=DotProduct(delta,saxis)+0.5f;
-		const float t=DotProduct(delta,taxis)+0.5f;
-		const float u=DotProduct(delta,v3RayDir);
-		int vflags=0;
-
-		if (s>0)
-		{
-			vflags|=1;
-		}
-		if (s<1)
-		{
-			vflags|=2;
-		}
-		if (t>0)
-		{
-			vflags|=4;
-		}
-		if (t<1)
-		{
-			vflags|=8;
-		}
-		if (u>0)
+		for ( j = 0; j < numVerts; j++ )
 		{
-			vflags|=16;
+			const int vflags = G2_RadiusVertFlags(verts, stride, j, TS.rayStart, saxis, taxis, v3RayDir);
+			flags&=vflags;
+			if (storedFlags)
+			{
+				GoreVerts[j].flags=vflags;
+			}
 		}
-		if (u<1)
+
+		if (flags)
 		{
-			vflags|=32;
+			return false; // completely off the gore splotch  (so presumably hit nothing? -Ste)
 		}
-
-		vflags=(~vflags);
-		flags&=vflags;
-		GoreVerts[j].flags=vflags;
 	}
-
-	if (flags)
-	{
-		return false; // completely off the gore splotch  (so presumably hit nothing? -Ste)
-	}
-	const int numTris = surface->numTriangles;
+	const int numTris = numCandidates < 0 ? surface->numTriangles : numCandidates;
 	const mdxmTriangle_t * const tris = (mdxmTriangle_t *) ((byte *)surface + surface->ofsTriangles);
 
-	for ( j = 0; j < numTris; j++ )
+	for ( int k = 0; k < numTris; k++ )
 	{
+		j = numCandidates < 0 ? k : g2TraceCandidates[k];
 		assert(tris[j].indexes[0]>=0&&tris[j].indexes[0]<numVerts);
 		assert(tris[j].indexes[1]>=0&&tris[j].indexes[1]<numVerts);
 		assert(tris[j].indexes[2]>=0&&tris[j].indexes[2]<numVerts);
-		flags=63&
-			GoreVerts[tris[j].indexes[0]].flags&
-			GoreVerts[tris[j].indexes[1]].flags&
-			GoreVerts[tris[j].indexes[2]].flags;
+		if (storedFlags)
+		{
+			flags=63&
+				GoreVerts[tris[j].indexes[0]].flags&
+				GoreVerts[tris[j].indexes[1]].flags&
+				GoreVerts[tris[j].indexes[2]].flags;
+		}
+		else
+		{
+			flags=63&
+				G2_RadiusVertFlags(verts, stride, tris[j].indexes[0], TS.rayStart, saxis, taxis, v3RayDir)&
+				G2_RadiusVertFlags(verts, stride, tris[j].indexes[1], TS.rayStart, saxis, taxis, v3RayDir)&
+				G2_RadiusVertFlags(verts, stride, tris[j].indexes[2], TS.rayStart, saxis, taxis, v3RayDir);
+		}
 		int i;
 		if (flags)
 		{
@@ -1337,9 +1900,10 @@ static bool G2_RadiusTracePolys(
 //					}
 
 					//get normal from triangle
-					const float *A = &verts[(tris[j].indexes[0] * 5)];
-					const float *B = &verts[(tris[j].indexes[1] * 5)];
-					const float *C = &verts[(tris[j].indexes[2] * 5)];
+					vec3_t A, B, C;
+					G2_GetTransformedVert(verts, stride, tris[j].indexes[0], A);
+					G2_GetTransformedVert(verts, stride, tris[j].indexes[1], B);
+					G2_GetTransformedVert(verts, stride, tris[j].indexes[2], C);
 					vec3_t normal;
 					vec3_t edgeAC, edgeBA;
 
@@ -1400,6 +1964,172 @@ static bool G2_RadiusTracePolys(
 }
 
 
+/*
+=================
+G2_TraceBench_f
+
+g2_tracebench [rays]
+
+Fires random segment and radius traces at the bind pose of every loaded
+ghoul2 model, once through every triangle and once through the bvhs,
+checks that both find the same collision records and times them.
+=================
+*/
+void G2_TraceBench_f( void )
+{
+	const mdxaBone_t	*bones[iMAX_G2_BONEREFS_PER_SURFACE];
+	static mdxaBone_t	identity;
+	const vec3_t		scale = { 1.0f, 1.0f, 1.0f };
+	surfaceInfo_v		rootSList;
+	int					numRays, i, j, k, type;
+
+	numRays = ri->Cmd_Argc() > 1 ? atoi( ri->Cmd_Argv( 1 ) ) : 1000;
+	if ( numRays < 1 )
+	{
+		numRays = 1;
+	}
+
+	identity.matrix[0][0] = identity.matrix[1][1] = identity.matrix[2][2] = 1.0f;
+	for ( i = 0; i < iMAX_G2_BONEREFS_PER_SURFACE; i++ )
+	{
+		bones[i] = &identity;
+	}
+
+	const int oldBVH = r_Ghoul2TraceBVH->integer;
+	G2_GenerateWorldMatrix( vec3_origin, vec3_origin );
+
+	Com_Printf( "%-40s %6s %8s %8s %8s %8s %8s\n", "model", "tris", "errors", "seg", "seg bvh", "radius", "rad bvh" );
+	for ( i = 1; i < tr.numModels; i++ )
+	{
+		model_t *mod = tr.models[i];
+
+		if ( mod->type != MOD_MDXM || !mod->mdxm || !mod->mdxm->numLODs )
+		{
+			continue;
+		}
+
+		// the bind pose of the first lod
+		const int numSurfaces = mod->mdxm->numSurfaces;
+		std::vector<size_t>		transformedVerts( numSurfaces );
+		std::vector< std::vector<float> >	buffers( numSurfaces );
+		int						numTris = 0;
+		vec3_t					mins, maxs;
+
+		ClearBounds( mins, maxs );
+		for ( j = 0; j < numSurfaces; j++ )
+		{
+			const mdxmSurface_t		*surface = (mdxmSurface_t *)G2_FindSurface( (void *)mod, j, 0 );
+			const g2SurfaceBVH_t	*bvh = G2_SurfaceBVH( surface );
+
+			buffers[j].resize( G2_TransformedSurfaceSize( surface, bvh ) / sizeof( float ) + 1 );
+			float *verts = (float *)( ( (size_t)buffers[j].data() + 15 ) & ~(size_t)15 );
+			G2_SkinVertsScalar( surface, bones, scale, verts );
+			G2_TransformedBVH( surface, verts )->bvh = bvh;
+			G2_TransformedBVH( surface, verts )->fitted = 0;
+			transformedVerts[surface->thisSurfaceIndex] = (size_t)verts;
+
+			for ( k = 0; k < surface->numVerts; k++ )
+			{
+				vec3_t point;
+				G2_GetTransformedVert( verts, G2_VERT_STRIDE(surface->numVerts), k, point );
+				AddPointToBounds( point, mins, maxs );
+			}
+			numTris += surface->numTriangles;
+		}
+
+		if ( !numTris )
+		{
+			continue;
+		}
+
+		// half the rays go through the box of the model, the others at one of its verts
+		std::vector<float>	starts( numRays * 3 ), ends( numRays * 3 );
+		const float			size = Distance( mins, maxs ) + 1.0f;
+
+		for ( j = 0; j < numRays; j++ )
+		{
+			vec3_t target, dir;
+
+			for ( k = 0; k < 3; k++ )
+			{
+				target[k] = mins[k] + ( maxs[k] - mins[k] ) * ( rand() / (float)RAND_MAX );
+				dir[k] = ( rand() / (float)RAND_MAX ) * 2.0f - 1.0f;
+			}
+			if ( j & 1 )
+			{
+				const mdxmSurface_t	*surface = (mdxmSurface_t *)G2_FindSurface( (void *)mod, rand() % numSurfaces, 0 );
+				const float			*verts = (float *)transformedVerts[surface->thisSurfaceIndex];
+
+				if ( surface->numVerts )
+				{
+					G2_GetTransformedVert( verts, G2_VERT_STRIDE(surface->numVerts), rand() % surface->numVerts, target );
+				}
+			}
+			VectorNormalize( dir );
+			VectorMA( target, size, dir, &starts[j * 3] );
+			VectorMA( target, -size, dir, &ends[j * 3] );
+		}
+
+		// segment and radius traces, through every triangle and then with the bvhs
+		std::vector<CollisionRecord_t>	results[2];
+		int								msec[2][2], errors = 0;
+
+		for ( type = 0; type < 2; type++ )
+		{
+			for ( int useBVH = 0; useBVH < 2; useBVH++ )
+			{
+				ri->Cvar_SetValue( "r_ghoul2tracebvh", useBVH );
+				results[useBVH].resize( numRays * MAX_G2_COLLISIONS );
+				memset( results[useBVH].data(), 0, results[useBVH].size() * sizeof( CollisionRecord_t ) );
+
+				const int start = ri->Milliseconds();
+				for ( j = 0; j < numRays; j++ )
+				{
+					CollisionRecord_t *collRecMap = &results[useBVH][j * MAX_G2_COLLISIONS];
+
+					for ( k = 0; k < MAX_G2_COLLISIONS; k++ )
+					{
+						collRecMap[k].mEntityNum = -1;
+					}
+
+					CTraceSurface TS( 0, rootSList, mod, 0, &starts[j * 3], &ends[j * 3], collRecMap, 0, 0, NULL, NULL, transformedVerts.data(), G2_COLLIDE,
+						type ? 2.0f : 0.0f, 0.0f, 0.0f, 0.0f, 0, NULL, NULL );
+
+					for ( k = 0; k < numSurfaces && !TS.hitOne; k++ )
+					{
+						const mdxmSurface_t *surface = (mdxmSurface_t *)G2_FindSurface( (void *)mod, k, 0 );
+
+						if ( type )
+						{
+							G2_RadiusTracePolys( surface, TS );
+						}
+						else
+						{
+							G2_TracePolys( surface, NULL, TS );
+						}
+					}
+				}
+				msec[type][useBVH] = ri->Milliseconds() - start;
+			}
+
+			if ( memcmp( results[0].data(), results[1].data(), results[0].size() * sizeof( CollisionRecord_t ) ) )
+			{
+				for ( j = 0; j < numRays; j++ )
+				{
+					if ( memcmp( &results[0][j * MAX_G2_COLLISIONS], &results[1][j * MAX_G2_COLLISIONS], MAX_G2_COLLISIONS * sizeof( CollisionRecord_t ) ) )
+					{
+						errors++;
+					}
+				}
+			}
+		}
+
+		Com_Printf( "%-40s %6i %8i %8i %8i %8i %8i\n", mod->name, numTris, errors, msec[0][0], msec[0][1], msec[1][0], msec[1][1] );
+	}
+
+	ri->Cvar_SetValue( "r_ghoul2tracebvh", oldBVH );
+}
+
 // look at a surface and then do the trace on each poly
 static void G2_TraceSurfaces(CTraceSurface &TS)
 {
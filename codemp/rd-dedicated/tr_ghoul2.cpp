@@ -338,6 +338,10 @@ public:
 	bool			mUnsquash;
 	float			mSmoothFactor;
 
+	// G2_EvaluateSkeletons evaluated every bone at this touch, from this bone list
+	int				mPrecomputedTouch;
+	std::vector<byte>	mPrecomputedBoneList;
+
 	CBoneCache(const model_t *amod,const mdxaHeader_t *aheader) :
 		header(aheader),
 		mod(amod)
@@ -347,6 +351,7 @@ public:
 		mSmoothingActive=false;
 		mUnsquash=false;
 		mSmoothFactor=0.0f;
+		mPrecomputedTouch=0;
 
 		int numBones=header->numBones;
 		mBones.resize(numBones);
@@ -1311,15 +1316,15 @@ void G2_RagGetAnimMatrix(CGhoul2Info &ghoul2, const int boneNum, mdxaBone_t &mat
 void G2_TransformBone (int child,CBoneCache &BC)
 {
 	SBoneCalc &TB=BC.mBones[child];
-	static mdxaBone_t		tbone[6];
+	mdxaBone_t		tbone[6];
 // 	mdxaFrame_t		*aFrame=0;
 //	mdxaFrame_t		*bFrame=0;
 //	mdxaFrame_t		*aoldFrame=0;
 //	mdxaFrame_t		*boldFrame=0;
-	static mdxaSkel_t		*skel;
-	static mdxaSkelOffsets_t *offsets;
+	mdxaSkel_t		*skel;
+	mdxaSkelOffsets_t *offsets;
 	boneInfo_v		&boneList = *BC.rootBoneList;
-	static int				j, boneListIndex;
+	int				j, boneListIndex;
 	int				angleOverride = 0;
 
 #if DEBUG_G2_TIMING
@@ -1567,7 +1572,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 			// this is crazy, we are gonna drive the animation to ID while we are doing post mults to compensate.
 			Multiply_3x4Matrix(&temp,&firstPass, &skel->BasePoseMat);
 			float	matrixScale = VectorLength((float*)&temp);
-			static mdxaBone_t		toMatrix =
+			mdxaBone_t		toMatrix =
 			{
 				{
 					{ 1.0f, 0.0f, 0.0f, 0.0f },
@@ -1844,6 +1849,30 @@ void G2_SetUpBolts( mdxaHeader_t *header, CGhoul2Info &ghoul2, mdxaBone_v &boneP
 //rww - RAGDOLL_END
 //rwwFIXMEFIXME: Move this into the stupid header or something.
 
+/*
+Skeletons evaluated by G2_EvaluateSkeletons are kept by G2_TransformGhoulBones
+as long as nothing else touched the bone cache since and the input is the same,
+so queries get the bones without transforming them again. The bones only
+depend on the bone list, the root matrix, the time and the models.
+*/
+static bool G2_PrecomputedSkeletonMatches(const CBoneCache &BC, const boneInfo_v &rootBoneList, const mdxaBone_t &rootMatrix, const model_t *currentModel, const mdxaHeader_t *aHeader, int time)
+{
+	if (BC.mPrecomputedTouch!=BC.mCurrentTouch||HackadelicOnClient)
+	{
+		return false;
+	}
+	if (BC.mod!=currentModel||BC.header!=aHeader||BC.rootBoneList!=&rootBoneList||BC.incomingTime!=time)
+	{
+		return false;
+	}
+	if (memcmp(&BC.rootMatrix,&rootMatrix,sizeof(mdxaBone_t)))
+	{
+		return false;
+	}
+	const size_t size=rootBoneList.size()*sizeof(boneInfo_t);
+	return BC.mPrecomputedBoneList.size()==size&&(!size||!memcmp(BC.mPrecomputedBoneList.data(),rootBoneList.data(),size));
+}
+
 void G2_TransformGhoulBones(boneInfo_v &rootBoneList,mdxaBone_t &rootMatrix, CGhoul2Info &ghoul2, int time,bool smooth=true)
 {
 #ifdef G2_PERFORMANCE_ANALYSIS
@@ -1886,6 +1915,14 @@ void G2_TransformGhoulBones(boneInfo_v &rootBoneList,mdxaBone_t &rootMatrix, CGh
 		g_Ghoul2Allocations += sizeof(*ghoul2.mBoneCache);
 #endif
 	}
+	else if (G2_PrecomputedSkeletonMatches(*ghoul2.mBoneCache,rootBoneList,rootMatrix,currentModel,aHeader,time))
+	{
+		// G2_EvaluateSkeletons already transformed every bone from the same input
+#ifdef G2_PERFORMANCE_ANALYSIS
+		G2Time_G2_TransformGhoulBones += G2PerformanceTimer_G2_TransformGhoulBones.End();
+#endif
+		return;
+	}
 	ghoul2.mBoneCache->mod=currentModel;
 	ghoul2.mBoneCache->header=aHeader;
 	assert((int)ghoul2.mBoneCache->mBones.size()==aHeader->numBones);
@@ -2941,6 +2978,64 @@ void G2_ConstructGhoulSkeleton( CGhoul2Info_v &ghoul2,const int frameNum,bool ch
 #endif
 }
 
+// every bone cache only belongs to one model, so they can be evaluated concurrently
+static void G2_EvaluateSkeletonJob( void *data, int index )
+{
+	CBoneCache &BC = *((CBoneCache **)data)[index];
+
+	for ( int i = 0; i < (int)BC.mBones.size(); i++ )
+	{
+		BC.Eval( i );
+	}
+}
+
+/*
+==============
+G2_EvaluateSkeletons
+
+Constructs the skeletons of the ghoul2 instances for this time and scale and
+transforms all their bones on the job workers, skipping the ones that are
+still valid. Later G2_ConstructGhoulSkeleton calls with the same input keep
+the bones.
+==============
+*/
+void G2_EvaluateSkeletons( CGhoul2Info_v **ghoul2List, const vec3_t *scales, int count, int time )
+{
+	static std::vector<CBoneCache *>	dirty;
+	int									i, j;
+
+	dirty.clear();
+	for ( i = 0; i < count; i++ )
+	{
+		CGhoul2Info_v &ghoul2 = *ghoul2List[i];
+
+		if ( !G2_SetupModelPointers( ghoul2 ) )
+		{
+			continue;
+		}
+
+		// bolted models get their root matrix from the scaled bolt
+		G2_ConstructGhoulSkeleton( ghoul2, time, true, scales[i] );
+
+		for ( j = 0; j < ghoul2.size(); j++ )
+		{
+			CBoneCache *BC = ghoul2[j].mBoneCache;
+
+			if ( !ghoul2[j].mValid || !BC || BC->mPrecomputedTouch == BC->mCurrentTouch )
+			{
+				continue;
+			}
+
+			const byte *boneList = (const byte *)ghoul2[j].mBlist.data();
+			BC->mPrecomputedBoneList.assign( boneList, boneList + ghoul2[j].mBlist.size() * sizeof( boneInfo_t ) );
+			BC->mPrecomputedTouch = BC->mCurrentTouch;
+			dirty.push_back( BC );
+		}
+	}
+
+	Com_RunJobs( G2_EvaluateSkeletonJob, dirty.data(), (int)dirty.size() );
+}
+
 /*
 =================
 R_LoadMDXM - load a Ghoul 2 Mesh file
@@ -185,6 +185,7 @@ cvar_t	*r_noPrecacheGLA;
 cvar_t	*r_noServerGhoul2;
 cvar_t	*r_Ghoul2AnimSmooth=0;
 cvar_t	*r_Ghoul2UnSqashAfterSmooth=0;
+cvar_t	*r_Ghoul2TraceBVH=0;
 //cvar_t	*r_Ghoul2UnSqash;
 //cvar_t	*r_Ghoul2TimeBase=0; from single player
 //cvar_t	*r_Ghoul2NoLerp;
@@ -286,6 +287,8 @@ static consoleCommand_t	commands[] = {
 	{ "modellist",			R_Modellist_f },
 	{ "modelist",			R_ModeList_f },
 	{ "modelcacheinfo",		RE_RegisterModels_Info_f },
+	{ "g2_skinbench",		G2_SkinBench_f },
+	{ "g2_tracebench",		G2_TraceBench_f },
 };
 
 static const size_t numCommands = ARRAY_LEN( commands );
@@ -438,6 +441,7 @@ Ghoul2 Insert Start
 	r_noServerGhoul2					= ri->Cvar_Get( "r_noserverghoul2",					"0",						CVAR_CHEAT, "" );
 	r_Ghoul2AnimSmooth					= ri->Cvar_Get( "r_ghoul2animsmooth",				"0.3",						CVAR_NONE, "" );
 	r_Ghoul2UnSqashAfterSmooth			= ri->Cvar_Get( "r_ghoul2unsqashaftersmooth",		"1",						CVAR_NONE, "" );
+	r_Ghoul2TraceBVH					= ri->Cvar_Get( "r_ghoul2tracebvh",					"1",						CVAR_NONE, "" );
 	broadsword							= ri->Cvar_Get( "broadsword",						"0",						CVAR_NONE, "" );
 	broadsword_kickbones				= ri->Cvar_Get( "broadsword_kickbones",				"1",						CVAR_NONE, "" );
 	broadsword_kickorigin				= ri->Cvar_Get( "broadsword_kickorigin",			"1",						CVAR_NONE, "" );
@@ -674,5 +678,7 @@ refexport_t *GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 	re.G2API_ClearSkinGore					= G2API_ClearSkinGore;
 	#endif // _SOF2
 
+	re.ext.G2API_EvaluateSkeletons			= G2API_EvaluateSkeletons;
+
 	return &re;
 }
@@ -1651,6 +1651,9 @@ CRenderableSurface():
 
 void R_AddGhoulSurfaces( trRefEntity_t *ent );
 void RB_SurfaceGhoul( CRenderableSurface *surface );
+void G2_SkinBench_f( void );
+void G2_TraceBench_f( void );
+void G2_FreeSurfaceBVHs( void );
 /*
 Ghoul2 Insert End
 */
@@ -383,6 +383,11 @@ qboolean RE_RegisterModels_LevelLoadEnd(qboolean bDeleteEverythingNotUsedThisLev
 		}
 	}
 
+	if (bAtLeastoneModelFreed)
+	{
+		G2_FreeSurfaceBVHs();
+	}
+
 	ri->Printf( PRINT_DEVELOPER, S_COLOR_RED "RE_RegisterModels_LevelLoadEnd(): Ok\n");
 
 	return bAtLeastoneModelFreed;
@@ -437,6 +442,8 @@ static void RE_RegisterModels_DumpNonPure(void)
 		}
 	}
 
+	G2_FreeSurfaceBVHs();
+
 	ri->Printf( PRINT_DEVELOPER, "RE_RegisterModels_DumpNonPure(): Ok\n");
 }
 
@@ -485,6 +492,8 @@ static void RE_RegisterModels_DeleteAll(void)
 
 		CachedModels->erase(itModel++);
 	}
+
+	G2_FreeSurfaceBVHs();
 }
 
 
@@ -1572,6 +1581,8 @@ void R_ModelInit( void )
 
 	mod = R_AllocModel();
 	mod->type = MOD_BAD;
+
+	G2_FreeSurfaceBVHs();
 }
 
 extern void KillTheShaderHashTable(void);
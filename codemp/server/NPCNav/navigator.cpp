@@ -105,15 +105,11 @@ CNode::CNode( void )
 {
 	m_numEdges		= 0;
 	m_radius		= 0;
-	m_ranks			= NULL;
 }
 
 CNode::~CNode( void )
 {
 	m_edges.clear();
-
-	if ( m_ranks )
-		delete [] m_ranks;
 }
 
 /*
@@ -205,19 +201,6 @@ int CNode::GetEdgeNumToNode( int ID )
 	return -1;
 }
 
-/*
--------------------------
-AddRank
--------------------------
-*/
-
-void CNode::AddRank( int ID, int rank )
-{
-	assert( m_ranks );
-
-	m_ranks[ ID ] = rank;
-}
-
 /*
 -------------------------
 Draw
@@ -342,47 +325,13 @@ void CNode::SetEdgeFlags( int edgeNum, int newFlags )
 	}
 
 }
-/*
--------------------------
-InitRanks
--------------------------
-*/
-
-void CNode::InitRanks( int size )
-{
-	//Clear it if it's already allocated
-	if ( m_ranks != NULL )
-	{
-		delete [] m_ranks;
-		m_ranks = NULL;
-	}
-
-	m_ranks = new int[size];
-
-	memset( m_ranks, -1, sizeof(int)*size );
-}
-
-/*
--------------------------
-GetRank
--------------------------
-*/
-
-int CNode::GetRank( int ID )
-{
-	assert( m_ranks );
-
-	return m_ranks[ ID ];
-}
-
-
 /*
 -------------------------
 Save
 -------------------------
 */
 
-int	CNode::Save( int numNodes, fileHandle_t file )
+int	CNode::Save( fileHandle_t file )
 {
 	//Write out the header
 	unsigned int header = NODE_HEADER_ID;
@@ -406,13 +355,7 @@ int	CNode::Save( int numNodes, fileHandle_t file )
 		FS_Write( &(*ei), sizeof( edge_t ), file );
 	}
 
-	//Write out the node ranks
-	FS_Write( &numNodes, sizeof( numNodes ), file );
-
-	for ( i = 0; i < numNodes; i++ )
-	{
-		FS_Write( &m_ranks[i], sizeof( int ), file );
-	}
+	//The node ranks follow, the navigator writes them
 
 	return true;
 }
@@ -423,7 +366,7 @@ Load
 -------------------------
 */
 
-int CNode::Load( int numNodes, fileHandle_t file )
+int CNode::Load( fileHandle_t file )
 {
 	unsigned int header;
 	FS_Read( &header, sizeof(header), file );
@@ -453,18 +396,7 @@ int CNode::Load( int numNodes, fileHandle_t file )
 		STL_INSERT( m_edges, edge );
 	}
 
-	//Read the node ranks
-	int	numRanks;
-
-	FS_Read( &numRanks, sizeof( numRanks ), file );
-
-	//Allocate the memory
-	InitRanks( numRanks );
-
-	for ( i = 0; i < numRanks; i++ )
-	{
-		FS_Read( &m_ranks[i], sizeof( int ), file );
-	}
+	//The node ranks follow, the navigator reads them
 
 	return true;
 }
@@ -477,6 +409,13 @@ CNavigator
 
 CNavigator::CNavigator( void )
 {
+	m_numRanks	= 0;
+	m_ranks		= NULL;
+	m_ranks16	= NULL;
+	m_routeJobs	= 0;
+	m_routeGraphValid = false;
+	m_gridValid	= false;
+
 #if 0 // RAVEN... why u make it so hard to double link list cvars
 	if (!d_altRoutes || !d_patched)
 	{
@@ -487,6 +426,7 @@ CNavigator::CNavigator( void )
 
 CNavigator::~CNavigator( void )
 {
+	FreeRanks();
 }
 
 /*
@@ -505,6 +445,48 @@ void CNavigator::FlagAllNodes( int newFlag )
 	}
 }
 
+/*
+-------------------------
+StoreCombatPoints
+-------------------------
+*/
+
+void CNavigator::StoreCombatPoints( const navCombatPoint_t *points, int numPoints )
+{
+	m_combatPoints.assign( points, points + Q_max( numPoints, 0 ) );
+}
+
+/*
+-------------------------
+RestoreCombatPoints
+
+Only hands out the stored waypoints if the combat points are still the
+same ones, in the same order
+-------------------------
+*/
+
+qboolean CNavigator::RestoreCombatPoints( navCombatPoint_t *points, int numPoints )
+{
+	if ( numPoints <= 0 || numPoints != (int)m_combatPoints.size() )
+		return qfalse;
+
+	for ( int i = 0; i < numPoints; i++ )
+	{
+		if ( !VectorCompare( points[i].origin, m_combatPoints[i].origin ) )
+			return qfalse;
+
+		if ( m_combatPoints[i].waypoint < NODE_NONE || m_combatPoints[i].waypoint >= (int)m_nodes.size() )
+			return qfalse;
+	}
+
+	for ( int i = 0; i < numPoints; i++ )
+	{
+		points[i].waypoint = m_combatPoints[i].waypoint;
+	}
+
+	return qtrue;
+}
+
 /*
 -------------------------
 GetChar
@@ -598,6 +580,18 @@ void CNavigator::Free( void )
 
 	m_nodes.clear();
 	m_edgeLookupMap.clear();
+
+	FreeRanks();
+	m_routeEdgeStart.clear();
+	m_routeEdgeNode.clear();
+	m_routeEdgeCost.clear();
+	m_routeGraphValid = false;
+
+	m_gridValid = false;
+	m_gridCellStart.clear();
+	m_gridNodes.clear();
+
+	m_combatPoints.clear();
 }
 
 /*
@@ -640,17 +634,45 @@ bool CNavigator::Load( const char *filename, int checksum )
 
 	int numNodes = GetInt( file );
 
+	if ( numNodes < 0 )
+	{
+		FS_FCloseFile( file );
+		return false;
+	}
+
+	InitRanks( numNodes );
+
+	std::vector < int >	ranks( numNodes );
+
 	for ( int i = 0; i < numNodes; i++ )
 	{
 		CNode	*node = CNode::Create();
 
-		if ( node->Load( numNodes, file ) == false )
+		if ( node->Load( file ) == false )
 		{
+			delete node;
 			FS_FCloseFile( file );
 			return false;
 		}
 
 		STL_INSERT( m_nodes, node );
+
+		//Read the node ranks, the rows have to match the node count
+		if ( GetInt( file ) != numNodes )
+		{
+			FS_FCloseFile( file );
+			return false;
+		}
+
+		if ( numNodes )
+		{
+			FS_Read( &ranks[0], sizeof( int ) * numNodes, file );
+		}
+
+		for ( int j = 0; j < numNodes; j++ )
+		{
+			SetRank( i, j, ranks[j] );
+		}
 	}
 
 	//read in the failed edges
@@ -660,9 +682,26 @@ bool CNavigator::Load( const char *filename, int checksum )
 		m_edgeLookupMap.insert(std::pair<int, int>(failedEdges[j].startID, j));
 	}
 
+	//Older files end here, the combat points are found again for them
+	int	routes[5];
+
+	if ( FS_Read( routes, sizeof( routes ), file ) == sizeof( routes )
+		&& routes[0] == NAV_ROUTES_ID && routes[1] == NAV_ROUTES_VERSION
+		&& routes[2] == checksum && routes[3] == numNodes
+		&& routes[4] > 0 && routes[4] <= MAX_GENTITIES )
+	{
+		m_combatPoints.resize( routes[4] );
+
+		if ( FS_Read( &m_combatPoints[0], sizeof( navCombatPoint_t ) * routes[4], file ) != (int)sizeof( navCombatPoint_t ) * routes[4] )
+		{
+			m_combatPoints.clear();
+		}
+	}
 
 	FS_FCloseFile( file );
 
+	BuildRouteGraph();
+
 	return true;
 }
 
@@ -695,17 +734,37 @@ bool CNavigator::Save( const char *filename, int checksum )
 	//Write out the number of nodes to follow
 	FS_Write( &numNodes, sizeof(numNodes), file );
 
-	//Write out all the nodes
-	node_v::iterator	ni;
+	//Write out all the nodes, each followed by its ranks
+	std::vector < int >	ranks( numNodes );
 
-	STL_ITERATE( ni, m_nodes )
+	for ( int i = 0; i < numNodes; i++ )
 	{
-		(*ni)->Save( numNodes, file );
+		m_nodes[i]->Save( file );
+
+		for ( int j = 0; j < numNodes; j++ )
+		{
+			ranks[j] = m_numRanks == numNodes ? GetRank( i, j ) : NODE_NONE;
+		}
+
+		FS_Write( &numNodes, sizeof( numNodes ), file );
+		if ( numNodes )
+		{
+			FS_Write( &ranks[0], sizeof( int ) * numNodes, file );
+		}
 	}
 
 	//write out failed edges
 	FS_Write( &failedEdges, sizeof( failedEdges ), file );
 
+	//write out the combat points, older readers stop before them
+	if ( !m_combatPoints.empty() )
+	{
+		int	routes[5] = { NAV_ROUTES_ID, NAV_ROUTES_VERSION, checksum, numNodes, (int)m_combatPoints.size() };
+
+		FS_Write( routes, sizeof( routes ), file );
+		FS_Write( &m_combatPoints[0], sizeof( navCombatPoint_t ) * m_combatPoints.size(), file );
+	}
+
 	FS_FCloseFile( file );
 
 	return true;
@@ -732,6 +791,9 @@ int CNavigator::AddRawPoint( vec3_t point, int flags, int radius )
 
 	STL_INSERT( m_nodes, node );
 
+	m_routeGraphValid = false;
+	m_gridValid = false;
+
 	return node->GetID();
 }
 
@@ -784,6 +846,23 @@ void CNavigator::SetEdgeCost( int ID1, int ID2, int cost )
 		cost = Distance( pos1, pos2 );
 	}
 
+	//Known edges just change cost in the route graph too
+	if ( m_routeGraphValid )
+	{
+		int	edge1 = node1->GetEdgeNumToNode( ID2 );
+		int	edge2 = node2->GetEdgeNumToNode( ID1 );
+
+		if ( edge1 != -1 && edge2 != -1 )
+		{
+			m_routeEdgeCost[ m_routeEdgeStart[ID1] + edge1 ] = cost;
+			m_routeEdgeCost[ m_routeEdgeStart[ID2] + edge2 ] = cost;
+		}
+		else
+		{
+			m_routeGraphValid = false;
+		}
+	}
+
 	//set it
 	node1->AddEdge( ID2, cost );
 	node2->AddEdge( ID1, cost );
@@ -817,73 +896,257 @@ void CNavigator::AddNodeEdges( CNode *node, int addDist, edge_l	&edgeList, bool
 
 /*
 -------------------------
-CalculatePath
+InitRanks
 -------------------------
 */
 
-void CNavigator::CalculatePath( CNode *node )
+void CNavigator::InitRanks( int size )
+{
+	size_t	count = (size_t)size * size;
+
+	FreeRanks();
+
+	m_numRanks = size;
+
+	//Every rank is below the node count, so 16 bits hold them up to 65535 nodes
+	if ( size < 0xFFFF )
+	{
+		m_ranks16 = new unsigned short[count];
+		memset( m_ranks16, 0, sizeof( unsigned short ) * count );
+	}
+	else
+	{
+		m_ranks = new int[count];
+		memset( m_ranks, -1, sizeof( int ) * count );
+	}
+}
+
+/*
+-------------------------
+ResizeRanks
+
+Keeps the ranks of the nodes that are already there, the new rows and
+columns can't be reached until their nodes are calculated
+-------------------------
+*/
+
+void CNavigator::ResizeRanks( int size )
+{
+	int				oldSize = m_numRanks;
+	int				*oldRanks = m_ranks;
+	unsigned short	*oldRanks16 = m_ranks16;
+	int				keep = Q_min( oldSize, size );
+
+	m_ranks		= NULL;
+	m_ranks16	= NULL;
+
+	InitRanks( size );
+
+	for ( int i = 0; i < keep; i++ )
+	{
+		size_t	oldRow = (size_t)i * oldSize;
+
+		if ( oldRanks16 && m_ranks16 )
+		{
+			memcpy( &m_ranks16[(size_t)i * size], &oldRanks16[oldRow], sizeof( unsigned short ) * keep );
+		}
+		else if ( oldRanks && m_ranks )
+		{
+			memcpy( &m_ranks[(size_t)i * size], &oldRanks[oldRow], sizeof( int ) * keep );
+		}
+		else
+		{
+			for ( int j = 0; j < keep; j++ )
+			{
+				SetRank( i, j, oldRanks16 ? (int)oldRanks16[oldRow + j] - 1 : oldRanks[oldRow + j] );
+			}
+		}
+	}
+
+	delete [] oldRanks;
+	delete [] oldRanks16;
+}
+
+/*
+-------------------------
+FreeRanks
+-------------------------
+*/
+
+void CNavigator::FreeRanks( void )
+{
+	delete [] m_ranks;
+	delete [] m_ranks16;
+
+	m_ranks		= NULL;
+	m_ranks16	= NULL;
+	m_numRanks	= 0;
+}
+
+/*
+-------------------------
+BuildRouteGraph
+
+Copies the edges of all nodes into flat arrays for the route searches.
+Done after load and again by the first search after edges were added.
+-------------------------
+*/
+
+void CNavigator::BuildRouteGraph( void )
+{
+	int	numNodes = m_nodes.size();
+
+	m_routeEdgeStart.resize( numNodes + 1 );
+	m_routeEdgeNode.clear();
+	m_routeEdgeCost.clear();
+
+	for ( int i = 0; i < numNodes; i++ )
+	{
+		CNode	*node = m_nodes[i];
+
+		m_routeEdgeStart[i] = m_routeEdgeNode.size();
+
+		for ( int j = 0; j < node->GetNumEdges(); j++ )
+		{
+			m_routeEdgeNode.push_back( node->GetEdge( j ) );
+			m_routeEdgeCost.push_back( node->GetEdgeCost( j ) );
+		}
+	}
+
+	m_routeEdgeStart[numNodes] = m_routeEdgeNode.size();
+
+	m_routeGraphValid = true;
+}
+
+/*
+-------------------------
+CalculateRanks
+
+Floods out from a node and ranks the others in the order they come off
+the queue. The queue is a heap with the same pushes and pops the old
+CEdge one had, so ties come out in the same order.
+-------------------------
+*/
+
+void CNavigator::CalculateRanks( int nodeID, routeScratch_t &scratch )
 {
-	int	curRank = 0;
+	struct routeEntryGreater_t
+	{
+		bool operator()( const routeEntry_t &first, const routeEntry_t &second ) const
+		{
+			return first.cost > second.cost;
+		}
+	} RouteEntryGreater;
 
-	CPriorityQueue	*pathList = new CPriorityQueue();
-	byte			*checked;
+	std::vector < routeEntry_t >	&heap = scratch.heap;
+	std::vector < byte >			&checked = scratch.checked;
+	const int						*edgeStart = &m_routeEdgeStart[0];
+	int								curRank = 0;
 
 	//Init the completion table
-	checked = new byte[ m_nodes.size() ];
-	memset( checked, 0, m_nodes.size() );
+	checked.assign( m_nodes.size(), 0 );
+	heap.clear();
 
 	//Mark this node as checked
-	checked[ node->GetID() ] = true;
-	node->AddRank( node->GetID(), curRank++ );
+	checked[ nodeID ] = true;
+	SetRank( nodeID, nodeID, curRank++ );
 
 	//Add all initial nodes
-	int i;
-	for ( i = 0; i < node->GetNumEdges(); i++ )
+	for ( int i = edgeStart[nodeID]; i < edgeStart[nodeID + 1]; i++ )
 	{
-		CNode	*nextNode = m_nodes[ node->GetEdge(i) ];
-		assert(nextNode);
+		routeEntry_t	entry;
 
-		checked[ nextNode->GetID() ] = true;
+		entry.nodeID	= m_routeEdgeNode[i];
+		entry.cost		= m_routeEdgeCost[i];
 
-		pathList->Push( new CEdge( nextNode->GetID(), nextNode->GetID(), node->GetEdgeCost(i) ) );
-	}
+		checked[ entry.nodeID ] = true;
 
-	//float				minDist;
-	CEdge				*test;
+		heap.push_back( entry );
+		std::push_heap( heap.begin(), heap.end(), RouteEntryGreater );
+	}
 
 	//Now flood fill all the others
-	while ( !pathList->Empty() )
+	while ( !heap.empty() )
 	{
-		//minDist = Q3_INFINITE;
-		test	 = pathList->Pop();
+		routeEntry_t	test = heap.front();
 
-		CNode	*testNode = m_nodes[ (*test).m_first ];
-		assert( testNode );
+		std::pop_heap( heap.begin(), heap.end(), RouteEntryGreater );
+		heap.pop_back();
 
-		node->AddRank( testNode->GetID(), curRank++ );
+		SetRank( nodeID, test.nodeID, curRank++ );
 
 		//Add in all the new edges
-		for ( i = 0; i < testNode->GetNumEdges(); i++ )
+		for ( int i = edgeStart[test.nodeID]; i < edgeStart[test.nodeID + 1]; i++ )
 		{
-			CNode	*addNode = m_nodes[ testNode->GetEdge(i) ];
-			assert( addNode );
+			routeEntry_t	entry;
+
+			entry.nodeID = m_routeEdgeNode[i];
 
-			if ( checked[ addNode->GetID() ] )
+			if ( checked[ entry.nodeID ] )
 				continue;
 
-			int	newDist = (*test).m_cost + testNode->GetEdgeCost(i);
-			pathList->Push( new CEdge( addNode->GetID(), (*test).m_second, newDist ) );
+			entry.cost = test.cost + m_routeEdgeCost[i];
 
-			checked[ addNode->GetID() ] = true;
+			heap.push_back( entry );
+			std::push_heap( heap.begin(), heap.end(), RouteEntryGreater );
+
+			checked[ entry.nodeID ] = true;
 		}
-		delete test;
+	}
+}
+
+/*
+-------------------------
+CalculatePath
+-------------------------
+*/
+
+void CNavigator::CalculatePath( CNode *node )
+{
+	routeScratch_t	scratch;
 
+	if ( m_numRanks != (int)m_nodes.size() )
+	{
+		ResizeRanks( m_nodes.size() );
 	}
 
+	if ( !m_routeGraphValid )
+	{
+		BuildRouteGraph();
+	}
+
+	//Forget the old ranks of this node
+	for ( int i = 0; i < m_numRanks; i++ )
+	{
+		SetRank( node->GetID(), i, NODE_NONE );
+	}
+
+	CalculateRanks( node->GetID(), scratch );
+
 	node->RemoveFlag( NF_RECALC );
+}
+
+/*
+-------------------------
+CalculatePathsJob
+
+Each job runs the searches of every m_routeJobs'th node
+-------------------------
+*/
 
-	delete pathList;
-	delete [] checked;
+void CNavigator::CalculatePathsJob( void *data, int index )
+{
+	CNavigator		*nav = (CNavigator *)data;
+	int				numNodes = nav->m_nodes.size();
+	routeScratch_t	scratch;
+
+	scratch.heap.reserve( numNodes );
+	scratch.checked.reserve( numNodes );
+
+	for ( int i = index; i < numNodes; i += nav->m_routeJobs )
+	{
+		nav->CalculateRanks( i, scratch );
+	}
 }
 
 /*
@@ -896,16 +1159,26 @@ void CNavigator::CalculatePaths( qboolean recalc )
 #if _HARD_CONNECT
 #else
 #endif
+	int	numNodes = m_nodes.size();
+
+	//Allocate the needed memory
+	InitRanks( numNodes );
 
-	for ( size_t i = 0; i < m_nodes.size(); i++ )
+	if ( numNodes )
 	{
-		//Allocate the needed memory
-		m_nodes[i]->InitRanks( m_nodes.size() );
+		if ( !m_routeGraphValid )
+		{
+			BuildRouteGraph();
+		}
+
+		//A few jobs per worker so the uneven searches even out
+		m_routeJobs = Q_min( numNodes, ( Com_JobWorkers() + 1 ) * 4 );
+		Com_RunJobs( CalculatePathsJob, this, m_routeJobs );
 	}
 
-	for ( size_t i = 0; i < m_nodes.size(); i++ )
+	for ( int i = 0; i < numNodes; i++ )
 	{
-		CalculatePath( m_nodes[i] );
+		m_nodes[i]->RemoveFlag( NF_RECALC );
 	}
 
 	if(!recalc)	//Mike says doesn't need to happen on recalc
@@ -1146,6 +1419,8 @@ void CNavigator::HardConnect( int first, int second )
 
 	start->AddEdge( second, cost, flags );
 	end->AddEdge( first, cost, flags );
+
+	m_routeGraphValid = false;
 }
 
 #endif
@@ -1247,79 +1522,169 @@ int	CNavigator::TestBestFirst( sharedEntity_t *ent, int lastID, int flags )
 
 /*
 -------------------------
-CollectNearestNodes
+BuildNodeGrid
 -------------------------
 */
 
-#define	NODE_COLLECT_MAX	16		//Maximum # of nodes collected at any time
-#define NODE_COLLECT_RADIUS	512		//Default radius to search for nodes in
-#define NODE_COLLECT_RADIUS_SQR		( NODE_COLLECT_RADIUS * NODE_COLLECT_RADIUS )
+#define	NODE_GRID_CELL_SIZE	256		//Smallest cell size of the node lookup grid
+#define	NODE_GRID_MAX_CELLS	256		//Cells per axis at most, larger maps get larger cells
 
-int CNavigator::CollectNearestNodes( vec3_t origin, int radius, int maxCollect, nodeChain_l &nodeChain )
+void CNavigator::BuildNodeGrid( void )
 {
 	node_v::iterator	ni;
-	float				dist;
 	vec3_t				position;
-	int					collected = 0;
-	bool				added = false;
+	float				maxs[2];
+	int					numCells;
+
+	m_gridValid = true;
+	m_gridCellStart.clear();
+	m_gridNodes.clear();
+
+	if ( m_nodes.empty() )
+		return;
+
+	m_gridMins[0] = m_gridMins[1] = Q3_INFINITE;
+	maxs[0] = maxs[1] = -Q3_INFINITE;
 
-	//Get a distance rating for each node in the system
 	STL_ITERATE( ni, m_nodes )
 	{
-		//If we've got our quota, then stop looking
-		//Get the distance to the node
 		(*ni)->GetPosition( position );
-		dist = DistanceSquared( position, origin );
 
-		//Must be within our radius range
-		if ( dist > (float) ( radius * radius ) )
-			continue;
+		for ( int i = 0; i < 2; i++ )
+		{
+			m_gridMins[i] = Q_min( m_gridMins[i], position[i] );
+			maxs[i] = Q_max( maxs[i], position[i] );
+		}
+	}
 
-		nodeList_t				nChain;
-		nodeChain_l::iterator	nci;
+	m_gridCellSize = Q_max( (float)NODE_GRID_CELL_SIZE, Q_max( maxs[0] - m_gridMins[0], maxs[1] - m_gridMins[1] ) / NODE_GRID_MAX_CELLS );
 
-		//Always add the first node
-		if ( nodeChain.size() == 0 )
-		{
-			nChain.nodeID = (*ni)->GetID();
-			nChain.distance = dist;
+	for ( int i = 0; i < 2; i++ )
+	{
+		m_gridSize[i] = Q_min( (int)( ( maxs[i] - m_gridMins[i] ) / m_gridCellSize ) + 1, NODE_GRID_MAX_CELLS );
+	}
 
-			nodeChain.insert( nodeChain.begin(), nChain );
-			continue;
+	numCells = m_gridSize[0] * m_gridSize[1];
+
+	//Count the nodes per cell, then place them in node order
+	std::vector < int >	nodeCell( m_nodes.size() );
+
+	m_gridCellStart.assign( numCells + 1, 0 );
+	m_gridNodes.resize( m_nodes.size() );
+
+	for ( size_t n = 0; n < m_nodes.size(); n++ )
+	{
+		int	cell[2];
+
+		m_nodes[n]->GetPosition( position );
+
+		for ( int i = 0; i < 2; i++ )
+		{
+			cell[i] = Q_min( (int)( ( position[i] - m_gridMins[i] ) / m_gridCellSize ), m_gridSize[i] - 1 );
 		}
 
-		added = false;
+		nodeCell[n] = cell[1] * m_gridSize[0] + cell[0];
+		m_gridCellStart[ nodeCell[n] + 1 ]++;
+	}
+
+	for ( int i = 0; i < numCells; i++ )
+	{
+		m_gridCellStart[i + 1] += m_gridCellStart[i];
+	}
+
+	std::vector < int >	fill( m_gridCellStart.begin(), m_gridCellStart.end() - 1 );
+
+	for ( size_t n = 0; n < m_nodes.size(); n++ )
+	{
+		gridNode_t	&gridNode = m_gridNodes[ fill[ nodeCell[n] ]++ ];
+
+		gridNode.nodeID = m_nodes[n]->GetID();
+		m_nodes[n]->GetPosition( gridNode.position );
+	}
+}
+
+/*
+-------------------------
+CollectNearestNodes
+
+Fills nodeChain with up to maxCollect nodes within radius, nearest first.
+Distances are compared in whole units and ties keep the node order, the
+way the old insertion into a list did.
+-------------------------
+*/
+
+#define	NODE_COLLECT_MAX	16		//Maximum # of nodes collected at any time
+#define NODE_COLLECT_RADIUS	512		//Default radius to search for nodes in
+#define NODE_COLLECT_RADIUS_SQR		( NODE_COLLECT_RADIUS * NODE_COLLECT_RADIUS )
+
+static inline bool NodeListLess( unsigned int distance, int nodeID, unsigned int otherDistance, int otherID )
+{
+	return distance < otherDistance || ( distance == otherDistance && nodeID < otherID );
+}
+
+int CNavigator::CollectNearestNodes( vec3_t origin, int radius, int maxCollect, nodeList_t *nodeChain )
+{
+	float	dist;
+	int		collected = 0;
+	int		cellMins[2], cellMaxs[2];
+
+	if ( !m_gridValid )
+	{
+		BuildNodeGrid();
+	}
 
-		//Compare it to what we already have
-		STL_ITERATE( nci, nodeChain )
+	if ( m_gridNodes.empty() || maxCollect <= 0 )
+		return 0;
+
+	//Find the cells the radius touches, with a cell to spare for rounding
+	for ( int i = 0; i < 2; i++ )
+	{
+		float	low = ( origin[i] - radius - m_gridMins[i] ) / m_gridCellSize;
+		float	high = ( origin[i] + radius - m_gridMins[i] ) / m_gridCellSize;
+
+		if ( high < -1.0f || low > m_gridSize[i] )
+			return 0;
+
+		cellMins[i] = Q_max( (int)floor( low ) - 1, 0 );
+		cellMaxs[i] = Q_min( (int)floor( high ) + 1, m_gridSize[i] - 1 );
+	}
+
+	for ( int y = cellMins[1]; y <= cellMaxs[1]; y++ )
+	{
+		const int	*cellStart = &m_gridCellStart[ y * m_gridSize[0] ];
+
+		for ( int j = cellStart[ cellMins[0] ]; j < cellStart[ cellMaxs[0] + 1 ]; j++ )
 		{
-			//If we're less, than this entry, then insert before it
-			if ( dist < (*nci).distance )
-			{
-				nChain.nodeID = (*ni)->GetID();
-				nChain.distance = dist;
+			const gridNode_t	&gridNode = m_gridNodes[j];
 
-				nodeChain.insert( nci, nChain );
-				collected = nodeChain.size();
-				added = true;
+			//Get the distance to the node
+			dist = DistanceSquared( gridNode.position, origin );
 
-				//If we've hit our collection limit, throw off the oldest one
-				if ( (int)nodeChain.size() > maxCollect )
-				{
-					nodeChain.pop_back();
-				}
+			//Must be within our radius range
+			if ( dist > (float) ( radius * radius ) )
+				continue;
 
-				break;
+			unsigned int	distance = dist;
+			int				slot = Q_min( collected, maxCollect - 1 );
+
+			//Full and no closer than the last one
+			if ( collected == maxCollect && !NodeListLess( distance, gridNode.nodeID, nodeChain[slot].distance, nodeChain[slot].nodeID ) )
+				continue;
+
+			//Insert it in order, dropping the last one when full
+			while ( slot > 0 && NodeListLess( distance, gridNode.nodeID, nodeChain[slot - 1].distance, nodeChain[slot - 1].nodeID ) )
+			{
+				nodeChain[slot] = nodeChain[slot - 1];
+				slot--;
 			}
-		}
 
-		//Otherwise, always pad out the collection if possible so we don't miss anything
-		if ( ( added == false ) && ( (int)nodeChain.size() < maxCollect ) )
-		{
-			nChain.nodeID = (*ni)->GetID();
-			nChain.distance = dist;
+			nodeChain[slot].nodeID = gridNode.nodeID;
+			nodeChain[slot].distance = distance;
 
-			nodeChain.insert( nodeChain.end(), nChain );
+			if ( collected < maxCollect )
+			{
+				collected++;
+			}
 		}
 	}
 
@@ -1334,14 +1699,14 @@ int CNavigator::GetBestPathBetweenEnts( sharedEntity_t *ent, sharedEntity_t *goa
 
 #define	MAX_Z_DELTA	18
 
-	nodeChain_l				nodeChain;
-	nodeChain_l::iterator	nci;
-	nodeChain_l				nodeChain2;
-	nodeChain_l::iterator	nci2;
+	nodeList_t				nodeChain[NODE_COLLECT_MAX];
+	nodeList_t				*nci;
+	nodeList_t				nodeChain2[NODE_COLLECT_MAX];
+	nodeList_t				*nci2;
 
 	//Collect all nodes within a certain radius
-	CollectNearestNodes( ent->r.currentOrigin, NODE_COLLECT_RADIUS, NODE_COLLECT_MAX, nodeChain );
-	CollectNearestNodes( goal->r.currentOrigin, NODE_COLLECT_RADIUS, NODE_COLLECT_MAX, nodeChain2 );
+	int	numCollected = CollectNearestNodes( ent->r.currentOrigin, NODE_COLLECT_RADIUS, NODE_COLLECT_MAX, nodeChain );
+	int	numCollected2 = CollectNearestNodes( goal->r.currentOrigin, NODE_COLLECT_RADIUS, NODE_COLLECT_MAX, nodeChain2 );
 
 	vec3_t				position;
 	vec3_t				position2;
@@ -1357,7 +1722,7 @@ int CNavigator::GetBestPathBetweenEnts( sharedEntity_t *ent, sharedEntity_t *goa
 	goal->waypoint = NODE_NONE;
 
 	//Look through all nodes
-	STL_ITERATE( nci, nodeChain )
+	for ( nci = nodeChain; nci < nodeChain + numCollected; nci++ )
 	{
 		node = m_nodes[(*nci).nodeID];
 		nodeNum = (*nci).nodeID;
@@ -1420,7 +1785,7 @@ int CNavigator::GetBestPathBetweenEnts( sharedEntity_t *ent, sharedEntity_t *goa
 			}
 		}
 
-		STL_ITERATE( nci2, nodeChain2 )
+		for ( nci2 = nodeChain2; nci2 < nodeChain2 + numCollected2; nci2++ )
 		{
 			node2 = m_nodes[(*nci2).nodeID];
 			nodeNum2 = (*nci2).nodeID;
@@ -1542,11 +1907,11 @@ int CNavigator::GetNearestNode( sharedEntity_t *ent, int lastID, int flags, int
 
 /////////////////////////////////////////////////
 
-	nodeChain_l				nodeChain;
-	nodeChain_l::iterator	nci;
+	nodeList_t				nodeChain[NODE_COLLECT_MAX];
+	nodeList_t				*nci;
 
 	//Collect all nodes within a certain radius
-	CollectNearestNodes( ent->r.currentOrigin, NODE_COLLECT_RADIUS, NODE_COLLECT_MAX, nodeChain );
+	int	numCollected = CollectNearestNodes( ent->r.currentOrigin, NODE_COLLECT_RADIUS, NODE_COLLECT_MAX, nodeChain );
 
 	vec3_t				position;
 	int					radius;
@@ -1554,7 +1919,7 @@ int CNavigator::GetNearestNode( sharedEntity_t *ent, int lastID, int flags, int
 	CNode				*node;
 
 	//Look through all nodes
-	STL_ITERATE( nci, nodeChain )
+	for ( nci = nodeChain; nci < nodeChain + numCollected; nci++ )
 	{
 		node = m_nodes[(*nci).nodeID];
 
@@ -2182,7 +2547,6 @@ qboolean CNavigator::RouteBlocked( int startID, int testEdgeID, int endID, int r
 	int		bestRank = rejectRank;
 	int		testRank;
 	qboolean	allEdgesFailed;
-	CNode	*end;
 	CNode	*next;
 
 
@@ -2197,7 +2561,6 @@ qboolean CNavigator::RouteBlocked( int startID, int testEdgeID, int endID, int r
 	}
 
 	//Okay, first edge is clear, now check rest of route!
-	end	= m_nodes[ endID ];
 	nextID = testEdgeID;
 	lastID = startID;
 
@@ -2232,7 +2595,7 @@ qboolean CNavigator::RouteBlocked( int startID, int testEdgeID, int endID, int r
 			}
 
 			//Still going...
-			testRank = end->GetRank( edgeID );
+			testRank = GetRank( endID, edgeID );
 
 			if ( testRank < 0 )
 			{//No route this way
@@ -2397,7 +2760,6 @@ int CNavigator::GetBestNode( int startID, int endID, int rejectID )
 		return startID;
 
 	CNode	*start	= m_nodes[ startID ];
-	CNode	*end	= m_nodes[ endID ];
 
 	int		bestNode = -1;
 	int		bestRank = Q3_INFINITE;
@@ -2409,7 +2771,7 @@ int CNavigator::GetBestNode( int startID, int endID, int rejectID )
 		{
 			if ( start->GetEdge(i) == rejectID )
 			{
-				rejectRank = end->GetRank( start->GetEdge(i) );
+				rejectRank = GetRank( endID, start->GetEdge(i) );
 				break;
 			}
 		}
@@ -2423,7 +2785,7 @@ int CNavigator::GetBestNode( int startID, int endID, int rejectID )
 		if ( edgeID == endID )
 			return edgeID;
 
-		testRank = end->GetRank( edgeID );
+		testRank = GetRank( endID, edgeID );
 
 		//Found one
 		if ( testRank <= rejectRank )
@@ -2519,7 +2881,6 @@ bool CNavigator::Connected( int startID, int endID )
 		return true;
 
 	CNode	*start	= m_nodes[ startID ];
-	CNode	*end	= m_nodes[ endID ];
 
 	for ( int i = 0; i < start->GetNumEdges(); i++ )
 	{
@@ -2529,7 +2890,7 @@ bool CNavigator::Connected( int startID, int endID )
 		if ( edgeID == endID )
 			return true;
 
-		if ( ( end->GetRank( edgeID ) ) != NODE_NONE )
+		if ( ( GetRank( endID, edgeID ) ) != NODE_NONE )
 			return true;
 	}
 
@@ -2589,7 +2950,7 @@ unsigned int CNavigator::GetPathCost( int startID, int endID )
 				return pathCost + moveNode->GetEdgeCost( i );
 			}
 
-			testRank = endNode->GetRank( edgeID );
+			testRank = GetRank( endID, edgeID );
 
 			//No possible connection
 			if ( testRank == NODE_NONE )
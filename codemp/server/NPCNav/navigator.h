@@ -47,6 +47,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #define	NODE_NONE		-1
 #define	NAV_HEADER_ID	INT_ID('J','N','V','5')
 #define	NODE_HEADER_ID	INT_ID('N','O','D','E')
+#define	NAV_ROUTES_ID	INT_ID('J','N','V','R')
+#define	NAV_ROUTES_VERSION	1
 
 typedef std::multimap<int, int> EdgeMultimap;
 typedef EdgeMultimap::iterator EdgeMultimapIt;
@@ -98,7 +100,6 @@ public:
 	static CNode *Create( void );
 
 	void AddEdge( int ID, int cost, int flags = EFLAG_NONE );
-	void AddRank( int ID, int rank );
 
 	void Draw( qboolean radius );
 
@@ -113,15 +114,12 @@ public:
 	void SetEdgeFlags( int edgeNum, int newFlags );
 	int	GetRadius( void )				const	{	return m_radius;	}
 
-	void InitRanks( int size );
-	int GetRank( int ID );
-
 	int	GetFlags( void )				const	{	return m_flags;	}
 	void AddFlag( int newFlag )			{	m_flags |= newFlag;	}
 	void RemoveFlag( int oldFlag )		{	m_flags &= ~oldFlag; }
 
-	int	Save( int numNodes, fileHandle_t file );
-	int Load( int numNodes, fileHandle_t file );
+	int	Save( fileHandle_t file );
+	int Load( fileHandle_t file );
 
 protected:
 
@@ -132,7 +130,6 @@ protected:
 
 	edge_v	m_edges;
 
-	int		*m_ranks;
 	int		m_numEdges;
 };
 
@@ -155,10 +152,29 @@ class CNavigator
 		unsigned int	distance;
 	};
 
-	typedef std::list < nodeList_t >		nodeChain_l;
-
 #endif	//__NEWCOLLECT
 
+	// node position in the lookup grid
+	struct gridNode_t
+	{
+		int				nodeID;
+		vec3_t			position;
+	};
+
+	// scratch space of one route search, kept over all the sources a
+	// job works through
+	struct routeEntry_t
+	{
+		int		nodeID;
+		int		cost;
+	};
+
+	struct routeScratch_t
+	{
+		std::vector < routeEntry_t >	heap;
+		std::vector < byte >			checked;
+	};
+
 public:
 
 	CNavigator( void );
@@ -223,6 +239,9 @@ public:
 
 	void FlagAllNodes( int newFlag );
 
+	void StoreCombatPoints( const navCombatPoint_t *points, int numPoints );
+	qboolean RestoreCombatPoints( navCombatPoint_t *points, int numPoints );
+
 	qboolean pathsCalculated;
 //MCG Added END
 
@@ -233,7 +252,7 @@ protected:
 	int		TestBestFirst( sharedEntity_t *ent, int lastID, int flags );
 
 #if __NEWCOLLECT
-	int		CollectNearestNodes( vec3_t origin, int radius, int maxCollect, nodeChain_l &nodeChain );
+	int		CollectNearestNodes( vec3_t origin, int radius, int maxCollect, nodeList_t *nodeChain );
 #else
 	int		CollectNearestNodes( vec3_t origin, int radius, int maxCollect, int *nodeChain );
 #endif	//__NEWCOLLECT
@@ -249,6 +268,32 @@ protected:
 
 	void	CalculatePath( CNode *node );
 
+	void	BuildNodeGrid( void );
+
+	void	InitRanks( int size );
+	void	ResizeRanks( int size );
+	void	FreeRanks( void );
+	void	BuildRouteGraph( void );
+	void	CalculateRanks( int nodeID, routeScratch_t &scratch );
+	static void CalculatePathsJob( void *data, int index );
+
+	// rank of node ID in the route search from nodeID, NODE_NONE if it
+	// can't be reached
+	int		GetRank( int nodeID, int ID ) const
+	{
+		size_t	index = (size_t)nodeID * m_numRanks + ID;
+		return m_ranks16 ? (int)m_ranks16[index] - 1 : m_ranks[index];
+	}
+
+	void	SetRank( int nodeID, int ID, int rank )
+	{
+		size_t	index = (size_t)nodeID * m_numRanks + ID;
+		if ( m_ranks16 )
+			m_ranks16[index] = (unsigned short)( rank + 1 );
+		else
+			m_ranks[index] = rank;
+	}
+
 	//rww - made failedEdges private as it doesn't seem to need to be public.
 	//And I'd rather shoot myself than have to devise a way of setting/accessing this
 	//array via trap calls.
@@ -256,6 +301,34 @@ protected:
 
 	node_v			m_nodes;
 	EdgeMultimap	m_edgeLookupMap;
+
+	// one row per source node, 16 bit ranks (stored + 1) while the
+	// node count allows it
+	int				m_numRanks;
+	int				*m_ranks;
+	unsigned short	*m_ranks16;
+
+	// edges of all nodes in one array, node i owns the edges from
+	// m_routeEdgeStart[i] up to m_routeEdgeStart[i+1]. Cost changes are
+	// written through, new edges or nodes rebuild it on the next search.
+	std::vector < int >	m_routeEdgeStart;
+	std::vector < int >	m_routeEdgeNode;
+	std::vector < int >	m_routeEdgeCost;
+	bool				m_routeGraphValid;
+	int				m_routeJobs;
+
+	// nodes bucketed by their xy cell, cell i owns the entries from
+	// m_gridCellStart[i] up to m_gridCellStart[i+1]. Built by the first
+	// lookup after nodes were added.
+	bool				m_gridValid;
+	float				m_gridMins[2];
+	float				m_gridCellSize;
+	int					m_gridSize[2];
+	std::vector < int >			m_gridCellStart;
+	std::vector < gridNode_t >	m_gridNodes;
+
+	// combat point waypoints of the game, saved after the routes
+	std::vector < navCombatPoint_t >	m_combatPoints;
 };
 
 //////////////////////////////////////////////////////////////////////
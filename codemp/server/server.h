@@ -36,16 +36,26 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #define	MAX_ENT_CLUSTERS	16
 
+// links an entity into the per-cluster lists used to cull snapshot entities
+typedef struct svClusterLink_s {
+	struct svEntity_s		*ent;
+	int						cluster;
+	struct svClusterLink_s	*prev, *next;
+} svClusterLink_t;
+
 typedef struct svEntity_s {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	struct worldNode_s *worldNode;		// leaf in the world tree with sv_worldTree, see sv_world.cpp
 
 	entityState_t	baseline;		// for delta compression of initial sighting
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
+
+	svClusterLink_t	clusterLinks[MAX_ENT_CLUSTERS];	// one per distinct entry in clusternums
+	int			numClusterLinks;
 } svEntity_t;
 
 typedef enum {
@@ -60,7 +70,6 @@ typedef struct server_s {
 	int				serverId;			// changes each server start
 	int				restartedServerId;	// serverId before a map_restart
 	int				checksumFeed;		//
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	char			*configstrings[MAX_CONFIGSTRINGS];
@@ -120,13 +129,19 @@ typedef enum {
 } clientState_t;
 
 
+typedef struct demoWriter_s demoWriter_t;	// see sv_demowrite.cpp
+
 // struct to hold demo data for a single demo
 typedef struct {
 	char		demoName[MAX_OSPATH];
 	qboolean	demorecording;
 	qboolean	demowaiting;	// don't record until a non-delta message is sent
 	int			minDeltaFrame;	// the first non-delta frame stored in the demo.  cannot delta against frames older than this
-	fileHandle_t	demofile;
+	demoWriter_t	*writer;
+	qboolean	compressed;		// sv_demoCompress container with keyframes
+	int			startTime;		// svs.time the recording started
+	int			keyframeTime;	// svs.time of the last keyframe
+	int			keyframeSequence;	// first message after the last keyframe, 0 once the client deltas past it
 	qboolean	isBot;
 	int			botReliableAcknowledge; // for bots, need to maintain a separate reliableAcknowledge to record server messages into the demo file
 } demoInfo_t;
@@ -258,6 +273,11 @@ extern	cvar_t	*sv_maxRate;
 extern	cvar_t	*sv_minPing;
 extern	cvar_t	*sv_maxPing;
 extern	cvar_t	*sv_gametype;
+extern	cvar_t	*sv_jediVmerc;
+extern	cvar_t	*sv_weaponDisable;
+extern	cvar_t	*sv_duelWeaponDisable;
+extern	cvar_t	*sv_forcePowerDisable;
+extern	cvar_t	*sv_singlePlayerActive;
 extern	cvar_t	*sv_pure;
 extern	cvar_t	*sv_floodProtect;
 extern	cvar_t	*sv_lanForceRate;
@@ -268,6 +288,16 @@ extern	cvar_t	*sv_autoDemoBots;
 extern	cvar_t	*sv_autoDemoMaxMaps;
 extern	cvar_t	*sv_legacyFixForceSelect;
 extern	cvar_t	*sv_banFile;
+extern	cvar_t	*sv_snapshotJobs;
+extern	cvar_t	*sv_deltaEntityCache;
+extern	cvar_t	*sv_demoWriteBuffer;
+extern	cvar_t	*sv_demoCompress;
+extern	cvar_t	*sv_demoKeyframeInterval;
+extern	cvar_t	*sv_profile;
+extern	cvar_t	*sv_profileHitch;
+extern	cvar_t	*sv_worldTree;
+extern	cvar_t	*sv_rateLimitSubnet;
+extern	cvar_t	*sv_ghoul2Prepass;
 
 extern	serverBan_t serverBans[SERVER_MAXBANS];
 extern	int serverBansCount;
@@ -277,21 +307,10 @@ extern	int serverBansCount;
 //
 // sv_main.c
 //
-typedef struct leakyBucket_s leakyBucket_t;
-struct leakyBucket_s {
-	netadrtype_t	type;
-
-	union {
-		byte	_4[4];
-	} ipv;
-
+typedef struct leakyBucket_s {
 	int					lastTime;
 	signed char			burst;
-
-	long				hash;
-
-	leakyBucket_t *prev, *next;
-};
+} leakyBucket_t;
 
 extern leakyBucket_t outboundLeakyBucket;
 
@@ -299,6 +318,7 @@ qboolean SVC_RateLimit( leakyBucket_t *bucket, int burst, int period );
 qboolean SVC_RateLimitAddress( netadr_t from, int burst, int period );
 void SV_FinalMessage (char *message);
 void QDECL SV_SendServerCommand( client_t *cl, const char *fmt, ...);
+int SV_PingTime( void );
 
 
 void SV_AddOperatorCommands (void);
@@ -363,6 +383,39 @@ void SV_AutoRecordDemo( client_t *cl );
 void SV_StopAutoRecordDemos();
 void SV_BeginAutoRecordDemos();
 
+//
+// sv_demowrite.cpp
+//
+demoWriter_t *SV_OpenDemoWriter( fileHandle_t file, qboolean compressed );
+qboolean SV_DemoWriterKeyframe( demoWriter_t *w, int time, const void *data, int len );
+qboolean SV_DemoWriterReserve( demoWriter_t *w, int len );
+void SV_DemoWrite( demoWriter_t *w, const void *data, int len );
+void SV_CloseDemoWriter( demoWriter_t *w );
+void SV_DemoWriterFrame( void );
+void SV_ShutdownDemoWriter( void );
+
+//
+// sv_profile.cpp
+//
+typedef enum {
+	PROF_FRAME,				// everything in SV_Frame
+	PROF_BOTS,
+	PROF_GAME,
+	PROF_SKELETONS,			// SV_EvaluateSkeletons
+	PROF_SNAPSHOTS,			// SV_SendClientMessages
+	PROF_SNAPSHOT_BUILD,
+	PROF_SNAPSHOT_ENCODE,
+	PROF_SNAPSHOT_SEND,
+	PROF_DEMOS,
+	PROF_PACKETS,			// SV_PacketEvent, between frames
+	PROF_NUM_PHASES
+} svProfilePhase_t;
+
+void SV_ProfileBegin( svProfilePhase_t phase );
+void SV_ProfileEnd( svProfilePhase_t phase );
+void SV_ProfileFrame( void );
+void SV_Profile_f( void );
+
 //
 // sv_snapshot.c
 //
@@ -426,6 +479,13 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_AreaBench_f( void );
+
+
+void SV_MarkClusterEntities( const byte *pvs, uint32_t *entityBits );
+// sets the bit for every entity linked into a cluster that is set in the
+// given PVS row.  Entities that only touch clusters past MAX_ENT_CLUSTERS
+// (lastCluster) are not guaranteed to be marked.
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -1524,35 +1524,93 @@ static void SV_KillServer_f( void ) {
 	SV_Shutdown( "killserver" );
 }
 
+// defined in sv_client.cpp
+extern void SV_CreateClientGameStateMessage( client_t *client, msg_t* msg );
+
+/*
+==================
+SV_WriteDemoGamestate
+
+Builds the gamestate message a demo starts with.
+==================
+*/
+static void SV_WriteDemoGamestate( client_t *cl, msg_t *msg ) {
+	// NOTE, MRE: all server->client messages now acknowledge
+	int tmp = cl->reliableSent;
+	SV_CreateClientGameStateMessage( cl, msg );
+	cl->reliableSent = tmp;
+
+	// finished writing the client packet
+	MSG_WriteByte( msg, svc_EOF );
+}
+
+/*
+==================
+SV_WriteDemoKeyframe
+
+Stores the current gamestate as a seek point.  The demo gets its own
+non-delta copy of the next snapshot so playback can start there, the
+player keeps getting the usual delta compressed ones.
+==================
+*/
+static qboolean SV_WriteDemoKeyframe( client_t *cl ) {
+	byte		bufData[8 + MAX_MSGLEN];
+	msg_t		msg;
+
+	MSG_Init( &msg, bufData + 8, MAX_MSGLEN );
+	SV_WriteDemoGamestate( cl, &msg );
+
+	// the same record as at the start of a demo
+	*(int *)bufData = LittleLong( cl->netchan.outgoingSequence );
+	*(int *)( bufData + 4 ) = LittleLong( msg.cursize );
+
+	cl->demo.keyframeTime = svs.time;
+	if ( !SV_DemoWriterKeyframe( cl->demo.writer, svs.time - cl->demo.startTime, bufData, 8 + msg.cursize ) ) {
+		return qfalse;
+	}
+
+	cl->demo.keyframeSequence = cl->netchan.outgoingSequence + 1;
+	return qtrue;
+}
+
 void SV_WriteDemoMessage ( client_t *cl, msg_t *msg, int headerBytes ) {
-	int		len, swlen;
+	int		len, header[2];
 
 	// write the packet sequence
 	len = cl->netchan.outgoingSequence;
-	swlen = LittleLong( len );
-	FS_Write( &swlen, 4, cl->demo.demofile );
+	header[0] = LittleLong( len );
 
 	// skip the packet sequencing information
 	len = msg->cursize - headerBytes;
-	swlen = LittleLong( len );
-	FS_Write( &swlen, 4, cl->demo.demofile );
-	FS_Write( msg->data + headerBytes, len, cl->demo.demofile );
+	header[1] = LittleLong( len );
+
+	if ( !SV_DemoWriterReserve( cl->demo.writer, sizeof( header ) + len ) ) {
+		Com_Printf( "WARNING: demo for client %d can't keep up with the disk\n", cl - svs.clients );
+		SV_StopRecordDemo( cl );
+		return;
+	}
+
+	SV_DemoWrite( cl->demo.writer, header, sizeof( header ) );
+	SV_DemoWrite( cl->demo.writer, msg->data + headerBytes, len );
+
+	if ( cl->demo.compressed && sv_demoKeyframeInterval->integer > 0
+		&& svs.time - cl->demo.keyframeTime >= sv_demoKeyframeInterval->integer * 1000 ) {
+		if ( !SV_WriteDemoKeyframe( cl ) ) {
+			Com_Printf( "WARNING: demo for client %d can't keep up with the disk\n", cl - svs.clients );
+			SV_StopRecordDemo( cl );
+		}
+	}
 }
 
 void SV_StopRecordDemo( client_t *cl ) {
-	int		len;
-
 	if ( !cl->demo.demorecording ) {
 		Com_Printf( "Client %d is not recording a demo.\n", cl - svs.clients );
 		return;
 	}
 
-	// finish up
-	len = -1;
-	FS_Write (&len, 4, cl->demo.demofile);
-	FS_Write (&len, 4, cl->demo.demofile);
-	FS_FCloseFile (cl->demo.demofile);
-	cl->demo.demofile = 0;
+	// finish up, the file is closed once the writer thread is done with it
+	SV_CloseDemoWriter( cl->demo.writer );
+	cl->demo.writer = NULL;
 	cl->demo.demorecording = qfalse;
 	Com_Printf ("Stopped demo for client %d.\n", cl - svs.clients);
 }
@@ -1616,14 +1674,13 @@ void SV_DemoFilename( char *buf, int bufSize ) {
 	Com_sprintf( buf, bufSize, "demo%s", timeStr );
 }
 
-// defined in sv_client.cpp
-extern void SV_CreateClientGameStateMessage( client_t *client, msg_t* msg );
-
 void SV_RecordDemo( client_t *cl, char *demoName ) {
 	char		name[MAX_OSPATH];
 	byte		bufData[MAX_MSGLEN];
 	msg_t		msg;
 	int			len;
+	fileHandle_t	file;
+	int			start = 0;
 
 	if ( cl->demo.demorecording ) {
 		Com_Printf( "Already recording.\n" );
@@ -1639,11 +1696,25 @@ void SV_RecordDemo( client_t *cl, char *demoName ) {
 	Q_strncpyz( cl->demo.demoName, demoName, sizeof( cl->demo.demoName ) );
 	Com_sprintf( name, sizeof( name ), "demos/%s.dm_%d", cl->demo.demoName, PROTOCOL_VERSION );
 	Com_Printf( "recording to %s.\n", name );
-	cl->demo.demofile = FS_FOpenFileWrite( name );
-	if ( !cl->demo.demofile ) {
+	if ( com_speeds->integer ) {
+		start = Sys_Milliseconds();
+	}
+	file = FS_FOpenFileWrite( name );
+	if ( com_speeds->integer ) {
+		time_demo += Sys_Milliseconds() - start;
+	}
+	if ( !file ) {
 		Com_Printf ("ERROR: couldn't open.\n");
 		return;
 	}
+	cl->demo.compressed = (qboolean)( sv_demoCompress->integer != 0 );
+	cl->demo.writer = SV_OpenDemoWriter( file, cl->demo.compressed );
+	if ( !cl->demo.writer ) {
+		// every writer is still flushing a stopped demo
+		Com_Printf( "WARNING: demo writers are busy with stopped demos, can't record client %d\n", (int)( cl - svs.clients ) );
+		FS_FCloseFile( file );
+		return;
+	}
 	cl->demo.demorecording = qtrue;
 
 	// don't start saving messages until a non-delta compressed message is received
@@ -1652,24 +1723,23 @@ void SV_RecordDemo( client_t *cl, char *demoName ) {
 	cl->demo.isBot = ( cl->netchan.remoteAddress.type == NA_BOT ) ? qtrue : qfalse;
 	cl->demo.botReliableAcknowledge = cl->reliableSent;
 
+	cl->demo.startTime = svs.time;
+	cl->demo.keyframeTime = svs.time;
+	cl->demo.keyframeSequence = 0;
+
 	// write out the gamestate message
 	MSG_Init( &msg, bufData, sizeof( bufData ) );
+	SV_WriteDemoGamestate( cl, &msg );
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	int tmp = cl->reliableSent;
-	SV_CreateClientGameStateMessage( cl, &msg );
-	cl->reliableSent = tmp;
-
-	// finished writing the client packet
-	MSG_WriteByte( &msg, svc_EOF );
+	// write it to the demo file, a new writer always has room for one message
+	SV_DemoWriterReserve( cl->demo.writer, 8 + msg.cursize );
 
-	// write it to the demo file
 	len = LittleLong( cl->netchan.outgoingSequence - 1 );
-	FS_Write( &len, 4, cl->demo.demofile );
+	SV_DemoWrite( cl->demo.writer, &len, 4 );
 
 	len = LittleLong( msg.cursize );
-	FS_Write( &len, 4, cl->demo.demofile );
-	FS_Write( msg.data, msg.cursize, cl->demo.demofile );
+	SV_DemoWrite( cl->demo.writer, &len, 4 );
+	SV_DemoWrite( cl->demo.writer, msg.data, msg.cursize );
 
 	// the rest of the demo file will be copied from net messages
 }
@@ -1943,6 +2013,7 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f, "Prints the userinfo for a given userid" );
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f, "Restart the current map" );
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("sv_areabench", SV_AreaBench_f, "Times entity area queries and traces in the world sectors against the world tree" );
 	Cmd_AddCommand ("map", SV_Map_f, "Load a new map with cheats disabled" );
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 	Cmd_AddCommand ("devmap", SV_Map_f, "Load a new map with cheats enabled" );
@@ -1959,6 +2030,7 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("weapontoggle", SV_WeaponToggle_f, "Toggle g_weaponDisable bits" );
 	Cmd_AddCommand ("svrecord", SV_Record_f, "Record a server-side demo" );
 	Cmd_AddCommand ("svstoprecord", SV_StopRecord_f, "Stop recording a server-side demo" );
+	Cmd_AddCommand ("svprofile", SV_Profile_f, "Prints server frame phase times, see sv_profile" );
 	Cmd_AddCommand ("sv_rehashbans", SV_RehashBans_f, "Reloads banlist from file" );
 	Cmd_AddCommand ("sv_listbans", SV_ListBans_f, "Lists bans" );
 	Cmd_AddCommand ("sv_banaddr", SV_BanAddr_f, "Bans a user" );
@@ -69,7 +69,7 @@ void SV_GetChallenge( netadr_t from ) {
 		return;
 	}
 	*/
-	if (Cvar_VariableValue("ui_singlePlayerActive"))
+	if (sv_singlePlayerActive->integer)
 	{
 		return;
 	}
@@ -1408,7 +1408,7 @@ static void SV_UserMove( client_t *cl, msg_t *msg, qboolean delta ) {
 	}
 
 	// save time for ping calculation
-	cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked = svs.time;
+	cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked = NET_PacketTime() ? NET_PacketTime() : SV_PingTime();
 
 	// TTimo
 	// catch the no-cp-yet situation before SV_ClientEnterWorld
@@ -0,0 +1,533 @@
+/*
+===========================================================================
+Copyright (C) 2013 - 2015, OpenJK contributors
+
+This file is part of the OpenJK source code.
+
+OpenJK is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+===========================================================================
+*/
+
+// sv_demowrite.cpp -- moves server side demo disk writes off the main thread
+//
+// Every demo gets two buffers.  The main thread appends messages to the
+// front one, SV_DemoWriterFrame hands it to the writer thread once that
+// thread is done with the other one, and the buffers swap.  Opening and
+// closing the files stays on the main thread, the writer thread only ever
+// calls fwrite and fflush.  If a demo fills both buffers before the disk
+// catches up it gets stopped instead of stalling the frame.
+//
+// With sv_demoCompress the writer thread also packs the stream into the
+// block container described in qcommon.h.  The main thread marks keyframes
+// in the stream with a DEMO_RECORD_KEYFRAME record, which is never written
+// to raw demos.
+
+#include "server.h"
+
+#ifdef USE_INTERNAL_ZLIB
+#include "zlib/zlib.h"
+#else
+#include <zlib.h>
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define MAX_DEMO_WRITERS		( MAX_CLIENTS * 2 )	// room for demos that are still being flushed
+#define DEMO_END_BYTES			8					// the -1 -1 that ends a demo always fits
+#define DEMO_RECORD_KEYFRAME	-2					// { -2, length, time, gamestate record }
+
+struct demoWriter_s {
+	qboolean		inUse;
+	fileHandle_t	file;
+	FILE			*fp;
+	byte			*buffers[2];
+	int				bufferSize;
+
+	// main thread only
+	int				front;			// buffer the main thread appends to
+	int				frontLen;
+
+	// shared, under demoWriterMutex
+	int				backLen;		// bytes in buffers[front ^ 1] the writer thread still has to write
+	qboolean		closing;		// no more data is coming
+	qboolean		writeError;
+
+	// container, writer thread only after SV_OpenDemoWriter
+	qboolean		compressed;
+	byte			*staging;		// unpacked messages of the current block
+	int				stagingLen;
+	byte			*packed;
+	int				*keyframes;		// { time, offset } pairs for the index
+	int				numKeyframes;
+	int				fileOffset;
+};
+
+static demoWriter_t				demoWriters[MAX_DEMO_WRITERS];
+
+static std::thread				demoWriterThread;
+static std::mutex				demoWriterMutex;
+static std::condition_variable	demoWriterWake;		// there is a back buffer to write
+static std::condition_variable	demoWriterIdle;		// a back buffer was written
+static bool						demoWriterQuit;
+
+/*
+==================
+SV_WriteDemoBlock
+
+Packs and writes one container block.  Writer thread.
+==================
+*/
+static qboolean SV_WriteDemoBlock( demoWriter_t *w, int type, const byte *data, int len, int time ) {
+	uLongf	packedLen = DEMO_BLOCK_PACKED_SIZE;
+	int		header[4];
+
+	if ( compress2( w->packed, &packedLen, data, len, Z_BEST_SPEED ) != Z_OK ) {
+		return qfalse;
+	}
+
+	header[0] = LittleLong( type );
+	header[1] = LittleLong( (int)packedLen );
+	header[2] = LittleLong( len );
+	header[3] = LittleLong( time );
+	if ( fwrite( header, 1, sizeof( header ), w->fp ) != sizeof( header )
+		|| fwrite( w->packed, 1, packedLen, w->fp ) != packedLen ) {
+		return qfalse;
+	}
+
+	w->fileOffset += sizeof( header ) + packedLen;
+	return qtrue;
+}
+
+static qboolean SV_FlushDemoBlock( demoWriter_t *w ) {
+	qboolean ok = qtrue;
+
+	if ( w->stagingLen ) {
+		ok = SV_WriteDemoBlock( w, DEMO_BLOCK_MESSAGES, w->staging, w->stagingLen, 0 );
+		w->stagingLen = 0;
+	}
+
+	return ok;
+}
+
+/*
+==================
+SV_PackDemoData
+
+Splits the records of a buffer into container blocks.  Records never
+straddle two buffers.  Writer thread.
+==================
+*/
+static qboolean SV_PackDemoData( demoWriter_t *w, const byte *data, int len ) {
+	int			ok = 1;
+	int			pos = 0;
+
+	if ( !w->fileOffset ) {
+		int header[2] = { LittleLong( DEMO_CONTAINER_MAGIC ), LittleLong( DEMO_CONTAINER_VERSION ) };
+
+		if ( fwrite( header, 1, sizeof( header ), w->fp ) != sizeof( header ) ) {
+			return qfalse;
+		}
+		w->fileOffset = sizeof( header );
+	}
+
+	while ( pos + 8 <= len ) {
+		int sequence = LittleLong( *(const int *)( data + pos ) );
+		int size = LittleLong( *(const int *)( data + pos + 4 ) );
+
+		if ( sequence == DEMO_RECORD_KEYFRAME ) {
+			int time = LittleLong( *(const int *)( data + pos + 8 ) );
+
+			ok &= SV_FlushDemoBlock( w );
+			if ( w->numKeyframes < DEMO_MAX_KEYFRAMES ) {
+				w->keyframes[w->numKeyframes * 2] = LittleLong( time );
+				w->keyframes[w->numKeyframes * 2 + 1] = LittleLong( w->fileOffset );
+				w->numKeyframes++;
+			}
+			ok &= SV_WriteDemoBlock( w, DEMO_BLOCK_KEYFRAME, data + pos + 12, size, time );
+			pos += 12 + size;
+			continue;
+		}
+
+		if ( sequence == -1 && size == -1 ) {
+			// end of the demo, the index goes last
+			int trailer[2];
+
+			Com_Memcpy( w->staging + w->stagingLen, data + pos, 8 );
+			w->stagingLen += 8;
+			ok &= SV_FlushDemoBlock( w );
+
+			trailer[0] = LittleLong( w->fileOffset );
+			trailer[1] = LittleLong( DEMO_INDEX_MAGIC );
+			ok &= SV_WriteDemoBlock( w, DEMO_BLOCK_INDEX, (const byte *)w->keyframes, w->numKeyframes * 8, 0 );
+			ok &= (qboolean)( fwrite( trailer, 1, sizeof( trailer ), w->fp ) == sizeof( trailer ) );
+			pos += 8;
+			continue;
+		}
+
+		if ( w->stagingLen + 8 + size > DEMO_BLOCK_SIZE - DEMO_END_BYTES ) {
+			ok &= SV_FlushDemoBlock( w );
+		}
+		Com_Memcpy( w->staging + w->stagingLen, data + pos, 8 + size );
+		w->stagingLen += 8 + size;
+		pos += 8 + size;
+	}
+
+	return (qboolean)ok;
+}
+
+/*
+==================
+SV_DemoWriterThread
+==================
+*/
+static void SV_DemoWriterThread( void ) {
+	std::unique_lock<std::mutex> lock( demoWriterMutex );
+
+	for ( ;; ) {
+		demoWriter_t	*w = NULL;
+
+		for ( int i = 0 ; i < MAX_DEMO_WRITERS ; i++ ) {
+			if ( demoWriters[i].backLen ) {
+				w = &demoWriters[i];
+				break;
+			}
+		}
+
+		if ( !w ) {
+			if ( demoWriterQuit ) {
+				return;
+			}
+			demoWriterWake.wait( lock );
+			continue;
+		}
+
+		// the main thread doesn't touch the back buffer while backLen is set
+		const byte	*data = w->buffers[w->front ^ 1];
+		int			len = w->backLen;
+		FILE		*fp = w->fp;
+		qboolean	flush = w->closing;
+
+		lock.unlock();
+		qboolean failed;
+		if ( w->compressed ) {
+			failed = (qboolean)!SV_PackDemoData( w, data, len );
+		} else {
+			failed = (qboolean)( fwrite( data, 1, len, fp ) != (size_t)len );
+		}
+		if ( flush ) {
+			fflush( fp );
+		}
+		lock.lock();
+
+		if ( failed ) {
+			w->writeError = qtrue;
+		}
+		w->backLen = 0;
+		demoWriterIdle.notify_all();
+	}
+}
+
+/*
+==================
+SV_SubmitDemoBuffer
+
+Hands the front buffer to the writer thread if it is done with the other one.
+Called with demoWriterMutex held.
+==================
+*/
+static qboolean SV_SubmitDemoBuffer( demoWriter_t *w ) {
+	if ( !w->frontLen ) {
+		return qtrue;
+	}
+	if ( w->backLen ) {
+		return qfalse;
+	}
+
+	w->backLen = w->frontLen;
+	w->front ^= 1;
+	w->frontLen = 0;
+	demoWriterWake.notify_one();
+
+	return qtrue;
+}
+
+/*
+==================
+SV_ReleaseDemoWriter
+
+Closes the file of a writer that has nothing left to write.
+==================
+*/
+static void SV_ReleaseDemoWriter( demoWriter_t *w ) {
+	if ( w->writeError ) {
+		Com_Printf( "WARNING: write errors while recording a demo, it is incomplete\n" );
+	}
+
+	FS_FCloseFile( w->file );
+	Z_Free( w->buffers[0] );
+	Z_Free( w->buffers[1] );
+	if ( w->compressed ) {
+		Z_Free( w->staging );
+		Z_Free( w->packed );
+		Z_Free( w->keyframes );
+	}
+
+	std::lock_guard<std::mutex> lock( demoWriterMutex );
+	Com_Memset( w, 0, sizeof( *w ) );
+}
+
+/*
+==================
+SV_DemoWriterFrame
+
+Starts writing what the demos collected this frame and closes the
+files of stopped demos that are fully written.
+==================
+*/
+void SV_DemoWriterFrame( void ) {
+	int				i, start = 0;
+	demoWriter_t	*w;
+
+	if ( !demoWriterThread.joinable() ) {
+		return;
+	}
+
+	if ( com_speeds->integer ) {
+		start = Sys_Milliseconds();
+	}
+
+	for ( i = 0, w = demoWriters ; i < MAX_DEMO_WRITERS ; i++, w++ ) {
+		qboolean finished;
+
+		if ( !w->inUse ) {
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( demoWriterMutex );
+			SV_SubmitDemoBuffer( w );
+			finished = (qboolean)( w->closing && !w->frontLen && !w->backLen );
+		}
+
+		if ( finished ) {
+			SV_ReleaseDemoWriter( w );
+		}
+	}
+
+	if ( com_speeds->integer ) {
+		time_demo += Sys_Milliseconds() - start;
+	}
+}
+
+/*
+==================
+SV_FlushDemoWriters
+
+Blocks until every demo is on disk and closes the stopped ones.
+==================
+*/
+static void SV_FlushDemoWriters( void ) {
+	int		i;
+
+	for ( i = 0 ; i < MAX_DEMO_WRITERS ; i++ ) {
+		demoWriter_t *w = &demoWriters[i];
+
+		if ( !w->inUse ) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( demoWriterMutex );
+		while ( w->frontLen || w->backLen ) {
+			SV_SubmitDemoBuffer( w );
+			demoWriterIdle.wait( lock, [w] { return !w->backLen; } );
+		}
+		qboolean finished = w->closing;
+		lock.unlock();
+
+		if ( finished ) {
+			SV_ReleaseDemoWriter( w );
+		}
+	}
+}
+
+/*
+==================
+SV_OpenDemoWriter
+
+Takes over a file opened for writing.  Returns NULL if no writer is free,
+without waiting for the stopped demos to reach the disk.
+==================
+*/
+demoWriter_t *SV_OpenDemoWriter( fileHandle_t file, qboolean compressed ) {
+	demoWriter_t	*w = NULL;
+	int				i;
+
+	if ( !demoWriterThread.joinable() ) {
+		demoWriterQuit = false;
+		demoWriterThread = std::thread( SV_DemoWriterThread );
+	}
+
+	for ( i = 0 ; i < MAX_DEMO_WRITERS ; i++ ) {
+		if ( !demoWriters[i].inUse ) {
+			w = &demoWriters[i];
+			break;
+		}
+	}
+
+	if ( !w ) {
+		return NULL;
+	}
+
+	int bufferSize = Com_Clampi( 2 * ( MAX_MSGLEN + 8 ), 64 * 1024 * 1024, sv_demoWriteBuffer->integer * 1024 );
+	byte *front = (byte *)Z_Malloc( bufferSize, TAG_GENERAL, qfalse );
+	byte *back = (byte *)Z_Malloc( bufferSize, TAG_GENERAL, qfalse );
+
+	std::lock_guard<std::mutex> lock( demoWriterMutex );
+	w->compressed = compressed;
+	if ( compressed ) {
+		w->staging = (byte *)Z_Malloc( DEMO_BLOCK_SIZE, TAG_GENERAL, qfalse );
+		w->packed = (byte *)Z_Malloc( DEMO_BLOCK_PACKED_SIZE, TAG_GENERAL, qfalse );
+		w->keyframes = (int *)Z_Malloc( DEMO_MAX_KEYFRAMES * 8, TAG_GENERAL, qfalse );
+	}
+	w->stagingLen = 0;
+	w->numKeyframes = 0;
+	w->fileOffset = 0;
+	w->bufferSize = bufferSize;
+	w->buffers[0] = front;
+	w->buffers[1] = back;
+	w->file = file;
+	w->fp = FS_FileForHandle( file );
+	w->front = 0;
+	w->frontLen = 0;
+	w->backLen = 0;
+	w->closing = qfalse;
+	w->writeError = qfalse;
+	w->inUse = qtrue;
+
+	return w;
+}
+
+/*
+==================
+SV_DemoWriterReserve
+
+Makes room for len bytes of SV_DemoWrite calls.  Returns qfalse if the
+writer fell so far behind that they don't fit, the demo should be
+stopped then.
+==================
+*/
+qboolean SV_DemoWriterReserve( demoWriter_t *w, int len ) {
+	if ( w->frontLen + len > w->bufferSize - DEMO_END_BYTES ) {
+		std::lock_guard<std::mutex> lock( demoWriterMutex );
+
+		if ( !SV_SubmitDemoBuffer( w ) || len > w->bufferSize - DEMO_END_BYTES ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+SV_DemoWrite
+
+Queues data reserved with SV_DemoWriterReserve for the demo file.
+==================
+*/
+void SV_DemoWrite( demoWriter_t *w, const void *data, int len ) {
+	assert( w->frontLen + len <= w->bufferSize - DEMO_END_BYTES );
+
+	Com_Memcpy( w->buffers[w->front] + w->frontLen, data, len );
+	w->frontLen += len;
+}
+
+/*
+==================
+SV_DemoWriterKeyframe
+
+Stores a gamestate record that playback can start from.  The next
+message written must be a non-delta snapshot.  Only compressed demos
+keep keyframes.
+==================
+*/
+qboolean SV_DemoWriterKeyframe( demoWriter_t *w, int time, const void *data, int len ) {
+	int header[3];
+
+	if ( !w->compressed ) {
+		return qtrue;
+	}
+
+	if ( len > DEMO_BLOCK_SIZE || !SV_DemoWriterReserve( w, sizeof( header ) + len ) ) {
+		return qfalse;
+	}
+
+	header[0] = LittleLong( DEMO_RECORD_KEYFRAME );
+	header[1] = LittleLong( len );
+	header[2] = LittleLong( time );
+	SV_DemoWrite( w, header, sizeof( header ) );
+	SV_DemoWrite( w, data, len );
+
+	return qtrue;
+}
+
+/*
+==================
+SV_CloseDemoWriter
+
+Ends the demo.  The file is closed by SV_DemoWriterFrame once it is written.
+==================
+*/
+void SV_CloseDemoWriter( demoWriter_t *w ) {
+	int len = -1;
+
+	// the end marker always has room reserved
+	Com_Memcpy( w->buffers[w->front] + w->frontLen, &len, 4 );
+	Com_Memcpy( w->buffers[w->front] + w->frontLen + 4, &len, 4 );
+	w->frontLen += DEMO_END_BYTES;
+
+	std::lock_guard<std::mutex> lock( demoWriterMutex );
+	w->closing = qtrue;
+	SV_SubmitDemoBuffer( w );
+}
+
+/*
+==================
+SV_ShutdownDemoWriter
+
+Writes out everything that is still queued and stops the writer thread.
+==================
+*/
+void SV_ShutdownDemoWriter( void ) {
+	if ( !demoWriterThread.joinable() ) {
+		return;
+	}
+
+	SV_FlushDemoWriters();
+
+	// a demo that is still recording keeps the thread
+	for ( int i = 0 ; i < MAX_DEMO_WRITERS ; i++ ) {
+		if ( demoWriters[i].inUse ) {
+			return;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( demoWriterMutex );
+		demoWriterQuit = true;
+	}
+	demoWriterWake.notify_all();
+	demoWriterThread.join();
+}
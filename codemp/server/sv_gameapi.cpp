@@ -895,6 +895,14 @@ static void SV_Nav_SetPathsCalculated( qboolean newVal ) {
 	navigator.pathsCalculated = newVal;
 }
 
+static void SV_Nav_StoreCombatPoints( const navCombatPoint_t *points, int numPoints ) {
+	navigator.StoreCombatPoints( points, numPoints );
+}
+
+static qboolean SV_Nav_RestoreCombatPoints( navCombatPoint_t *points, int numPoints ) {
+	return navigator.RestoreCombatPoints( points, numPoints );
+}
+
 static int SV_BotLoadCharacter( char *charfile, float skill ) {
 	return botlib_export->ai.BotLoadCharacter( charfile, skill );
 }
@@ -2879,6 +2887,11 @@ void SV_InitGame( qboolean restart ) {
 	GVM_InitGame( sv.time, Com_Milliseconds(), restart );
 }
 
+// swallows the version mismatch an older game module prints when it is
+// offered the current GAME_API_VERSION
+static void QDECL SV_ProbePrint( const char *msg, ... ) {
+}
+
 void SV_BindGame( void ) {
 	static gameImport_t gi;
 	gameExport_t		*ret;
@@ -3004,6 +3017,9 @@ void SV_BindGame( void ) {
 		gi.Nav_FlagAllNodes						= SV_Nav_FlagAllNodes;
 		gi.Nav_GetPathsCalculated				= SV_Nav_GetPathsCalculated;
 		gi.Nav_SetPathsCalculated				= SV_Nav_SetPathsCalculated;
+		gi.Nav_StoreCombatPoints				= SV_Nav_StoreCombatPoints;
+		gi.Nav_RestoreCombatPoints				= SV_Nav_RestoreCombatPoints;
+		gi.Cvar_Changes							= Cvar_Changes;
 		gi.BotAllocateClient					= SV_BotAllocateClient;
 		gi.BotFreeClient						= SV_BotFreeClient;
 		gi.BotLoadCharacter						= SV_BotLoadCharacter;
@@ -3200,7 +3216,19 @@ void SV_BindGame( void ) {
 		gi.G2API_GetSurfaceName					= SV_G2API_GetSurfaceName;
 
 		GetGameAPI = (GetGameAPI_t)gvm->GetModuleAPI;
+		gi.Print = SV_ProbePrint;
 		ret = GetGameAPI( GAME_API_VERSION, &gi );
+		gi.Print = Com_Printf;
+		if ( ret ) {
+			// again, the module keeps the print it was handed
+			ret = GetGameAPI( GAME_API_VERSION, &gi );
+		} else {
+			// game modules from before version 2 don't know the newer imports
+			ret = GetGameAPI( GAME_API_VERSION_MIN, &gi );
+			if ( ret ) {
+				Com_Printf( "%s uses the older GAME_API_VERSION %i\n", dllName, GAME_API_VERSION_MIN );
+			}
+		}
 		if ( !ret ) {
 			//free VM?
 			svs.gameStarted = qfalse;
@@ -465,6 +465,16 @@ void SV_SpawnServer( char *server, qboolean killBots, ForceReload_e eForceReload
 	SV_ShutdownGameProgs();
 	svs.gameStarted = qfalse;
 
+	// finish the demos that are still recording and get them all on disk
+	if ( svs.clients ) {
+		for ( int i = 0; i < sv_maxclients->integer; i++ ) {
+			if ( svs.clients[i].demo.demorecording ) {
+				SV_StopRecordDemo( &svs.clients[i] );
+			}
+		}
+	}
+	SV_ShutdownDemoWriter();
+
 	Com_Printf ("------ Server Initialization ------\n");
 	Com_Printf ("Server: %s\n",server);
 
@@ -771,7 +781,10 @@ void SV_BotInitBotLib(void);
 
 #ifdef DEDICATED
 
-#define G2_VERT_SPACE_SERVER_SIZE 256
+// rd-dedicated pads the skinned verts of a surface to a multiple of four,
+// aligns them and keeps the triangle BVH bounds after them, which is about
+// 2.2 times the space of the plain verts the old 256k were sized for
+#define G2_VERT_SPACE_SERVER_SIZE 640
 IHeapAllocator *G2VertSpaceServer = NULL;
 CMiniHeap IHeapAllocator_singleton(G2_VERT_SPACE_SERVER_SIZE * 1024);
 
@@ -940,10 +953,16 @@ void SV_Init (void) {
 	Cvar_Get ("g_maxForceRank", "7", CVAR_SERVERINFO );
 	Cvar_Get ("duel_fraglimit", "10", CVAR_SERVERINFO);
 	Cvar_Get ("g_forceBasedTeams", "0", CVAR_SERVERINFO);
-	Cvar_Get ("g_duelWeaponDisable", "1", CVAR_SERVERINFO);
 
 	sv_gametype = Cvar_Get ("g_gametype", "0", CVAR_SERVERINFO | CVAR_LATCH, "Server gametype value" );
 	sv_needpass = Cvar_Get ("g_needpass", "0", CVAR_SERVERINFO | CVAR_ROM, "Server needs password to join" );
+	// game cvars read for every getinfo, so they don't need a lookup by name.
+	// The game module registers them with its own flags.
+	sv_jediVmerc = Cvar_Get ("g_jediVmerc", "0", 0);
+	sv_weaponDisable = Cvar_Get ("g_weaponDisable", "0", 0);
+	sv_duelWeaponDisable = Cvar_Get ("g_duelWeaponDisable", "1", CVAR_SERVERINFO);
+	sv_forcePowerDisable = Cvar_Get ("g_forcePowerDisable", "0", 0);
+	sv_singlePlayerActive = Cvar_Get ("ui_singlePlayerActive", "0", CVAR_INTERNAL);
 	Cvar_Get ("sv_keywords", "", CVAR_SERVERINFO);
 	Cvar_Get ("protocol", va("%i", PROTOCOL_VERSION), CVAR_SERVERINFO | CVAR_ROM);
 	sv_mapname = Cvar_Get ("mapname", "nomap", CVAR_SERVERINFO | CVAR_ROM);
@@ -999,6 +1018,17 @@ void SV_Init (void) {
 
 	sv_banFile = Cvar_Get( "sv_banFile", "serverbans.dat", CVAR_ARCHIVE, "File to use to store bans and exceptions" );
 
+	sv_snapshotJobs = Cvar_Get( "sv_snapshotJobs", "0", CVAR_ARCHIVE, "Build and encode client snapshots on the job worker threads" );
+	sv_deltaEntityCache = Cvar_Get( "sv_deltaEntityCache", "1", CVAR_ARCHIVE, "Reuse encoded entity deltas between clients that delta from the same state" );
+	sv_demoWriteBuffer = Cvar_Get( "sv_demoWriteBuffer", "256", CVAR_ARCHIVE, "Size in KB of each of the two buffers a server side demo is written through" );
+	sv_demoCompress = Cvar_Get( "sv_demoCompress", "0", CVAR_ARCHIVE, "Record server side demos in the compressed, seekable container" );
+	sv_demoKeyframeInterval = Cvar_Get( "sv_demoKeyframeInterval", "10", CVAR_ARCHIVE, "Seconds between seek points in compressed server side demos, 0 = no seek points" );
+	sv_profile = Cvar_Get( "sv_profile", "0", CVAR_ARCHIVE, "Time the phases of every server frame, see svprofile" );
+	sv_profileHitch = Cvar_Get( "sv_profileHitch", "50", CVAR_ARCHIVE, "With sv_profile on, print the phase times of frames slower than this many msec, 0 = off" );
+	sv_worldTree = Cvar_Get( "sv_worldTree", "0", CVAR_ARCHIVE, "Keep entities in a dynamic bounding volume tree instead of the fixed world sectors, from the next map on. Area queries return entities in a different order, which can change trace tie breaks" );
+	sv_rateLimitSubnet = Cvar_Get( "sv_rateLimitSubnet", "8", CVAR_ARCHIVE, "A /24 subnet may send this many times the connectionless requests of a single address, 0 = no subnet limit" );
+	sv_ghoul2Prepass = Cvar_Get( "sv_ghoul2Prepass", "0", CVAR_ARCHIVE, "Transform the bones of all linked ghoul2 entities on the job workers after every game frame" );
+
 	// initialize bot cvars so they are listed and can be set before loading the botlib
 	SV_BotInitCvars();
 
@@ -27,6 +27,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "ghoul2/ghoul2_shared.h"
 #include "sv_gameapi.h"
 
+#include <algorithm>
+
 serverStatic_t	svs;				// persistant server info
 server_t		sv;					// local server
 
@@ -54,6 +56,11 @@ cvar_t	*sv_maxRate;
 cvar_t	*sv_minPing;
 cvar_t	*sv_maxPing;
 cvar_t	*sv_gametype;
+cvar_t	*sv_jediVmerc;
+cvar_t	*sv_weaponDisable;
+cvar_t	*sv_duelWeaponDisable;
+cvar_t	*sv_forcePowerDisable;
+cvar_t	*sv_singlePlayerActive;
 cvar_t	*sv_pure;
 cvar_t	*sv_floodProtect;
 cvar_t	*sv_lanForceRate; // dedicated 1 (LAN) server forces local client rates to 99999 (bug #491)
@@ -64,6 +71,16 @@ cvar_t	*sv_autoDemoBots;
 cvar_t	*sv_autoDemoMaxMaps;
 cvar_t	*sv_legacyFixForceSelect;
 cvar_t	*sv_banFile;
+cvar_t	*sv_snapshotJobs;
+cvar_t	*sv_deltaEntityCache;
+cvar_t	*sv_demoWriteBuffer;
+cvar_t	*sv_demoCompress;
+cvar_t	*sv_demoKeyframeInterval;
+cvar_t	*sv_profile;
+cvar_t	*sv_profileHitch;
+cvar_t	*sv_worldTree;
+cvar_t	*sv_rateLimitSubnet;
+cvar_t	*sv_ghoul2Prepass;
 
 serverBan_t serverBans[SERVER_MAXBANS];
 int serverBansCount = 0;
@@ -305,112 +322,82 @@ CONNECTIONLESS COMMANDS
 */
 
 // This is deliberately quite large to make it more of an effort to DoS
-#define MAX_BUCKETS			16384
-#define MAX_HASHES			1024
-
-static leakyBucket_t buckets[ MAX_BUCKETS ];
-static leakyBucket_t *bucketHashes[ MAX_HASHES ];
+#define MAX_BUCKETS			32768		// must be a power of two
+#define BUCKET_PROBES		16			// slots searched from the hash, the oldest one is reused if all are taken
+
+// open addressed, buckets are never emptied again, only reused in place
+typedef struct bucketSlot_s {
+	uint32_t		key;		// address, or the /24 subnet with the host byte cleared
+	byte			type;		// netadrtype_t, NA_BAD if the slot was never used
+	byte			subnet;
+	leakyBucket_t	bucket;
+} bucketSlot_t;
+
+static bucketSlot_t buckets[ MAX_BUCKETS ];
 leakyBucket_t outboundLeakyBucket;
 
 /*
 ================
-SVC_HashForAddress
+SVC_HashForKey
 ================
 */
-static long SVC_HashForAddress( netadr_t address ) {
-	byte 		*ip = NULL;
-	size_t	size = 0;
-	long		hash = 0;
-
-	switch ( address.type ) {
-		case NA_IP:  ip = address.ip;  size = 4; break;
-		default: break;
-	}
+static int SVC_HashForKey( uint32_t key, qboolean subnet ) {
+	uint32_t	hash = ( key ^ ( subnet ? 0x5bd1e995u : 0 ) ) * 0x9e3779b1u;
 
-	for ( size_t i = 0; i < size; i++ ) {
-		hash += (long)( ip[ i ] ) * ( i + 119 );
-	}
-
-	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
-	hash &= ( MAX_HASHES - 1 );
-
-	return hash;
+	return ( hash ^ ( hash >> 15 ) ) & ( MAX_BUCKETS - 1 );
 }
 
 /*
 ================
-SVC_BucketForAddress
+SVC_BucketForKey
 
-Find or allocate a bucket for an address
+Find or allocate the bucket of an address or subnet. Drained buckets are
+reused first, then the least recently used one in the probe range, so new
+addresses always get a bucket and a flood can't lock others out.
 ================
 */
-static leakyBucket_t *SVC_BucketForAddress( netadr_t address, int burst, int period ) {
-	leakyBucket_t	*bucket = NULL;
-	int						i;
-	long					hash = SVC_HashForAddress( address );
-	int						now = Sys_Milliseconds();
-
-	for ( bucket = bucketHashes[ hash ]; bucket; bucket = bucket->next ) {
-		switch ( bucket->type ) {
-			case NA_IP:
-				if ( memcmp( bucket->ipv._4, address.ip, 4 ) == 0 ) {
-					return bucket;
-				}
-				break;
-
-			default:
-				break;
-		}
-	}
-
-	for ( i = 0; i < MAX_BUCKETS; i++ ) {
-		int interval;
-
-		bucket = &buckets[ i ];
-		interval = now - bucket->lastTime;
-
-		// Reclaim expired buckets
-		if ( bucket->lastTime > 0 && ( interval > ( burst * period ) ||
-					interval < 0 ) ) {
-			if ( bucket->prev != NULL ) {
-				bucket->prev->next = bucket->next;
-			} else {
-				bucketHashes[ bucket->hash ] = bucket->next;
+static leakyBucket_t *SVC_BucketForKey( uint32_t key, qboolean subnet, int burst, int period ) {
+	bucketSlot_t	*slot, *reuse = NULL;
+	qboolean		reuseExpired = qfalse;
+	int				hash = SVC_HashForKey( key, subnet );
+	int				now = Sys_Milliseconds();
+	int				i;
+
+	for ( i = 0; i < BUCKET_PROBES; i++ ) {
+		int			interval;
+		qboolean	expired;
+
+		slot = &buckets[ ( hash + i ) & ( MAX_BUCKETS - 1 ) ];
+
+		if ( slot->type == NA_BAD ) {
+			// nothing was ever stored past this one
+			if ( !reuseExpired ) {
+				reuse = slot;
 			}
-
-			if ( bucket->next != NULL ) {
-				bucket->next->prev = bucket->prev;
-			}
-
-			Com_Memset( bucket, 0, sizeof( leakyBucket_t ) );
+			break;
 		}
 
-		if ( bucket->type == NA_BAD ) {
-			bucket->type = address.type;
-			switch ( address.type ) {
-				case NA_IP:  Com_Memcpy( bucket->ipv._4, address.ip, 4 );   break;
-				default: break;
-			}
-
-			bucket->lastTime = now;
-			bucket->burst = 0;
-			bucket->hash = hash;
-
-			// Add to the head of the relevant hash chain
-			bucket->next = bucketHashes[ hash ];
-			if ( bucketHashes[ hash ] != NULL ) {
-				bucketHashes[ hash ]->prev = bucket;
-			}
+		if ( slot->key == key && slot->subnet == subnet ) {
+			return &slot->bucket;
+		}
 
-			bucket->prev = NULL;
-			bucketHashes[ hash ] = bucket;
+		interval = now - slot->bucket.lastTime;
+		expired = ( interval > ( burst * period ) || interval < 0 ) ? qtrue : qfalse;
 
-			return bucket;
+		if ( !reuse || ( expired && !reuseExpired ) ||
+			( !reuseExpired && slot->bucket.lastTime - reuse->bucket.lastTime < 0 ) ) {
+			reuse = slot;
+			reuseExpired = expired;
 		}
 	}
 
-	// Couldn't allocate a bucket for this address
-	return NULL;
+	reuse->key = key;
+	reuse->type = NA_IP;
+	reuse->subnet = subnet;
+	reuse->bucket.lastTime = now;
+	reuse->bucket.burst = 0;
+
+	return &reuse->bucket;
 }
 
 /*
@@ -451,64 +438,99 @@ Rate limit for a particular address
 ================
 */
 qboolean SVC_RateLimitAddress( netadr_t from, int burst, int period ) {
-	leakyBucket_t *bucket = SVC_BucketForAddress( from, burst, period );
+	uint32_t	key;
+	int			scale;
+
+	// only remote addresses are limited
+	if ( from.type != NA_IP ) {
+		return qfalse;
+	}
 
-	return SVC_RateLimit( bucket, burst, period );
+	key = ( (uint32_t)from.ip[0] << 24 ) | ( (uint32_t)from.ip[1] << 16 ) | ( (uint32_t)from.ip[2] << 8 ) | from.ip[3];
+	if ( SVC_RateLimit( SVC_BucketForKey( key, qfalse, burst, period ), burst, period ) ) {
+		return qtrue;
+	}
+
+	// the whole /24 shares a bucket sv_rateLimitSubnet times as large, so
+	// spreading a flood over neighbouring addresses doesn't get around the limit
+	scale = sv_rateLimitSubnet->integer;
+	if ( scale > 0 ) {
+		burst = Q_min( burst * scale, 127 );
+		period = Q_max( period / scale, 1 );
+		return SVC_RateLimit( SVC_BucketForKey( key & 0xffffff00u, qtrue, burst, period ), burst, period );
+	}
+
+	return qfalse;
 }
 
 /*
 ================
-SVC_Status
+SVC_StatusCache
 
-Responds with all the info that qplug or qspy can see about the server
-and all connected players.  Used for getting detailed information after
-the simple info query.
+getstatus and getinfo only differ by the challenge between requests, so
+their text is built once per server frame.
 ================
 */
-void SVC_Status( netadr_t from ) {
+typedef struct statusCache_s {
+	int		time;		// svs.time and sv.serverId of the frame the text is from
+	int		serverId;
+	int		infoLength;
+	char	info[MAX_INFO_STRING];
+} statusCache_t;
+
+static statusCache_t	svcStatusCache = { -1 };
+static statusCache_t	svcInfoCache = { -1 };
+static char				svcStatusPlayers[MAX_MSGLEN];
+
+static qboolean SVC_StatusCacheValid( statusCache_t *cache ) {
+	if ( cache->time == svs.time && cache->serverId == sv.serverId ) {
+		return qtrue;
+	}
+
+	cache->time = svs.time;
+	cache->serverId = sv.serverId;
+	return qfalse;
+}
+
+/*
+================
+SVC_ChallengeInfo
+
+The challenge key as Info_SetValueForKey would add it in front of an
+info string of the given length
+================
+*/
+static void SVC_ChallengeInfo( char *challenge, int infoLength ) {
+	challenge[0] = 0;
+	Info_SetValueForKey( challenge, "challenge", Cmd_Argv(1) );
+
+	if ( strlen( challenge ) + infoLength >= MAX_INFO_STRING ) {
+		Com_Printf( "Info string length exceeded\n" );
+		challenge[0] = 0;
+	}
+}
+
+/*
+================
+SVC_BuildStatus
+================
+*/
+static void SVC_BuildStatus( void ) {
 	char	player[1024];
-	char	status[MAX_MSGLEN];
 	int		i;
 	client_t	*cl;
 	playerState_t	*ps;
 	int		statusLength;
 	int		playerLength;
-	char	infostring[MAX_INFO_STRING];
 
-	// ignore if we are in single player
-	/*
-	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER ) {
+	if ( SVC_StatusCacheValid( &svcStatusCache ) ) {
 		return;
 	}
-	*/
 
-	// Prevent using getstatus as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
-		if ( com_developer->integer ) {
-			Com_Printf( "SVC_Status: rate limit from %s exceeded, dropping request\n",
-				NET_AdrToString( from ) );
-		}
-		return;
-	}
-
-	// Allow getstatus to be DoSed relatively easily, but prevent
-	// excess outbound bandwidth usage when being flooded inbound
-	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) ) {
-		Com_DPrintf( "SVC_Status: rate limit exceeded, dropping request\n" );
-		return;
-	}
+	Q_strncpyz( svcStatusCache.info, Cvar_InfoString( CVAR_SERVERINFO ), sizeof( svcStatusCache.info ) );
+	svcStatusCache.infoLength = strlen( svcStatusCache.info );
 
-	// A maximum challenge length of 128 should be more than plenty.
-	if(strlen(Cmd_Argv(1)) > 128)
-		return;
-
-	Q_strncpyz( infostring, Cvar_InfoString( CVAR_SERVERINFO ), sizeof( infostring ) );
-
-	// echo back the parameter to status. so master servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
-
-	status[0] = 0;
+	svcStatusPlayers[0] = 0;
 	statusLength = 0;
 
 	for (i=0 ; i < sv_maxclients->integer ; i++) {
@@ -518,67 +540,80 @@ void SVC_Status( netadr_t from ) {
 			Com_sprintf (player, sizeof(player), "%i %i \"%s\"\n",
 				ps->persistant[PERS_SCORE], cl->ping, cl->name);
 			playerLength = strlen(player);
-			if (statusLength + playerLength >= (int)sizeof(status) ) {
+			if (statusLength + playerLength >= (int)sizeof(svcStatusPlayers) ) {
 				break;		// can't hold any more
 			}
-			strcpy (status + statusLength, player);
+			strcpy (svcStatusPlayers + statusLength, player);
 			statusLength += playerLength;
 		}
 	}
-
-	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
 }
 
 /*
 ================
-SVC_Info
+SVC_Status
 
-Responds with a short info message that should be enough to determine
-if a user is interested in a server to do a full status
+Responds with all the info that qplug or qspy can see about the server
+and all connected players.  Used for getting detailed information after
+the simple info query.
 ================
 */
-void SVC_Info( netadr_t from ) {
-	int		i, count, humans, wDisable;
-	char	*gamedir;
-	char	infostring[MAX_INFO_STRING];
+void SVC_Status( netadr_t from ) {
+	char	challenge[MAX_INFO_STRING];
 
 	// ignore if we are in single player
 	/*
-	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER || Cvar_VariableValue("ui_singlePlayerActive")) {
+	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER ) {
 		return;
 	}
 	*/
 
-	if (Cvar_VariableValue("ui_singlePlayerActive"))
-	{
-		return;
-	}
-
-	// Prevent using getinfo as an amplifier
+	// Prevent using getstatus as an amplifier
 	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
 		if ( com_developer->integer ) {
-			Com_Printf( "SVC_Info: rate limit from %s exceeded, dropping request\n",
+			Com_Printf( "SVC_Status: rate limit from %s exceeded, dropping request\n",
 				NET_AdrToString( from ) );
 		}
 		return;
 	}
 
-	// Allow getinfo to be DoSed relatively easily, but prevent
+	// Allow getstatus to be DoSed relatively easily, but prevent
 	// excess outbound bandwidth usage when being flooded inbound
 	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) ) {
-		Com_DPrintf( "SVC_Info: rate limit exceeded, dropping request\n" );
+		Com_DPrintf( "SVC_Status: rate limit exceeded, dropping request\n" );
 		return;
 	}
 
-	/*
-	 * Check whether Cmd_Argv(1) has a sane length. This was not done in the original Quake3 version which led
-	 * to the Infostring bug discovered by Luigi Auriemma. See http://aluigi.altervista.org/ for the advisory.
-	 */
-
 	// A maximum challenge length of 128 should be more than plenty.
 	if(strlen(Cmd_Argv(1)) > 128)
 		return;
 
+	SVC_BuildStatus();
+
+	// echo back the parameter to status. so master servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	SVC_ChallengeInfo( challenge, svcStatusCache.infoLength );
+
+	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s%s\n%s", challenge, svcStatusCache.info, svcStatusPlayers );
+}
+
+/*
+================
+SVC_BuildInfo
+
+Every key goes in front of the ones before it, the challenge is added
+at the end when responding.
+================
+*/
+static void SVC_BuildInfo( void ) {
+	int		i, count, humans, wDisable;
+	char	*gamedir;
+	char	*infostring = svcInfoCache.info;
+
+	if ( SVC_StatusCacheValid( &svcInfoCache ) ) {
+		return;
+	}
+
 	// don't count privateclients
 	count = humans = 0;
 	for ( i = sv_privateClients->integer ; i < sv_maxclients->integer ; i++ ) {
@@ -592,10 +627,6 @@ void SVC_Info( netadr_t from ) {
 
 	infostring[0] = 0;
 
-	// echo back the parameter to status. so servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
-
 	Info_SetValueForKey( infostring, "protocol", va("%i", PROTOCOL_VERSION) );
 	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
 	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
@@ -605,17 +636,17 @@ void SVC_Info( netadr_t from ) {
 		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
 	Info_SetValueForKey( infostring, "gametype", va("%i", sv_gametype->integer ) );
 	Info_SetValueForKey( infostring, "needpass", va("%i", sv_needpass->integer ) );
-	Info_SetValueForKey( infostring, "truejedi", va("%i", Cvar_VariableIntegerValue( "g_jediVmerc" ) ) );
+	Info_SetValueForKey( infostring, "truejedi", va("%i", sv_jediVmerc->integer ) );
 	if ( sv_gametype->integer == GT_DUEL || sv_gametype->integer == GT_POWERDUEL )
 	{
-		wDisable = Cvar_VariableIntegerValue( "g_duelWeaponDisable" );
+		wDisable = sv_duelWeaponDisable->integer;
 	}
 	else
 	{
-		wDisable = Cvar_VariableIntegerValue( "g_weaponDisable" );
+		wDisable = sv_weaponDisable->integer;
 	}
 	Info_SetValueForKey( infostring, "wdisable", va("%i", wDisable ) );
-	Info_SetValueForKey( infostring, "fdisable", va("%i", Cvar_VariableIntegerValue( "g_forcePowerDisable" ) ) );
+	Info_SetValueForKey( infostring, "fdisable", va("%i", sv_forcePowerDisable->integer ) );
 	//Info_SetValueForKey( infostring, "pure", va("%i", sv_pure->integer ) );
 	Info_SetValueForKey( infostring, "autodemo", va("%i", sv_autoDemo->integer ) );
 
@@ -630,7 +661,64 @@ void SVC_Info( netadr_t from ) {
 		Info_SetValueForKey( infostring, "game", gamedir );
 	}
 
-	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
+	svcInfoCache.infoLength = strlen( infostring );
+}
+
+/*
+================
+SVC_Info
+
+Responds with a short info message that should be enough to determine
+if a user is interested in a server to do a full status
+================
+*/
+void SVC_Info( netadr_t from ) {
+	char	challenge[MAX_INFO_STRING];
+
+	// ignore if we are in single player
+	/*
+	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER || Cvar_VariableValue("ui_singlePlayerActive")) {
+		return;
+	}
+	*/
+
+	if (sv_singlePlayerActive->integer)
+	{
+		return;
+	}
+
+	// Prevent using getinfo as an amplifier
+	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
+		if ( com_developer->integer ) {
+			Com_Printf( "SVC_Info: rate limit from %s exceeded, dropping request\n",
+				NET_AdrToString( from ) );
+		}
+		return;
+	}
+
+	// Allow getinfo to be DoSed relatively easily, but prevent
+	// excess outbound bandwidth usage when being flooded inbound
+	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) ) {
+		Com_DPrintf( "SVC_Info: rate limit exceeded, dropping request\n" );
+		return;
+	}
+
+	/*
+	 * Check whether Cmd_Argv(1) has a sane length. This was not done in the original Quake3 version which led
+	 * to the Infostring bug discovered by Luigi Auriemma. See http://aluigi.altervista.org/ for the advisory.
+	 */
+
+	// A maximum challenge length of 128 should be more than plenty.
+	if(strlen(Cmd_Argv(1)) > 128)
+		return;
+
+	SVC_BuildInfo();
+
+	// echo back the parameter to status. so servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	SVC_ChallengeInfo( challenge, svcInfoCache.infoLength );
+
+	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s%s", svcInfoCache.info, challenge );
 }
 
 /*
@@ -780,7 +868,7 @@ void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 SV_ReadPackets
 =================
 */
-void SV_PacketEvent( netadr_t from, msg_t *msg ) {
+static void SV_ProcessPacket( netadr_t from, msg_t *msg ) {
 	int			i;
 	client_t	*cl;
 	int			qport;
@@ -837,6 +925,30 @@ void SV_PacketEvent( netadr_t from, msg_t *msg ) {
 	NET_OutOfBandPrint( NS_SERVER, from, "disconnect" );
 }
 
+void SV_PacketEvent( netadr_t from, msg_t *msg ) {
+	SV_ProfileBegin( PROF_PACKETS );
+	SV_ProcessPacket( from, msg );
+	SV_ProfileEnd( PROF_PACKETS );
+}
+
+
+/*
+===================
+SV_PingTime
+
+The clock frames are stamped with when they are sent and acknowledged.
+Normally that is the server time, so pings come in whole frames.  With
+the network receive thread packets carry their real arrival time, and
+the send time is taken as the message goes out to match.
+===================
+*/
+int SV_PingTime( void ) {
+	if ( NET_ReceiveThreadActive() ) {
+		return Sys_Milliseconds();
+	}
+
+	return svs.time;
+}
 
 /*
 ===================
@@ -874,6 +986,9 @@ void SV_CalcPings( void ) {
 				continue;
 			}
 			delta = cl->frames[j].messageAcked - cl->frames[j].messageSent;
+			if ( delta < 0 ) {
+				continue;	// sent before net_recvThread was toggled
+			}
 			count++;
 			total += delta;
 		}
@@ -1052,6 +1167,63 @@ int SV_FrameMsec()
 		return 1;
 }
 
+/*
+==================
+SV_EvaluateSkeletons
+
+Transforms the bones of every linked ghoul2 entity for the time of the
+next game frame on the job workers, so the bolt and trace queries of
+the game only have to look them up. The skeletons are built with the
+model scale of the entity, like the traces against it do.
+==================
+*/
+static bool SV_EntityGhoul2Less( const sharedEntity_t *a, const sharedEntity_t *b ) {
+	return a->ghoul2 < b->ghoul2;
+}
+
+static void SV_EvaluateSkeletons( void ) {
+	static sharedEntity_t	*entities[MAX_GENTITIES];
+	static CGhoul2Info_v	*ghoul2List[MAX_GENTITIES];
+	static vec3_t			scales[MAX_GENTITIES];
+	sharedEntity_t			*ent;
+	int						i, j, numEntities, count;
+
+	if ( !sv_ghoul2Prepass->integer || !re->ext.G2API_EvaluateSkeletons ) {
+		return;
+	}
+
+	numEntities = 0;
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		ent = SV_GentityNum( i );
+		if ( ent->r.linked && ent->ghoul2 ) {
+			entities[numEntities++] = ent;
+		}
+	}
+
+	// entities may share an instance, it is only built ahead if they
+	// all trace it with the same scale
+	std::sort( entities, entities + numEntities, SV_EntityGhoul2Less );
+	count = 0;
+	for ( i = 0 ; i < numEntities ; i = j ) {
+		bool sameScale = true;
+
+		for ( j = i + 1 ; j < numEntities && entities[j]->ghoul2 == entities[i]->ghoul2 ; j++ ) {
+			if ( !VectorCompare( entities[j]->modelScale, entities[i]->modelScale ) ) {
+				sameScale = false;
+			}
+		}
+		if ( sameScale ) {
+			ghoul2List[count] = (CGhoul2Info_v *)entities[i]->ghoul2;
+			VectorCopy( entities[i]->modelScale, scales[count] );
+			count++;
+		}
+	}
+
+	SV_ProfileBegin( PROF_SKELETONS );
+	re->ext.G2API_EvaluateSkeletons( ghoul2List, scales, count );
+	SV_ProfileEnd( PROF_SKELETONS );
+}
+
 /*
 ==================
 SV_Frame
@@ -1094,25 +1266,37 @@ void SV_Frame( int msec ) {
 
 	sv.timeResidual += msec;
 
-	if (!com_dedicated->integer) SV_BotFrame( sv.time + sv.timeResidual );
+	SV_ProfileBegin( PROF_FRAME );
+
+	if (!com_dedicated->integer) {
+		SV_ProfileBegin( PROF_BOTS );
+		SV_BotFrame( sv.time + sv.timeResidual );
+		SV_ProfileEnd( PROF_BOTS );
+	}
 
 	// if time is about to hit the 32nd bit, kick all clients
 	// and clear sv.time, rather
 	// than checking for negative time wraparound everywhere.
 	// 2giga-milliseconds = 23 days, so it won't be too often
 	if ( svs.time > 0x70000000 ) {
+		SV_ProfileEnd( PROF_FRAME );
+		SV_ProfileFrame();
 		SV_Shutdown( "Restarting server due to time wrapping" );
 		Cbuf_AddText( va( "map %s\n", Cvar_VariableString( "mapname" ) ) );
 		return;
 	}
 	// this can happen considerably earlier when lots of clients play and the map doesn't change
 	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE - svs.numSnapshotEntities ) {
+		SV_ProfileEnd( PROF_FRAME );
+		SV_ProfileFrame();
 		SV_Shutdown( "Restarting server due to numSnapshotEntities wrapping" );
 		Cbuf_AddText( va( "map %s\n", Cvar_VariableString( "mapname" ) ) );
 		return;
 	}
 
 	if( sv.restartTime && sv.time >= sv.restartTime ) {
+		SV_ProfileEnd( PROF_FRAME );
+		SV_ProfileFrame();
 		sv.restartTime = 0;
 		Cbuf_AddText( "map_restart 0\n" );
 		return;
@@ -1137,9 +1321,14 @@ void SV_Frame( int msec ) {
 	// update ping based on the all received frames
 	SV_CalcPings();
 
-	if (com_dedicated->integer) SV_BotFrame( sv.time );
+	if (com_dedicated->integer) {
+		SV_ProfileBegin( PROF_BOTS );
+		SV_BotFrame( sv.time );
+		SV_ProfileEnd( PROF_BOTS );
+	}
 
 	// run the game simulation in chunks
+	SV_ProfileBegin( PROF_GAME );
 	while ( sv.timeResidual >= frameMsec ) {
 		sv.timeResidual -= frameMsec;
 		svs.time += frameMsec;
@@ -1148,11 +1337,14 @@ void SV_Frame( int msec ) {
 		// let everything in the world think and move
 		GVM_RunFrame( sv.time );
 	}
+	SV_ProfileEnd( PROF_GAME );
 
 	//rww - RAGDOLL_BEGIN
 	re->G2API_SetTime(sv.time,0);
 	//rww - RAGDOLL_END
 
+	SV_EvaluateSkeletons();
+
 	if ( com_speeds->integer ) {
 		time_game = Sys_Milliseconds () - startTime;
 	}
@@ -1161,12 +1353,22 @@ void SV_Frame( int msec ) {
 	SV_CheckTimeouts();
 
 	// send messages back to the clients
+	SV_ProfileBegin( PROF_SNAPSHOTS );
 	SV_SendClientMessages();
+	SV_ProfileEnd( PROF_SNAPSHOTS );
+
+	// start writing what the demos recorded
+	SV_ProfileBegin( PROF_DEMOS );
+	SV_DemoWriterFrame();
+	SV_ProfileEnd( PROF_DEMOS );
 
 	SV_CheckCvars();
 
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat();
+
+	SV_ProfileEnd( PROF_FRAME );
+	SV_ProfileFrame();
 }
 
 //============================================================================
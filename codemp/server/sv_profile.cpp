@@ -0,0 +1,265 @@
+/*
+===========================================================================
+Copyright (C) 2013 - 2015, OpenJK contributors
+
+This file is part of the OpenJK source code.
+
+OpenJK is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+===========================================================================
+*/
+
+// sv_profile.cpp -- per phase frame timing for the server
+
+#include "server.h"
+
+#include <algorithm>
+#include <chrono>
+
+/*
+=============================================================================
+
+Every phase adds up the time spent in it during one server frame, the
+totals of the last SV_PROFILE_FRAMES frames are kept for the statistics.
+Phases may be entered several times per frame (once per client, once
+per packet), but never while they are already running.
+
+Packets are read between server frames, so their time goes to the frame
+that follows them.
+
+A Com_Error longjmps out of whatever phases are running.  The next frame
+finds them still open and throws away the totals of the broken frame
+before it starts.
+
+=============================================================================
+*/
+
+#define SV_PROFILE_FRAMES	1024
+
+typedef std::chrono::steady_clock profileClock_t;
+
+typedef struct profilePhase_s {
+	const char			*name;
+	svProfilePhase_t	parent;			// PROF_NUM_PHASES for the top level
+} profilePhase_t;
+
+static const profilePhase_t svProfilePhases[PROF_NUM_PHASES] = {
+	{ "frame",		PROF_NUM_PHASES },	// PROF_FRAME
+	{ "bots",		PROF_FRAME },		// PROF_BOTS
+	{ "game",		PROF_FRAME },		// PROF_GAME
+	{ "skeletons",	PROF_FRAME },		// PROF_SKELETONS
+	{ "snapshots",	PROF_FRAME },		// PROF_SNAPSHOTS
+	{ "build",		PROF_SNAPSHOTS },	// PROF_SNAPSHOT_BUILD
+	{ "encode",		PROF_SNAPSHOTS },	// PROF_SNAPSHOT_ENCODE
+	{ "send",		PROF_SNAPSHOTS },	// PROF_SNAPSHOT_SEND
+	{ "demos",		PROF_FRAME },		// PROF_DEMOS
+	{ "packets",	PROF_NUM_PHASES },	// PROF_PACKETS
+};
+
+static profileClock_t::time_point	profileStart[PROF_NUM_PHASES];
+static int							profileFrameTime[PROF_NUM_PHASES];	// usec so far this frame
+static int							profileSamples[PROF_NUM_PHASES][SV_PROFILE_FRAMES];
+static int							profileNumFrames;					// total, wraps the sample ring
+static int							profileOpen;						// bit per phase between begin and end
+static qboolean						profileActive;
+
+/*
+==================
+SV_ProfileBegin
+==================
+*/
+void SV_ProfileBegin( svProfilePhase_t phase ) {
+	if ( !profileActive ) {
+		return;
+	}
+
+	if ( phase == PROF_FRAME && profileOpen ) {
+		// the last frame or packet was cut short by an error
+		memset( profileFrameTime, 0, sizeof( profileFrameTime ) );
+		profileOpen = 0;
+	}
+
+	profileOpen |= 1 << phase;
+	profileStart[phase] = profileClock_t::now();
+}
+
+/*
+==================
+SV_ProfileEnd
+==================
+*/
+void SV_ProfileEnd( svProfilePhase_t phase ) {
+	if ( !profileActive || !( profileOpen & ( 1 << phase ) ) ) {
+		return;
+	}
+
+	profileOpen &= ~( 1 << phase );
+	profileFrameTime[phase] += (int)std::chrono::duration_cast<std::chrono::microseconds>( profileClock_t::now() - profileStart[phase] ).count();
+}
+
+/*
+==================
+SV_ProfileReset
+==================
+*/
+static void SV_ProfileReset( void ) {
+	memset( profileFrameTime, 0, sizeof( profileFrameTime ) );
+	profileOpen = 0;
+	memset( profileSamples, 0, sizeof( profileSamples ) );
+	profileNumFrames = 0;
+}
+
+/*
+==================
+SV_ProfileHitch
+
+Prints where the time of a slow frame went.
+==================
+*/
+static void SV_ProfileHitch( void ) {
+	char	line[MAX_STRING_CHARS];
+	int		i;
+
+	Com_sprintf( line, sizeof( line ), "Hitch at %i: %.1fms", svs.time, profileFrameTime[PROF_FRAME] / 1000.0f );
+	for ( i = 0 ; i < PROF_NUM_PHASES ; i++ ) {
+		if ( i != PROF_FRAME ) {
+			Q_strcat( line, sizeof( line ), va( " %s %.1f", svProfilePhases[i].name, profileFrameTime[i] / 1000.0f ) );
+		}
+	}
+	Com_Printf( "%s\n", line );
+}
+
+/*
+==================
+SV_ProfileFrame
+
+Called at the end of every server frame to store the phase totals.
+==================
+*/
+void SV_ProfileFrame( void ) {
+	int		i, slot;
+
+	if ( profileActive != ( sv_profile->integer ? qtrue : qfalse ) ) {
+		profileActive = sv_profile->integer ? qtrue : qfalse;
+		SV_ProfileReset();
+		return;
+	}
+
+	if ( !profileActive ) {
+		return;
+	}
+
+	if ( sv_profileHitch->integer > 0 && profileFrameTime[PROF_FRAME] >= sv_profileHitch->integer * 1000 ) {
+		SV_ProfileHitch();
+	}
+
+	slot = profileNumFrames % SV_PROFILE_FRAMES;
+	for ( i = 0 ; i < PROF_NUM_PHASES ; i++ ) {
+		profileSamples[i][slot] = profileFrameTime[i];
+		profileFrameTime[i] = 0;
+	}
+	profileNumFrames++;
+}
+
+/*
+==================
+SV_ProfileStats
+
+Gets the median, 99th percentile and maximum in usec of a phase over
+the stored frames.
+==================
+*/
+static void SV_ProfileStats( svProfilePhase_t phase, int *p50, int *p99, int *max ) {
+	int		sorted[SV_PROFILE_FRAMES];
+	int		count = Q_min( profileNumFrames, SV_PROFILE_FRAMES );
+
+	if ( !count ) {
+		*p50 = *p99 = *max = 0;
+		return;
+	}
+
+	memcpy( sorted, profileSamples[phase], count * sizeof( sorted[0] ) );
+	std::sort( sorted, sorted + count );
+
+	*p50 = sorted[count / 2];
+	*p99 = sorted[( count * 99 ) / 100];
+	*max = sorted[count - 1];
+}
+
+/*
+==================
+SV_ProfilePrintPhases
+
+Prints the table for the children of parent, depth first.
+==================
+*/
+static void SV_ProfilePrintPhases( svProfilePhase_t parent, int depth ) {
+	int		i, p50, p99, max;
+
+	for ( i = 0 ; i < PROF_NUM_PHASES ; i++ ) {
+		if ( svProfilePhases[i].parent != parent ) {
+			continue;
+		}
+
+		SV_ProfileStats( (svProfilePhase_t)i, &p50, &p99, &max );
+		Com_Printf( "%*s%-*s %8.2f %8.2f %8.2f\n", depth * 2, "", 16 - depth * 2, svProfilePhases[i].name,
+			p50 / 1000.0f, p99 / 1000.0f, max / 1000.0f );
+		SV_ProfilePrintPhases( (svProfilePhase_t)i, depth + 1 );
+	}
+}
+
+/*
+==================
+SV_Profile_f
+
+svprofile [reset|status]
+
+Without arguments prints a table of the phase times in msec. "status"
+prints them in usec as a single line of key=p50/p99/max pairs for
+monitoring scripts.
+==================
+*/
+void SV_Profile_f( void ) {
+	const char	*arg = Cmd_Argv( 1 );
+	int			i, p50, p99, max;
+
+	if ( !Q_stricmp( arg, "reset" ) ) {
+		SV_ProfileReset();
+		return;
+	}
+
+	if ( !Q_stricmp( arg, "status" ) ) {
+		char line[MAX_STRING_CHARS];
+
+		Com_sprintf( line, sizeof( line ), "svprofile frames=%i", Q_min( profileNumFrames, SV_PROFILE_FRAMES ) );
+		for ( i = 0 ; i < PROF_NUM_PHASES ; i++ ) {
+			SV_ProfileStats( (svProfilePhase_t)i, &p50, &p99, &max );
+			Q_strcat( line, sizeof( line ), va( " %s=%i/%i/%i", svProfilePhases[i].name, p50, p99, max ) );
+		}
+		Com_Printf( "%s\n", line );
+		return;
+	}
+
+	if ( arg[0] ) {
+		Com_Printf( "Usage: svprofile [reset|status]\n" );
+		return;
+	}
+
+	if ( !profileActive ) {
+		Com_Printf( "Profiling is off, set sv_profile 1 to turn it on.\n" );
+		return;
+	}
+
+	Com_Printf( "Last %i frames, msec:\n", Q_min( profileNumFrames, SV_PROFILE_FRAMES ) );
+	Com_Printf( "%-16s %8s %8s %8s\n", "phase", "p50", "p99", "max" );
+	SV_ProfilePrintPhases( PROF_NUM_PHASES, 0 );
+}
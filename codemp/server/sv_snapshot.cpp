@@ -46,6 +46,156 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Delta entity cache
+
+Clients that acked the same frame, like spectators following the same
+player, delta the same entities from the same old states.  While the
+snapshots of a server frame are sent, the bits MSG_WriteDeltaEntity
+produced are kept keyed on the old state, entity number and force flag,
+and copied into later messages instead of encoding them again.  The new
+states can't change during SV_SendClientMessages, so the entity number
+identifies them.
+
+=============================================================================
+*/
+
+#define DELTA_CACHE_SLOTS		4096	// power of two
+#define DELTA_CACHE_MAX_ENTRIES	( DELTA_CACHE_SLOTS / 2 )
+#define DELTA_CACHE_BYTES		( 256 * 1024 )
+#define DELTA_CACHE_MAX_RUN		2048	// bytes, well above the biggest entity delta
+
+typedef struct deltaCacheEntry_s {
+	int				generation;		// valid if it matches sv_deltaCacheGeneration
+	int				number;
+	qboolean		force;
+	unsigned int	hash;
+	entityState_t	from;
+	int				bits;
+	int				dataOfs;
+} deltaCacheEntry_t;
+
+static deltaCacheEntry_t	sv_deltaCache[DELTA_CACHE_SLOTS];
+static byte					sv_deltaCacheData[DELTA_CACHE_BYTES];
+static int					sv_deltaCacheDataUsed;
+static int					sv_deltaCacheEntries;
+static int					sv_deltaCacheGeneration;
+static qboolean				sv_deltaCacheActive;
+
+/*
+=============
+SV_BeginDeltaCache
+
+Starts a new cache for this frame's snapshots.  The cache is only used
+from the main thread, snapshot jobs leave it off.
+=============
+*/
+static void SV_BeginDeltaCache( void ) {
+	sv_deltaCacheActive = (qboolean)( sv_deltaEntityCache->integer != 0 );
+	if ( !sv_deltaCacheActive ) {
+		return;
+	}
+
+	sv_deltaCacheGeneration++;
+	if ( sv_deltaCacheGeneration <= 0 ) {
+		// wrapped, make sure no stale entry can match
+		Com_Memset( sv_deltaCache, 0, sizeof( sv_deltaCache ) );
+		sv_deltaCacheGeneration = 1;
+	}
+	sv_deltaCacheDataUsed = 0;
+	sv_deltaCacheEntries = 0;
+}
+
+static void SV_EndDeltaCache( void ) {
+	sv_deltaCacheActive = qfalse;
+}
+
+static unsigned int SV_HashEntityState( const entityState_t *es ) {
+	const int		*p = (const int *)es;
+	unsigned int	hash = 2166136261u;
+	size_t			i;
+
+	for ( i = 0 ; i < sizeof( *es ) / sizeof( int ) ; i++ ) {
+		hash = ( hash ^ (unsigned int)p[i] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+=============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity through the per frame cache.
+=============
+*/
+static void SV_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, qboolean force ) {
+	static byte			runBuf[DELTA_CACHE_MAX_RUN];
+	msg_t				run;
+	deltaCacheEntry_t	*entry;
+	unsigned int		hash;
+	int					slot, i;
+
+	if ( !sv_deltaCacheActive || !from || !to ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	// unchanged entities write nothing, don't bother looking them up
+	if ( !force && !memcmp( from, to, sizeof( *from ) ) ) {
+		return;
+	}
+
+	hash = SV_HashEntityState( from ) ^ ( (unsigned int)to->number * 2654435761u ) ^ (unsigned int)force;
+
+	slot = hash & ( DELTA_CACHE_SLOTS - 1 );
+	for ( i = 0 ; i < DELTA_CACHE_SLOTS ; i++, slot = ( slot + 1 ) & ( DELTA_CACHE_SLOTS - 1 ) ) {
+		entry = &sv_deltaCache[slot];
+		if ( entry->generation != sv_deltaCacheGeneration ) {
+			break;
+		}
+		if ( entry->hash == hash && entry->number == to->number && entry->force == force
+			&& !memcmp( &entry->from, from, sizeof( *from ) ) ) {
+			// near the end of the message let MSG_WriteBits decide
+			// where it overflows, so the result stays the same
+			if ( msg->maxsize - msg->cursize < 8 + ( ( entry->bits + 7 ) >> 3 ) ) {
+				MSG_WriteDeltaEntity( msg, from, to, force );
+			} else {
+				MSG_WriteBitRun( msg, sv_deltaCacheData + entry->dataOfs, entry->bits );
+			}
+			return;
+		}
+	}
+
+	// not cached yet, encode it on its own and keep the bits
+	MSG_Init( &run, runBuf, sizeof( runBuf ) );
+	MSG_WriteDeltaEntity( &run, from, to, force );
+
+	if ( run.overflowed || msg->maxsize - msg->cursize < 8 + run.cursize ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+	MSG_WriteBitRun( msg, run.data, run.bit );
+
+	if ( i == DELTA_CACHE_SLOTS || sv_deltaCacheEntries >= DELTA_CACHE_MAX_ENTRIES
+		|| sv_deltaCacheDataUsed + run.cursize > DELTA_CACHE_BYTES ) {
+		return;		// full for this frame
+	}
+
+	entry->generation = sv_deltaCacheGeneration;
+	entry->number = to->number;
+	entry->force = force;
+	entry->hash = hash;
+	entry->from = *from;
+	entry->bits = run.bit;
+	entry->dataOfs = sv_deltaCacheDataUsed;
+	Com_Memcpy( sv_deltaCacheData + sv_deltaCacheDataUsed, run.data, run.cursize );
+	sv_deltaCacheDataUsed += run.cursize;
+	sv_deltaCacheEntries++;
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -89,7 +239,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteDeltaEntity (msg, oldent, newent, qfalse );
 			oldindex++;
 			newindex++;
 			continue;
@@ -97,7 +247,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
 			newindex++;
 			continue;
 		}
@@ -117,19 +267,17 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_DeltaFrameForClient
+
+Picks the previous frame the new snapshot will be delta compressed
+against, or NULL if it has to be sent uncompressed.
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
+static clientSnapshot_t *SV_DeltaFrameForClient( client_t *client, int *outLastframe ) {
+	clientSnapshot_t	*oldframe;
 	int					lastframe;
-	int					i;
-	int					snapFlags;
 	int					deltaMessage;
 
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
-
 	// bots never acknowledge, but it doesn't matter since the only use case is for serverside demos
 	// in which case we can delta against the very last message every time
 	deltaMessage = client->deltaMessage;
@@ -179,6 +327,67 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 		client->demo.demowaiting = qfalse;
 	}
 
+	*outLastframe = lastframe;
+	return oldframe;
+}
+
+/*
+==================
+SV_DemoDeltaFrameForClient
+
+After a keyframe the client can go on delta compressing against frames
+from before it, which a demo played from the keyframe doesn't have.  Until
+the client moves past the keyframe the demo gets its own copy of every
+snapshot, non-delta for the first one and delta compressed against the
+previous message after that, so the player is sent the same as without
+keyframes.  Returns qfalse if the demo can store the message the client
+gets.
+==================
+*/
+static qboolean SV_DemoDeltaFrameForClient( client_t *client, clientSnapshot_t *oldframe, int lastframe,
+	clientSnapshot_t **outOldframe, int *outLastframe ) {
+	int			sequence = client->netchan.outgoingSequence;
+
+	if ( !client->demo.demorecording || client->demo.demowaiting || !client->demo.keyframeSequence ) {
+		return qfalse;
+	}
+
+	if ( !oldframe || sequence - lastframe >= client->demo.keyframeSequence ) {
+		// everything the client deltas against from now on is in the demo
+		client->demo.keyframeSequence = 0;
+		return qfalse;
+	}
+
+	*outOldframe = NULL;
+	*outLastframe = 0;
+	if ( sequence > client->demo.keyframeSequence ) {
+		oldframe = &client->frames[ ( sequence - 1 ) & PACKET_MASK ];
+		if ( oldframe->first_entity > svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
+			*outOldframe = oldframe;
+			*outLastframe = 1;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+SV_WriteSnapshotFrame
+
+Writes the snapshot in the client's current frame, delta compressed
+against oldframe.  Only touches the client it is writing for, so
+several clients can be written at once by the snapshot jobs.
+==================
+*/
+static void SV_WriteSnapshotFrame( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -271,6 +480,27 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 	}
 }
 
+/*
+==================
+SV_WriteSnapshotMessage
+
+Fills an empty message with everything a snapshot message carries
+besides download data.
+==================
+*/
+static void SV_WriteSnapshotMessage( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong( msg, client->lastClientCommand );
+
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient( client, msg );
+
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotFrame( client, msg, oldframe, lastframe );
+}
+
 
 /*
 ==================
@@ -309,6 +539,7 @@ Build a client snapshot structure
 typedef struct snapshotEntityNumbers_s {
 	int		numSnapshotEntities;
 	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];
+	uint32_t	added[(MAX_GENTITIES + 31) / 32];	// used to prevent double adding from portal views
 } snapshotEntityNumbers_t;
 
 /*
@@ -323,7 +554,7 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 	eb = (int *)b;
 
 	if ( *ea == *eb ) {
-		Com_Error( ERR_DROP, "SV_QsortEntityStates: duplicated entity" );
+		return 0;
 	}
 
 	if ( *ea < *eb ) {
@@ -339,12 +570,14 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		e = gEnt->s.number;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( eNums->added[e >> 5] & ( 1u << ( e & 31 ) ) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[e >> 5] |= 1u << ( e & 31 );
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
@@ -355,6 +588,49 @@ static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapsh
 	eNums->numSnapshotEntities++;
 }
 
+/*
+===============
+SV_GatherBroadcastEntities
+
+Collects the entities that can be sent regardless of the PVS, or whose
+clusters did not all fit in the cluster index.  Also makes sure every
+entity's number is valid before snapshots start reading them.  The game can change these
+flags without relinking, so the list is rebuilt once per snapshot pass
+instead of being maintained in SV_LinkEntity.
+===============
+*/
+static int		sv_broadcastEntities[MAX_GENTITIES];
+static int		sv_numBroadcastEntities;
+static qboolean	sv_broadcastEntitiesValid;
+
+static void SV_GatherBroadcastEntities( void ) {
+	int				e;
+	sharedEntity_t	*ent;
+	svEntity_t		*svEnt;
+
+	sv_numBroadcastEntities = 0;
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum(e);
+		if ( !ent->r.linked ) {
+			continue;
+		}
+
+		// done here rather than while adding entities, which may be running on
+		// several threads at once
+		if (ent->s.number != e) {
+			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+
+		svEnt = &sv.svEntities[e];
+		if ( (ent->r.svFlags & SVF_BROADCAST) || ent->s.isPortalEnt || svEnt->lastCluster
+			|| ent->r.broadcastClients[0] || ent->r.broadcastClients[1] )
+		{
+			sv_broadcastEntities[sv_numBroadcastEntities++] = e;
+		}
+	}
+}
+
 /*
 ===============
 SV_AddEntitiesVisibleFromPoint
@@ -364,6 +640,7 @@ float g_svCullDist = -1.0f;
 static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame,
 									snapshotEntityNumbers_t *eNums, qboolean portal ) {
 	int		e, i;
+	uint32_t	candidates[(MAX_GENTITIES + 31) / 32];
 	sharedEntity_t *ent;
 	svEntity_t	*svEnt;
 	int		l;
@@ -390,7 +667,26 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 	clientpvs = CM_ClusterPVS (clientcluster);
 
+	// only entities in a visible cluster, the broadcast list or the
+	// client itself can pass the checks below
+	Com_Memset( candidates, 0, sizeof( candidates ) );
+	SV_MarkClusterEntities( clientpvs, candidates );
+	for ( i = 0 ; i < sv_numBroadcastEntities ; i++ ) {
+		e = sv_broadcastEntities[i];
+		candidates[e >> 5] |= 1u << ( e & 31 );
+	}
+	if ( frame->ps.clientNum >= 0 && frame->ps.clientNum < MAX_GENTITIES ) {
+		candidates[frame->ps.clientNum >> 5] |= 1u << ( frame->ps.clientNum & 31 );
+	}
+
 	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		if ( !( candidates[e >> 5] & ( 1u << ( e & 31 ) ) ) ) {
+			if ( !candidates[e >> 5] ) {
+				e |= 31;	// skip the whole word
+			}
+			continue;
+		}
+
 		ent = SV_GentityNum(e);
 
 		// never send entities that aren't linked in
@@ -403,11 +699,6 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 			continue;
 		}
 
-		if (ent->s.number != e) {
-			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
-		}
-
 		// entities can be flagged to explicitly not be sent to the client
 		if ( ent->r.svFlags & SVF_NOCLIENT ) {
 			continue;
@@ -429,7 +720,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		svEnt = SV_SvEntityForGentity( ent );
 
 		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+		if ( eNums->added[e >> 5] & ( 1u << ( e & 31 ) ) ) {
 			continue;
 		}
 
@@ -443,13 +734,13 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		if ( (ent->r.svFlags & SVF_BROADCAST) || e == frame->ps.clientNum
 			|| (ent->r.broadcastClients[frame->ps.clientNum/32] & (1 << (frame->ps.clientNum % 32))) )
 		{
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			SV_AddEntToSnapshot( ent, eNums );
 			continue;
 		}
 
 		if (ent->s.isPortalEnt)
 		{ //rww - portal entities are always sent as well
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			SV_AddEntToSnapshot( ent, eNums );
 			continue;
 		}
 
@@ -511,7 +802,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 
 		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		SV_AddEntToSnapshot( ent, eNums );
 
 		// if its a portal entity, add everything visible from its camera position
 		if ( ent->r.svFlags & SVF_PORTAL ) {
@@ -529,43 +820,42 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 /*
 =============
-SV_BuildClientSnapshot
+SV_BuildClientSnapshotEntities
 
 Decides which entities are going to be visible to the client, and
-copies off the playerstate and areabits.
+copies off the playerstate and areabits.  Returns qfalse if the client
+has no viewpoint to build a snapshot from.
 
 This properly handles multiple recursive portals, but the render
 currently doesn't.
 
 For viewing through other player's eyes, client can be something other than client->gentity
+
+Only reads shared state, so it can run for several clients at once.  For
+the same reason it can't drop the server, errors are returned in *error
+for the caller to raise.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static qboolean SV_BuildClientSnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers, const char **error ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
 	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
 	playerState_t				*ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	Com_Memset( entityNumbers->added, 0, sizeof( entityNumbers->added ) );
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
 	frame->num_entities = 0;
 
 	clent = client->gentity;
 	if ( !clent || client->state == CS_ZOMBIE ) {
-		return;
+		return qfalse;
 	}
 
 	// grab the current playerState_t
@@ -597,10 +887,10 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// be regenerated from the playerstate
 	clientNum = frame->ps.clientNum;
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
-		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
+		*error = "SV_SvEntityForGentity: bad gEnt";
+		return qfalse;
 	}
-	svEnt = &sv.svEntities[ clientNum ];
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[clientNum >> 5] |= 1u << ( clientNum & 31 );
 
 
 	// find the client's viewpoint
@@ -609,14 +899,20 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, qfalse );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
 	// to work correctly.  This also catches the error condition
 	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities,
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities,
+		sizeof( entityNumbers->snapshotEntities[0] ), SV_QsortEntityNumbers );
+	for ( i = 1 ; i < entityNumbers->numSnapshotEntities ; i++ ) {
+		if ( entityNumbers->snapshotEntities[i] == entityNumbers->snapshotEntities[i-1] ) {
+			*error = "SV_QsortEntityStates: duplicated entity";
+			return qfalse;
+		}
+	}
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
@@ -624,11 +920,30 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
 
+	return qtrue;
+}
+
+/*
+=============
+SV_StoreClientSnapshotEntities
+
+Copies the entity states picked by SV_BuildClientSnapshotEntities into
+the circular svs.snapshotEntities buffer.
+=============
+*/
+static void SV_StoreClientSnapshotEntities( client_t *client, const snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t			*frame;
+	int							i;
+	sharedEntity_t				*ent;
+	entityState_t				*state;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	// copy the entity states out
 	frame->num_entities = 0;
 	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
+	for ( i = 0 ; i < entityNumbers->numSnapshotEntities ; i++ ) {
+		ent = SV_GentityNum(entityNumbers->snapshotEntities[i]);
 		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
 		*state = ent->s;
 		svs.nextSnapshotEntities++;
@@ -640,6 +955,27 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	}
 }
 
+/*
+=============
+SV_BuildClientSnapshot
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client ) {
+	snapshotEntityNumbers_t		entityNumbers;
+	const char					*error = NULL;
+
+	// snapshots sent outside of SV_SendClientMessages need a fresh list
+	if ( !sv_broadcastEntitiesValid ) {
+		SV_GatherBroadcastEntities();
+	}
+
+	if ( SV_BuildClientSnapshotEntities( client, &entityNumbers, &error ) ) {
+		SV_StoreClientSnapshotEntities( client, &entityNumbers );
+	} else if ( error ) {
+		Com_Error( ERR_DROP, "%s", error );
+	}
+}
+
 
 /*
 ====================
@@ -675,12 +1011,12 @@ static int SV_RateMsec( client_t *client, int messageSize ) {
 extern void SV_WriteDemoMessage ( client_t *cl, msg_t *msg, int headerBytes );
 /*
 =======================
-SV_SendMessageToClient
+SV_SendSnapshotToClient
 
-Called by SV_SendClientSnapshot and SV_SendClientGameState
+Sends msg and stores demoMsg in the client's demo, or msg if it is NULL.
 =======================
 */
-void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
+static void SV_SendSnapshotToClient( msg_t *msg, msg_t *demoMsg, client_t *client ) {
 	int			rateMsec;
 
 	// MW - my attempt to fix illegible server message errors caused by
@@ -695,12 +1031,12 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
 
 	// record information about the message
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg->cursize;
-	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.time;
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = SV_PingTime();
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = -1;
 
 	// save the message to demo.  this must happen before sending over network as that encodes the backing databuf
 	if ( client->demo.demorecording && !client->demo.demowaiting ) {
-		msg_t msgcopy = *msg;
+		msg_t msgcopy = demoMsg ? *demoMsg : *msg;
 		MSG_WriteByte( &msgcopy, svc_EOF );
 		SV_WriteDemoMessage( client, &msgcopy, 0 );
 	}
@@ -750,64 +1086,94 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
 	}
 }
 
-
 /*
 =======================
-SV_SendClientSnapshot
+SV_SendMessageToClient
 
-Also called by SV_FinalMessage
+Called by SV_SendClientSnapshot and SV_SendClientGameState
+=======================
+*/
+void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
+	SV_SendSnapshotToClient( msg, NULL, client );
+}
+
+
+/*
+=======================
+SV_SendClientGamedir
 
+rww - make sure there is an svc_setgame sent before the first snap
 =======================
 */
 extern cvar_t	*fs_gamedirvar;
-void SV_SendClientSnapshot( client_t *client ) {
+static void SV_SendClientGamedir( client_t *client ) {
 	byte		msg_buf[MAX_MSGLEN];
 	msg_t		msg;
+	int i = 0;
 
-	if (!client->sentGamedir)
-	{ //rww - if this is the case then make sure there is an svc_setgame sent before this snap
-		int i = 0;
+	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
 
-		MSG_Init (&msg, msg_buf, sizeof(msg_buf));
+	//have to include this for each message.
+	MSG_WriteLong( &msg, client->lastClientCommand );
 
-		//have to include this for each message.
-		MSG_WriteLong( &msg, client->lastClientCommand );
+	MSG_WriteByte (&msg, svc_setgame);
 
-		MSG_WriteByte (&msg, svc_setgame);
+	const char *gamedir = FS_GetCurrentGameDir(true);
 
-		const char *gamedir = FS_GetCurrentGameDir(true);
+	while (gamedir[i])
+	{
+		MSG_WriteByte(&msg, gamedir[i]);
+		i++;
+	}
+	MSG_WriteByte(&msg, 0);
 
-		while (gamedir[i])
-		{
-			MSG_WriteByte(&msg, gamedir[i]);
-			i++;
-		}
-		MSG_WriteByte(&msg, 0);
+	// MW - my attempt to fix illegible server message errors caused by
+	// packet fragmentation of initial snapshot.
+	//rww - reusing this code here
+	while(client->state&&client->netchan.unsentFragments)
+	{
+		// send additional message fragments if the last message
+		// was too large to send at once
+		Com_Printf ("[ISM]SV_SendClientGameState() [1] for %s, writing out old fragments\n", client->name);
+		SV_Netchan_TransmitNextFragment(&client->netchan);
+	}
 
-		// MW - my attempt to fix illegible server message errors caused by
-		// packet fragmentation of initial snapshot.
-		//rww - reusing this code here
-		while(client->state&&client->netchan.unsentFragments)
-		{
-			// send additional message fragments if the last message
-			// was too large to send at once
-			Com_Printf ("[ISM]SV_SendClientGameState() [1] for %s, writing out old fragments\n", client->name);
-			SV_Netchan_TransmitNextFragment(&client->netchan);
-		}
+	// record information about the message
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg.cursize;
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = SV_PingTime();
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = -1;
 
-		// record information about the message
-		client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg.cursize;
-		client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.time;
-		client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = -1;
+	// send the datagram
+	SV_Netchan_Transmit( client, &msg );	//msg->cursize, msg->data );
 
-		// send the datagram
-		SV_Netchan_Transmit( client, &msg );	//msg->cursize, msg->data );
+	client->sentGamedir = qtrue;
+}
 
-		client->sentGamedir = qtrue;
+/*
+=======================
+SV_SendClientSnapshot
+
+Also called by SV_FinalMessage
+
+=======================
+*/
+void SV_SendClientSnapshot( client_t *client ) {
+	byte				msg_buf[MAX_MSGLEN];
+	msg_t				msg;
+	byte				demoMsgBuf[MAX_MSGLEN];
+	msg_t				demoMsg;
+	clientSnapshot_t	*oldframe, *demoOldframe;
+	int					lastframe, demoLastframe;
+	qboolean			demoCopy;
+
+	if (!client->sentGamedir) {
+		SV_SendClientGamedir( client );
 	}
 
 	// build the snapshot
+	SV_ProfileBegin( PROF_SNAPSHOT_BUILD );
 	SV_BuildClientSnapshot( client );
+	SV_ProfileEnd( PROF_SNAPSHOT_BUILD );
 
 	if ( sv_autoDemo->integer && !client->demo.demorecording ) {
 		if ( client->netchan.remoteAddress.type != NA_BOT || sv_autoDemoBots->integer ) {
@@ -821,19 +1187,13 @@ void SV_SendClientSnapshot( client_t *client ) {
 		return;
 	}
 
+	SV_ProfileBegin( PROF_SNAPSHOT_ENCODE );
+
 	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
 	msg.allowoverflow = qtrue;
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
-
-	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
-
-	// send over all the relevant entityState_t
-	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	oldframe = SV_DeltaFrameForClient( client, &lastframe );
+	SV_WriteSnapshotMessage( client, &msg, oldframe, lastframe );
 
 	// Add any download data if the client is downloading
 	SV_WriteDownloadToClient( client, &msg );
@@ -844,10 +1204,232 @@ void SV_SendClientSnapshot( client_t *client ) {
 		MSG_Clear (&msg);
 	}
 
-	SV_SendMessageToClient( &msg, client );
+	demoCopy = SV_DemoDeltaFrameForClient( client, oldframe, lastframe, &demoOldframe, &demoLastframe );
+	if ( demoCopy ) {
+		MSG_Init( &demoMsg, demoMsgBuf, sizeof( demoMsgBuf ) );
+		demoMsg.allowoverflow = qtrue;
+		SV_WriteSnapshotMessage( client, &demoMsg, demoOldframe, demoLastframe );
+		if ( demoMsg.overflowed ) {
+			Com_Printf( "WARNING: demo msg overflowed for %s\n", client->name );
+			MSG_Clear( &demoMsg );
+		}
+	}
+
+	SV_ProfileEnd( PROF_SNAPSHOT_ENCODE );
+
+	SV_ProfileBegin( PROF_SNAPSHOT_SEND );
+	SV_SendSnapshotToClient( &msg, demoCopy ? &demoMsg : NULL, client );
+	SV_ProfileEnd( PROF_SNAPSHOT_SEND );
 }
 
 
+/*
+=============================================================================
+
+Snapshot jobs
+
+With sv_snapshotJobs enabled the per client work of SV_SendClientMessages
+is split in phases.  Picking the visible entities and encoding the message
+run on the job workers, everything that touches shared server state (the
+snapshot entity ring, demo files, the network) stays on the main thread and
+runs in client order, so every client gets the same bytes as from the
+serial path.  Errors found by the jobs are raised once they are done.
+
+=============================================================================
+*/
+
+typedef struct snapshotJob_s {
+	client_t				*client;
+	qboolean				built;
+	const char				*error;
+	snapshotEntityNumbers_t	entityNumbers;
+
+	qboolean				encode;
+	qboolean				encoded;
+	clientSnapshot_t		*oldframe;
+	int						lastframe;
+	msg_t					msg;
+	byte					msgBuf[MAX_MSGLEN];
+
+	qboolean				demoCopy;
+	clientSnapshot_t		*demoOldframe;
+	int						demoLastframe;
+	msg_t					demoMsg;
+	byte					demoMsgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t	sv_snapshotJobList[MAX_CLIENTS];
+
+static void SV_BuildSnapshotJob( void *data, int index ) {
+	snapshotJob_t *job = &((snapshotJob_t *)data)[index];
+
+	job->built = SV_BuildClientSnapshotEntities( job->client, &job->entityNumbers, &job->error );
+}
+
+static void SV_EncodeSnapshotJob( void *data, int index ) {
+	snapshotJob_t *job = &((snapshotJob_t *)data)[index];
+
+	if ( !job->encode || job->encoded ) {
+		return;
+	}
+
+	MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+	job->msg.allowoverflow = qtrue;
+	SV_WriteSnapshotMessage( job->client, &job->msg, job->oldframe, job->lastframe );
+
+	if ( job->demoCopy ) {
+		MSG_Init( &job->demoMsg, job->demoMsgBuf, sizeof( job->demoMsgBuf ) );
+		job->demoMsg.allowoverflow = qtrue;
+		SV_WriteSnapshotMessage( job->client, &job->demoMsg, job->demoOldframe, job->demoLastframe );
+	}
+
+	job->encoded = qtrue;
+}
+
+/*
+=======================
+SV_CanRunSnapshotJobs
+
+Starting an automatic demo in the middle of the loop changes what the
+clients after it get sent, leave those frames to the serial path.
+=======================
+*/
+static qboolean SV_CanRunSnapshotJobs( void ) {
+	int			i;
+	client_t	*c;
+
+	if ( !sv_autoDemo->integer ) {
+		return qtrue;
+	}
+
+	for ( i = 0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++ ) {
+		if ( c->state && !c->demo.demorecording &&
+			( c->netchan.remoteAddress.type != NA_BOT || sv_autoDemoBots->integer ) ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+=======================
+SV_SendClientSnapshotJobs
+=======================
+*/
+static void SV_SendClientSnapshotJobs( void ) {
+	int				i, numJobs;
+	int				lastSnapshotEntity;
+	client_t		*c;
+	snapshotJob_t	*job;
+
+	// pick the clients that get a new snapshot this frame
+	numJobs = 0;
+	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
+		if (!c->state) {
+			continue;		// not connected
+		}
+
+		if ( svs.time < c->nextSnapshotTime ) {
+			continue;		// not time yet
+		}
+
+		// send additional message fragments if the last message
+		// was too large to send at once
+		if ( c->netchan.unsentFragments ) {
+			c->nextSnapshotTime = svs.time +
+				SV_RateMsec( c, c->netchan.unsentLength - c->netchan.unsentFragmentStart );
+			SV_Netchan_TransmitNextFragment( &c->netchan );
+			continue;
+		}
+
+		if (!c->sentGamedir) {
+			SV_SendClientGamedir( c );
+		}
+
+		job = &sv_snapshotJobList[numJobs++];
+		job->client = c;
+		job->built = qfalse;
+		job->error = NULL;
+		job->encode = qfalse;
+		job->encoded = qfalse;
+		job->demoCopy = qfalse;
+	}
+
+	// decide what every client can see
+	SV_ProfileBegin( PROF_SNAPSHOT_BUILD );
+	Com_RunJobs( SV_BuildSnapshotJob, sv_snapshotJobList, numJobs );
+
+	// the jobs can't drop the server, raise the first error in client order
+	lastSnapshotEntity = svs.nextSnapshotEntities;
+	for ( i = 0, job = sv_snapshotJobList ; i < numJobs ; i++, job++ ) {
+		if ( job->error ) {
+			Com_Error( ERR_DROP, "%s", job->error );
+		}
+		if ( job->built ) {
+			lastSnapshotEntity += job->entityNumbers.numSnapshotEntities;
+		}
+	}
+
+	// fill the snapshot entity ring in client order and pick the delta frames
+	for ( i = 0, job = sv_snapshotJobList ; i < numJobs ; i++, job++ ) {
+		c = job->client;
+
+		if ( job->built ) {
+			SV_StoreClientSnapshotEntities( c, &job->entityNumbers );
+		}
+
+		// bots need to have their snapshots built, but
+		// they query them directly without needing to be sent
+		if ( c->netchan.remoteAddress.type == NA_BOT && !c->demo.demorecording ) {
+			continue;
+		}
+
+		job->oldframe = SV_DeltaFrameForClient( c, &job->lastframe );
+		job->demoCopy = SV_DemoDeltaFrameForClient( c, job->oldframe, job->lastframe, &job->demoOldframe, &job->demoLastframe );
+		job->encode = qtrue;
+
+		// the serial path writes this client before the ones after it store
+		// their entities, if those overwrite the delta frames' entities in the
+		// ring it has to be written now too
+		if ( ( job->oldframe && job->oldframe->first_entity <= lastSnapshotEntity - svs.numSnapshotEntities )
+			|| ( job->demoCopy && job->demoOldframe && job->demoOldframe->first_entity <= lastSnapshotEntity - svs.numSnapshotEntities ) ) {
+			SV_EncodeSnapshotJob( sv_snapshotJobList, i );
+		}
+	}
+	SV_ProfileEnd( PROF_SNAPSHOT_BUILD );
+
+	// write the messages
+	SV_ProfileBegin( PROF_SNAPSHOT_ENCODE );
+	Com_RunJobs( SV_EncodeSnapshotJob, sv_snapshotJobList, numJobs );
+	SV_ProfileEnd( PROF_SNAPSHOT_ENCODE );
+
+	// and send them
+	SV_ProfileBegin( PROF_SNAPSHOT_SEND );
+	for ( i = 0, job = sv_snapshotJobList ; i < numJobs ; i++, job++ ) {
+		if ( !job->encode ) {
+			continue;
+		}
+		c = job->client;
+
+		// Add any download data if the client is downloading
+		SV_WriteDownloadToClient( c, &job->msg );
+
+		// check for overflow
+		if ( job->msg.overflowed ) {
+			Com_Printf ("WARNING: msg overflowed for %s\n", c->name);
+			MSG_Clear (&job->msg);
+		}
+		if ( job->demoCopy && job->demoMsg.overflowed ) {
+			Com_Printf( "WARNING: demo msg overflowed for %s\n", c->name );
+			MSG_Clear( &job->demoMsg );
+		}
+
+		SV_SendSnapshotToClient( &job->msg, job->demoCopy ? &job->demoMsg : NULL, c );
+	}
+	SV_ProfileEnd( PROF_SNAPSHOT_SEND );
+}
+
 /*
 =======================
 SV_SendClientMessages
@@ -857,6 +1439,21 @@ void SV_SendClientMessages( void ) {
 	int			i;
 	client_t	*c;
 
+	// entity flags can't change while the snapshots are built
+	SV_GatherBroadcastEntities();
+	sv_broadcastEntitiesValid = qtrue;
+
+	NET_BeginSendBatch();
+
+	if ( sv_snapshotJobs->integer && SV_CanRunSnapshotJobs() ) {
+		SV_SendClientSnapshotJobs();
+		NET_FlushSendBatch();
+		sv_broadcastEntitiesValid = qfalse;
+		return;
+	}
+
+	SV_BeginDeltaCache();
+
 	// send a message to each connected client
 	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
 		if (!c->state) {
@@ -879,5 +1476,9 @@ void SV_SendClientMessages( void ) {
 		// generate and send a new message
 		SV_SendClientSnapshot( c );
 	}
+
+	SV_EndDeltaCache();
+	NET_FlushSendBatch();
+	sv_broadcastEntitiesValid = qfalse;
 }
 
@@ -27,6 +27,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "ghoul2/ghoul2_shared.h"
 #include "qcommon/cm_public.h"
 
+#include <chrono>
+
 /*
 ================
 SV_ClipHandleForEntity
@@ -78,17 +80,531 @@ typedef struct worldSector_s {
 worldSector_t	sv_worldSectors[AREA_NODES];
 int			sv_numworldSectors;
 
+/*
+===============================================================================
+
+WORLD TREE
+
+With sv_worldTree the sectors are replaced by a dynamic bounding volume
+tree: every linked entity is a leaf holding its box grown by a margin, and
+inner nodes hold the union of their children.  Leafs are inserted where
+they grow the tree's surface area the least and the tree is kept balanced
+with rotations, so it adapts to wherever the entities actually are, tall
+siege maps and wide open ones alike.  An entity that moves without leaving
+its grown box doesn't touch the tree at all.
+
+The tree hands out entities in a different order than the sector walk,
+which changes trace tie breaks and the order of EntitiesInBox results
+that mods may rely on, so it is off by default.
+
+===============================================================================
+*/
+
+#define	WORLD_NODES			( MAX_GENTITIES * 2 )
+#define	WORLD_NODE_MARGIN	16			// leafs are grown this much so small moves don't relink
+#define	WORLD_STACK			128			// a balanced tree of WORLD_NODES is nowhere near this deep
+
+typedef struct worldNode_s {
+	vec3_t				mins, maxs;
+	struct worldNode_s	*parent;		// also links the free list
+	struct worldNode_s	*children[2];	// NULL for leafs
+	svEntity_t			*entity;		// leafs only
+	int					height;			// 0 for leafs
+} worldNode_t;
+
+static worldNode_t	sv_worldNodes[WORLD_NODES];
+static worldNode_t	*sv_worldRoot;
+static worldNode_t	*sv_freeWorldNodes;
+static int			sv_numWorldNodes;
+static qboolean		sv_useWorldTree;	// sv_worldTree as of the last SV_ClearWorld
+
+/*
+===============
+SV_WorldNodeArea
+
+Half the surface area of a box, all the insertion cost needs.
+===============
+*/
+static float SV_WorldNodeArea( const vec3_t mins, const vec3_t maxs ) {
+	float	dx = maxs[0] - mins[0];
+	float	dy = maxs[1] - mins[1];
+	float	dz = maxs[2] - mins[2];
+
+	return dx * dy + dy * dz + dz * dx;
+}
+
+/*
+===============
+SV_WorldNodeUnionArea
+===============
+*/
+static float SV_WorldNodeUnionArea( const worldNode_t *a, const worldNode_t *b ) {
+	vec3_t	mins, maxs;
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		mins[i] = Q_min( a->mins[i], b->mins[i] );
+		maxs[i] = Q_max( a->maxs[i], b->maxs[i] );
+	}
+
+	return SV_WorldNodeArea( mins, maxs );
+}
+
+/*
+===============
+SV_FitWorldNode
+
+Updates the bounds and height of an inner node from its children.
+===============
+*/
+static void SV_FitWorldNode( worldNode_t *node ) {
+	const worldNode_t	*a = node->children[0];
+	const worldNode_t	*b = node->children[1];
+	int					i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		node->mins[i] = Q_min( a->mins[i], b->mins[i] );
+		node->maxs[i] = Q_max( a->maxs[i], b->maxs[i] );
+	}
+	node->height = 1 + Q_max( a->height, b->height );
+}
+
+/*
+===============
+SV_AllocWorldNode
+===============
+*/
+static worldNode_t *SV_AllocWorldNode( void ) {
+	worldNode_t	*node = sv_freeWorldNodes;
+
+	if ( node ) {
+		sv_freeWorldNodes = node->parent;
+	} else {
+		// can't happen, there are two nodes per entity
+		if ( sv_numWorldNodes == WORLD_NODES ) {
+			Com_Error( ERR_DROP, "SV_AllocWorldNode: out of nodes" );
+		}
+		node = &sv_worldNodes[sv_numWorldNodes++];
+	}
+
+	Com_Memset( node, 0, sizeof( *node ) );
+	return node;
+}
+
+/*
+===============
+SV_FreeWorldNode
+===============
+*/
+static void SV_FreeWorldNode( worldNode_t *node ) {
+	node->entity = NULL;
+	node->children[0] = node->children[1] = NULL;
+	node->parent = sv_freeWorldNodes;
+	sv_freeWorldNodes = node;
+}
+
+/*
+===============
+SV_RotateWorldNode
+
+Pulls the child on the given side of node up into its place.  The taller
+grandchild stays with the raised child, the shorter one moves down to node.
+Returns the new root of the subtree.
+===============
+*/
+static worldNode_t *SV_RotateWorldNode( worldNode_t *node, int side ) {
+	worldNode_t	*raise = node->children[side];
+	worldNode_t	*tall, *shorter;
+
+	if ( raise->children[0]->height > raise->children[1]->height ) {
+		tall = raise->children[0];
+		shorter = raise->children[1];
+	} else {
+		tall = raise->children[1];
+		shorter = raise->children[0];
+	}
+
+	raise->parent = node->parent;
+	if ( raise->parent ) {
+		raise->parent->children[raise->parent->children[0] == node ? 0 : 1] = raise;
+	} else {
+		sv_worldRoot = raise;
+	}
+
+	raise->children[0] = node;
+	raise->children[1] = tall;
+	node->parent = raise;
+	node->children[side] = shorter;
+	shorter->parent = node;
+
+	SV_FitWorldNode( node );
+	SV_FitWorldNode( raise );
+
+	return raise;
+}
+
+/*
+===============
+SV_RefitWorldNodes
+
+Walks up from node fixing bounds and heights, rotating wherever one side
+got more than a level taller than the other.
+===============
+*/
+static void SV_RefitWorldNodes( worldNode_t *node ) {
+	int		balance;
+
+	for ( ; node ; node = node->parent ) {
+		SV_FitWorldNode( node );
+
+		balance = node->children[1]->height - node->children[0]->height;
+		if ( balance > 1 ) {
+			node = SV_RotateWorldNode( node, 1 );
+		} else if ( balance < -1 ) {
+			node = SV_RotateWorldNode( node, 0 );
+		}
+	}
+}
+
+/*
+===============
+SV_InsertWorldLeaf
+===============
+*/
+static void SV_InsertWorldLeaf( worldNode_t *leaf ) {
+	worldNode_t	*sibling, *parent, *child;
+	float		area, unionArea, inherit;
+	float		cost, childCost[2];
+	int			i;
+
+	if ( !sv_worldRoot ) {
+		sv_worldRoot = leaf;
+		leaf->parent = NULL;
+		return;
+	}
+
+	// find the node that is cheapest to pair the leaf with
+	sibling = sv_worldRoot;
+	while ( sibling->children[0] ) {
+		area = SV_WorldNodeArea( sibling->mins, sibling->maxs );
+		unionArea = SV_WorldNodeUnionArea( sibling, leaf );
+
+		// pairing here adds a node of unionArea, going further down
+		// grows this node and everything above it anyway
+		cost = 2.0f * unionArea;
+		inherit = 2.0f * ( unionArea - area );
+
+		for ( i = 0 ; i < 2 ; i++ ) {
+			child = sibling->children[i];
+			childCost[i] = SV_WorldNodeUnionArea( child, leaf ) + inherit;
+			if ( child->children[0] ) {
+				childCost[i] -= SV_WorldNodeArea( child->mins, child->maxs );
+			}
+		}
+
+		if ( cost < childCost[0] && cost < childCost[1] ) {
+			break;
+		}
+		sibling = sibling->children[childCost[0] < childCost[1] ? 0 : 1];
+	}
+
+	parent = SV_AllocWorldNode();
+	parent->parent = sibling->parent;
+	if ( parent->parent ) {
+		parent->parent->children[parent->parent->children[0] == sibling ? 0 : 1] = parent;
+	} else {
+		sv_worldRoot = parent;
+	}
+
+	parent->children[0] = sibling;
+	parent->children[1] = leaf;
+	sibling->parent = parent;
+	leaf->parent = parent;
+
+	SV_RefitWorldNodes( parent );
+}
+
+/*
+===============
+SV_RemoveWorldLeaf
+===============
+*/
+static void SV_RemoveWorldLeaf( worldNode_t *leaf ) {
+	worldNode_t	*parent, *grandParent, *sibling;
+
+	if ( leaf == sv_worldRoot ) {
+		sv_worldRoot = NULL;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	parent = leaf->parent;
+	grandParent = parent->parent;
+	sibling = parent->children[parent->children[0] == leaf ? 1 : 0];
+
+	sibling->parent = grandParent;
+	if ( grandParent ) {
+		grandParent->children[grandParent->children[0] == parent ? 0 : 1] = sibling;
+	} else {
+		sv_worldRoot = sibling;
+	}
+	SV_FreeWorldNode( parent );
+
+	if ( grandParent ) {
+		SV_RefitWorldNodes( grandParent );
+	}
+}
+
+/*
+===============
+SV_LinkWorldNode
+
+Puts the entity in the tree, or leaves it where it is if its leaf still
+holds the new box.
+===============
+*/
+static void SV_LinkWorldNode( svEntity_t *ent, const vec3_t absmin, const vec3_t absmax ) {
+	worldNode_t	*leaf = ent->worldNode;
+	int			i;
+
+	if ( leaf ) {
+		for ( i = 0 ; i < 3 ; i++ ) {
+			if ( absmin[i] < leaf->mins[i] || absmax[i] > leaf->maxs[i] ) {
+				break;
+			}
+		}
+		if ( i == 3 ) {
+			return;
+		}
+		SV_RemoveWorldLeaf( leaf );
+	} else {
+		leaf = SV_AllocWorldNode();
+		leaf->entity = ent;
+		ent->worldNode = leaf;
+	}
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		leaf->mins[i] = absmin[i] - WORLD_NODE_MARGIN;
+		leaf->maxs[i] = absmax[i] + WORLD_NODE_MARGIN;
+	}
+	SV_InsertWorldLeaf( leaf );
+}
+
+/*
+===============
+SV_UnlinkWorldNode
+===============
+*/
+static void SV_UnlinkWorldNode( svEntity_t *ent ) {
+	worldNode_t	*leaf = ent->worldNode;
+
+	if ( !leaf ) {
+		return;
+	}
+
+	SV_RemoveWorldLeaf( leaf );
+	SV_FreeWorldNode( leaf );
+	ent->worldNode = NULL;
+}
+
+/*
+===============
+SV_ClearWorldNodes
+===============
+*/
+static void SV_ClearWorldNodes( void ) {
+	sv_worldRoot = NULL;
+	sv_freeWorldNodes = NULL;
+	sv_numWorldNodes = 0;
+}
+
+/*
+===============================================================================
+
+CLUSTER INDEX
+
+Every linked entity is also chained into a list for each PVS cluster it
+touches, so building a snapshot only has to look at the entities in the
+clusters the client can see instead of every entity in the level.
+
+===============================================================================
+*/
+
+static svClusterLink_t	**sv_clusterEntities;
+static int				sv_numClusterEntities;
+
+/*
+===============
+SV_ClearClusterEntities
+===============
+*/
+static void SV_ClearClusterEntities( void ) {
+	if ( sv_clusterEntities ) {
+		Z_Free( sv_clusterEntities );
+		sv_clusterEntities = NULL;
+	}
+
+	sv_numClusterEntities = CM_NumClusters();
+	if ( sv_numClusterEntities > 0 ) {
+		sv_clusterEntities = (svClusterLink_t **)Z_Malloc( sv_numClusterEntities * sizeof( *sv_clusterEntities ), TAG_GENERAL, qtrue );
+	}
+}
+
+/*
+===============
+SV_LinkClusterEntity
+===============
+*/
+static void SV_LinkClusterEntity( svEntity_t *ent ) {
+	int				i, j;
+	int				cluster;
+	svClusterLink_t	*link;
+
+	ent->numClusterLinks = 0;
+	for ( i = 0 ; i < ent->numClusters ; i++ ) {
+		cluster = ent->clusternums[i];
+		if ( cluster < 0 || cluster >= sv_numClusterEntities ) {
+			continue;
+		}
+
+		// several leafs can share a cluster, only link once
+		for ( j = 0 ; j < i ; j++ ) {
+			if ( ent->clusternums[j] == cluster ) {
+				break;
+			}
+		}
+		if ( j != i ) {
+			continue;
+		}
+
+		link = &ent->clusterLinks[ent->numClusterLinks++];
+		link->ent = ent;
+		link->cluster = cluster;
+		link->prev = NULL;
+		link->next = sv_clusterEntities[cluster];
+		if ( link->next ) {
+			link->next->prev = link;
+		}
+		sv_clusterEntities[cluster] = link;
+	}
+}
+
+/*
+===============
+SV_UnlinkClusterEntity
+===============
+*/
+static void SV_UnlinkClusterEntity( svEntity_t *ent ) {
+	int				i;
+	svClusterLink_t	*link;
+
+	for ( i = 0 ; i < ent->numClusterLinks ; i++ ) {
+		link = &ent->clusterLinks[i];
+		if ( link->prev ) {
+			link->prev->next = link->next;
+		} else {
+			sv_clusterEntities[link->cluster] = link->next;
+		}
+		if ( link->next ) {
+			link->next->prev = link->prev;
+		}
+		link->prev = link->next = NULL;
+	}
+	ent->numClusterLinks = 0;
+}
+
+/*
+===============
+SV_MarkClusterEntities
+===============
+*/
+void SV_MarkClusterEntities( const byte *pvs, uint32_t *entityBits ) {
+	int				cluster;
+	int				num;
+	svClusterLink_t	*link;
+
+	for ( cluster = 0 ; cluster < sv_numClusterEntities ; cluster++ ) {
+		if ( !pvs[cluster >> 3] ) {
+			cluster |= 7;	// skip the whole byte
+			continue;
+		}
+		if ( !( pvs[cluster >> 3] & ( 1 << ( cluster & 7 ) ) ) ) {
+			continue;
+		}
+		for ( link = sv_clusterEntities[cluster] ; link ; link = link->next ) {
+			num = link->ent - sv.svEntities;
+			entityBits[num >> 5] |= 1u << ( num & 31 );
+		}
+	}
+}
+
 
 /*
 ===============
 SV_SectorList_f
 ===============
 */
+static void SV_WorldNodeList( void ) {
+	worldNode_t	*stack[WORLD_STACK];
+	worldNode_t	*node;
+	int			depth[WORLD_STACK];
+	int			leafDepths[WORLD_STACK];
+	int			numStack, d, i;
+	int			leafs = 0, totalDepth = 0;
+	float		leafArea = 0.0f;
+
+	Com_Memset( leafDepths, 0, sizeof( leafDepths ) );
+
+	if ( sv_worldRoot ) {
+		stack[0] = sv_worldRoot;
+		depth[0] = 0;
+		numStack = 1;
+		while ( numStack ) {
+			numStack--;
+			node = stack[numStack];
+			d = depth[numStack];
+			if ( !node->children[0] ) {
+				leafs++;
+				totalDepth += d;
+				leafDepths[d]++;
+				leafArea += SV_WorldNodeArea( node->mins, node->maxs );
+				continue;
+			}
+			if ( numStack > WORLD_STACK - 2 ) {
+				break;
+			}
+			for ( i = 0 ; i < 2 ; i++ ) {
+				stack[numStack] = node->children[i];
+				depth[numStack] = d + 1;
+				numStack++;
+			}
+		}
+	}
+
+	Com_Printf( "world tree: %i entities, %i nodes in use, height %i\n",
+		leafs, leafs ? leafs * 2 - 1 : 0, sv_worldRoot ? sv_worldRoot->height : 0 );
+	if ( !leafs ) {
+		return;
+	}
+	Com_Printf( "average leaf depth %.1f, root area / leaf area %.2f\n", totalDepth / (float)leafs,
+		leafArea > 0.0f ? SV_WorldNodeArea( sv_worldRoot->mins, sv_worldRoot->maxs ) / leafArea : 0.0f );
+	for ( d = 0 ; d < WORLD_STACK ; d++ ) {
+		if ( leafDepths[d] ) {
+			Com_Printf( "depth %i: %i entities\n", d, leafDepths[d] );
+		}
+	}
+}
+
 void SV_SectorList_f( void ) {
 	int				i, c;
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
+	if ( sv_useWorldTree ) {
+		SV_WorldNodeList();
+		return;
+	}
+
 	for ( i = 0 ; i < AREA_NODES ; i++ ) {
 		sec = &sv_worldSectors[i];
 
@@ -155,6 +671,11 @@ void SV_ClearWorld( void ) {
 	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
 	sv_numworldSectors = 0;
 
+	SV_ClearWorldNodes();
+	sv_useWorldTree = sv_worldTree->integer ? qtrue : qfalse;
+
+	SV_ClearClusterEntities();
+
 	// get world map bounds
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
@@ -168,19 +689,11 @@ SV_UnlinkEntity
 
 ===============
 */
-void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
-	svEntity_t		*ent;
+static void SV_UnlinkSectorEntity( svEntity_t *ent ) {
 	svEntity_t		*scan;
 	worldSector_t	*ws;
 
-	ent = SV_SvEntityForGentity( gEnt );
-
-	gEnt->r.linked = qfalse;
-
 	ws = ent->worldSector;
-	if ( !ws ) {
-		return;		// not linked in anywhere
-	}
 	ent->worldSector = NULL;
 
 	if ( ws->entities == ent ) {
@@ -198,6 +711,54 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
 }
 
+void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
+	svEntity_t		*ent;
+
+	ent = SV_SvEntityForGentity( gEnt );
+
+	gEnt->r.linked = qfalse;
+
+	if ( !ent->worldSector && !ent->worldNode ) {
+		return;		// not linked in anywhere
+	}
+
+	SV_UnlinkClusterEntity( ent );
+
+	if ( ent->worldSector ) {
+		SV_UnlinkSectorEntity( ent );
+	} else {
+		SV_UnlinkWorldNode( ent );
+	}
+}
+
+
+/*
+===============
+SV_LinkSectorEntity
+===============
+*/
+static void SV_LinkSectorEntity( svEntity_t *ent, const vec3_t absmin, const vec3_t absmax ) {
+	worldSector_t	*node;
+
+	// find the first world sector node that the ent's box crosses
+	node = sv_worldSectors;
+	while (1)
+	{
+		if (node->axis == -1)
+			break;
+		if ( absmin[node->axis] > node->dist)
+			node = node->children[0];
+		else if ( absmax[node->axis] < node->dist)
+			node = node->children[1];
+		else
+			break;		// crosses the node
+	}
+
+	// link it in
+	ent->worldSector = node;
+	ent->nextEntityInWorldSector = node->entities;
+	node->entities = ent;
+}
 
 /*
 ===============
@@ -207,7 +768,6 @@ SV_LinkEntity
 */
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEntity( sharedEntity_t *gEnt ) {
-	worldSector_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			cluster;
 	int			num_leafs;
@@ -219,8 +779,14 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
-		SV_UnlinkEntity( gEnt );	// unlink from old position
+	// unlink from old position, the world tree gets a chance
+	// to keep its leaf once the new bounds are known
+	if ( ent->worldSector || ent->worldNode ) {
+		gEnt->r.linked = qfalse;
+		SV_UnlinkClusterEntity( ent );
+		if ( ent->worldSector ) {
+			SV_UnlinkSectorEntity( ent );
+		}
 	}
 
 	// encode the size into the entityState_t for client prediction
@@ -302,6 +868,7 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	// if none of the leafs were inside the map, the
 	// entity is outside the world and can be considered unlinked
 	if ( !num_leafs ) {
+		SV_UnlinkWorldNode( ent );
 		return;
 	}
 
@@ -343,24 +910,13 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+	if ( sv_useWorldTree ) {
+		SV_LinkWorldNode( ent, gEnt->r.absmin, gEnt->r.absmax );
+	} else {
+		SV_LinkSectorEntity( ent, gEnt->r.absmin, gEnt->r.absmax );
 	}
 
-	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
+	SV_LinkClusterEntity( ent );
 
 	gEnt->r.linked = qtrue;
 }
@@ -429,6 +985,67 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaWorldNodes
+====================
+*/
+static void SV_AreaWorldNodes( areaParms_t *ap ) {
+	worldNode_t		*stack[WORLD_STACK];
+	worldNode_t		*node;
+	sharedEntity_t	*gcheck;
+	int				numStack;
+
+	if ( !sv_worldRoot ) {
+		return;
+	}
+
+	stack[0] = sv_worldRoot;
+	numStack = 1;
+	while ( numStack ) {
+		node = stack[--numStack];
+
+		if ( node->mins[0] > ap->maxs[0]
+		|| node->mins[1] > ap->maxs[1]
+		|| node->mins[2] > ap->maxs[2]
+		|| node->maxs[0] < ap->mins[0]
+		|| node->maxs[1] < ap->mins[1]
+		|| node->maxs[2] < ap->mins[2]) {
+			continue;
+		}
+
+		if ( node->children[0] ) {
+			if ( numStack > WORLD_STACK - 2 ) {
+				Com_DPrintf( "SV_AreaEntities: world tree too deep\n" );
+				return;
+			}
+			stack[numStack++] = node->children[1];
+			stack[numStack++] = node->children[0];
+			continue;
+		}
+
+		// the leaf box is grown, check the real one
+		gcheck = SV_GEntityForSvEntity( node->entity );
+
+		if ( gcheck->r.absmin[0] > ap->maxs[0]
+		|| gcheck->r.absmin[1] > ap->maxs[1]
+		|| gcheck->r.absmin[2] > ap->maxs[2]
+		|| gcheck->r.absmax[0] < ap->mins[0]
+		|| gcheck->r.absmax[1] < ap->mins[1]
+		|| gcheck->r.absmax[2] < ap->mins[2]) {
+			continue;
+		}
+
+		if ( ap->count == ap->maxcount ) {
+			Com_DPrintf ("SV_AreaEntities: MAXCOUNT\n");
+			return;
+		}
+
+		ap->list[ap->count] = node->entity - sv.svEntities;
+		ap->count++;
+	}
+}
+
 /*
 ================
 SV_AreaEntities
@@ -443,7 +1060,11 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.count = 0;
 	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( sv_useWorldTree ) {
+		SV_AreaWorldNodes( &ap );
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+	}
 
 	return ap.count;
 }
@@ -913,3 +1534,118 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 }
 
 
+
+/*
+===============
+SV_RebuildWorld
+
+Moves every linked entity into the sectors or into the world tree.
+===============
+*/
+static void SV_RebuildWorld( qboolean useWorldTree ) {
+	sharedEntity_t	*gEnt;
+	svEntity_t		*ent;
+	int				i;
+
+	for ( i = 0 ; i < sv_numworldSectors ; i++ ) {
+		sv_worldSectors[i].entities = NULL;
+	}
+	SV_ClearWorldNodes();
+
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		ent = &sv.svEntities[i];
+		ent->worldSector = NULL;
+		ent->nextEntityInWorldSector = NULL;
+		ent->worldNode = NULL;
+	}
+
+	sv_useWorldTree = useWorldTree;
+
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		gEnt = SV_GentityNum( i );
+		if ( !gEnt->r.linked ) {
+			continue;
+		}
+
+		ent = SV_SvEntityForGentity( gEnt );
+		if ( useWorldTree ) {
+			SV_LinkWorldNode( ent, gEnt->r.absmin, gEnt->r.absmax );
+		} else {
+			SV_LinkSectorEntity( ent, gEnt->r.absmin, gEnt->r.absmax );
+		}
+	}
+}
+
+/*
+===============
+SV_AreaBench_f
+
+sv_areabench [boxes]
+
+Runs the same random area queries and box traces against the sectors and
+the world tree, with the entities of the running map, and prints how long
+they took.  The found counts of both should match.
+===============
+*/
+void SV_AreaBench_f( void ) {
+	static const vec3_t	traceMins = { -16, -16, -16 };
+	static const vec3_t	traceMaxs = { 16, 16, 16 };
+	static int			list[MAX_GENTITIES];
+	qboolean			useWorldTree = sv_useWorldTree;
+	vec3_t				worldMins, worldMaxs;
+	vec3_t				*boxes;
+	trace_t				trace;
+	int					numBoxes, numTraces, pass, i, j, found, hits;
+	int					seed;
+	float				center, half;
+	double				areaUsec, traceUsec;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	numBoxes = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100000;
+	numBoxes = Com_Clampi( 1, 10000000, numBoxes );
+	numTraces = Q_max( 1, numBoxes / 10 );	// a trace is a lot more work than an area query
+
+	// centers anywhere in the world, sizes from 16 to 512
+	CM_ModelBounds( CM_InlineModel( 0 ), worldMins, worldMaxs );
+	boxes = (vec3_t *)Z_Malloc( numBoxes * 2 * sizeof( vec3_t ), TAG_GENERAL, qfalse );
+	seed = 0x1234567;
+	for ( i = 0 ; i < numBoxes ; i++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			center = worldMins[j] + ( worldMaxs[j] - worldMins[j] ) * Q_random( &seed );
+			half = 8.0f + 248.0f * Q_random( &seed );
+			boxes[i * 2][j] = center - half;
+			boxes[i * 2 + 1][j] = center + half;
+		}
+	}
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		SV_RebuildWorld( (qboolean)pass );
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		found = 0;
+		for ( i = 0 ; i < numBoxes ; i++ ) {
+			found += SV_AreaEntities( boxes[i * 2], boxes[i * 2 + 1], list, MAX_GENTITIES );
+		}
+		areaUsec = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count();
+
+		start = std::chrono::steady_clock::now();
+		hits = 0;
+		for ( i = 0 ; i < numTraces ; i++ ) {
+			SV_Trace( &trace, boxes[i * 2], traceMins, traceMaxs, boxes[i * 2 + 1], ENTITYNUM_NONE, MASK_SHOT, qfalse, 0, 0 );
+			if ( trace.entityNum != ENTITYNUM_NONE && trace.entityNum != ENTITYNUM_WORLD ) {
+				hits++;
+			}
+		}
+		traceUsec = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count();
+
+		Com_Printf( "%-8s %i boxes, %i entities found, %.3f usec per box; %i traces, %i entity hits, %.3f usec per trace\n",
+			pass ? "tree" : "sectors", numBoxes, found, areaUsec / numBoxes, numTraces, hits, traceUsec / numTraces );
+	}
+
+	SV_RebuildWorld( useWorldTree );
+	Z_Free( boxes );
+}
@@ -0,0 +1,41 @@
+/*
+The parts of the game module g_timer.c uses, so it can be tested on its own
+*/
+
+#include "game/g_local.h"
+
+level_locals_t	level;
+gentity_t		g_entities[MAX_GENTITIES];
+vmCvar_t		g_timerProfile;
+
+static gameImport_t	imports;
+gameImport_t		*trap = &imports;
+
+static int numWarnings;
+
+static void TimerTest_Printf( const char *msg, ... )
+{
+	if ( !Q_strncmp( msg, S_COLOR_YELLOW"WARNING", 9 ) )
+	{
+		numWarnings++;
+	}
+}
+
+// q_shared.h declares it as a pointer for the game module
+void (*Com_Printf)( const char *msg, ... ) = TimerTest_Printf;
+
+gentity_t *TimerTest_Entity( int num )
+{
+	g_entities[num].s.number = num;
+	return &g_entities[num];
+}
+
+void TimerTest_SetTime( int time )
+{
+	level.time = time;
+}
+
+int TimerTest_Warnings( void )
+{
+	return numWarnings;
+}
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+// g_timer.c, compiled as C with the stubs in g_timer_stubs.c
+extern "C"
+{
+	typedef enum { qfalse, qtrue } qboolean;
+	struct gentity_s;
+	typedef struct gentity_s gentity_t;
+
+	void TIMER_Clear( void );
+	void TIMER_Clear2( gentity_t *ent );
+	void TIMER_Set( gentity_t *ent, const char *identifier, int duration );
+	int TIMER_Get( gentity_t *ent, const char *identifier );
+	qboolean TIMER_Done( gentity_t *ent, const char *identifier );
+	qboolean TIMER_Done2( gentity_t *ent, const char *identifier, qboolean remove );
+	qboolean TIMER_Exists( gentity_t *ent, const char *identifier );
+	void TIMER_Remove( gentity_t *ent, const char *identifier );
+	qboolean TIMER_Start( gentity_t *self, const char *identifier, int duration );
+
+	gentity_t *TimerTest_Entity( int num );
+	void TimerTest_SetTime( int time );
+	int TimerTest_Warnings( void );
+}
+
+namespace
+{
+	// The old timers: one list per entity, searched case insensitively
+	class TimerModel
+	{
+	public:
+		void clear() { timers.clear(); }
+		void clear( int num ) { timers.erase( num ); }
+
+		void set( int num, const std::string &name, int time ) { timers[num][lower( name )] = time; }
+		int get( int num, const std::string &name ) const
+		{
+			auto ent = timers.find( num );
+			if( ent == timers.end() )
+			{
+				return -1;
+			}
+			auto timer = ent->second.find( lower( name ) );
+			return timer == ent->second.end() ? -1 : timer->second;
+		}
+		bool exists( int num, const std::string &name ) const
+		{
+			auto ent = timers.find( num );
+			return ent != timers.end() && ent->second.count( lower( name ) );
+		}
+		void remove( int num, const std::string &name )
+		{
+			auto ent = timers.find( num );
+			if( ent != timers.end() )
+			{
+				ent->second.erase( lower( name ) );
+			}
+		}
+
+	private:
+		static std::string lower( std::string name )
+		{
+			std::transform( name.begin(), name.end(), name.begin(), []( unsigned char c ) { return (char)std::tolower( c ); } );
+			return name;
+		}
+
+		std::map< int, std::map< std::string, int > > timers;
+	};
+
+	// Runs every call against both and checks the results match
+	class TimerCheck
+	{
+	public:
+		explicit TimerCheck( int time = 1000 ) : time( time )
+		{
+			TIMER_Clear();
+			TimerTest_SetTime( time );
+		}
+
+		void advance( int msec )
+		{
+			time += msec;
+			TimerTest_SetTime( time );
+		}
+
+		void set( int num, const char *name, int duration )
+		{
+			TIMER_Set( TimerTest_Entity( num ), name, duration );
+			model.set( num, name, time + duration );
+		}
+		void remove( int num, const char *name )
+		{
+			TIMER_Remove( TimerTest_Entity( num ), name );
+			model.remove( num, name );
+		}
+		void clear( int num )
+		{
+			TIMER_Clear2( TimerTest_Entity( num ) );
+			model.clear( num );
+		}
+		void done2( int num, const char *name, bool remove )
+		{
+			const bool expected = model.exists( num, name ) && model.get( num, name ) < time;
+			BOOST_CHECK_EQUAL( TIMER_Done2( TimerTest_Entity( num ), name, remove ? qtrue : qfalse ) != qfalse, expected );
+			if( expected && remove )
+			{
+				model.remove( num, name );
+			}
+		}
+		void start( int num, const char *name, int duration )
+		{
+			const bool expected = !model.exists( num, name ) || model.get( num, name ) < time;
+			BOOST_CHECK_EQUAL( TIMER_Start( TimerTest_Entity( num ), name, duration ) != qfalse, expected );
+			if( expected )
+			{
+				model.set( num, name, time + duration );
+			}
+		}
+		void check( int num, const char *name ) const
+		{
+			gentity_t *ent = TimerTest_Entity( num );
+			const bool exists = model.exists( num, name );
+
+			BOOST_CHECK_EQUAL( TIMER_Exists( ent, name ) != qfalse, exists );
+			BOOST_CHECK_EQUAL( TIMER_Get( ent, name ), model.get( num, name ) );
+			BOOST_CHECK_EQUAL( TIMER_Done( ent, name ) != qfalse, !exists || model.get( num, name ) < time );
+		}
+
+	private:
+		int time;
+		TimerModel model;
+	};
+}
+
+BOOST_AUTO_TEST_SUITE( game )
+
+BOOST_AUTO_TEST_SUITE( timer )
+
+BOOST_AUTO_TEST_CASE( list_semantics )
+{
+	TimerCheck timers;
+	char buffer[ 32 ];
+
+	// missing timers
+	timers.check( 1, "attackDelay" );
+	timers.done2( 1, "attackDelay", true );
+
+	timers.set( 1, "attackDelay", 500 );
+	timers.check( 1, "attackDelay" );
+	timers.check( 1, "ATTACKDELAY" );
+	timers.check( 2, "attackDelay" );
+	timers.done2( 1, "attackdelay", true );
+
+	// overwritten by another spelling
+	timers.set( 1, "AttackDelay", 100 );
+	timers.check( 1, "attackDelay" );
+	timers.start( 1, "attackDelay", 2000 );
+
+	timers.advance( 101 );
+	timers.check( 1, "attackDelay" );
+	timers.done2( 1, "attackDelay", false );
+	timers.check( 1, "attackDelay" );
+	timers.start( 1, "attackDelay", 2000 );
+	timers.check( 1, "attackDelay" );
+
+	// not done yet, so not removed either
+	timers.done2( 1, "attackDelay", true );
+	timers.check( 1, "attackDelay" );
+	timers.advance( 2001 );
+	timers.done2( 1, "attackDelay", true );
+	timers.check( 1, "attackDelay" );
+
+	// a timer that ends right now is not done
+	timers.set( 1, "flee", 0 );
+	timers.check( 1, "flee" );
+	timers.done2( 1, "flee", true );
+	timers.set( 1, "roam", -1 );
+	timers.check( 1, "roam" );
+
+	timers.remove( 1, "flee" );
+	timers.remove( 1, "flee" );
+	timers.check( 1, "flee" );
+	timers.check( 1, "roam" );
+
+	// the identifier does not have to stay the same at one address
+	for( int i = 0; i < 8; i++ )
+	{
+		std::snprintf( buffer, sizeof( buffer ), "slot%d", i );
+		timers.set( 3, buffer, i * 10 );
+	}
+	for( int i = 0; i < 8; i++ )
+	{
+		std::snprintf( buffer, sizeof( buffer ), "SLOT%d", i );
+		timers.check( 3, buffer );
+		std::snprintf( buffer, sizeof( buffer ), "slot%d", i );
+		timers.check( 3, buffer );
+	}
+
+	timers.clear( 3 );
+	timers.check( 3, "slot0" );
+	timers.check( 1, "roam" );
+
+	TIMER_Clear();
+	TimerTest_SetTime( 0 );
+	BOOST_CHECK( !TIMER_Exists( TimerTest_Entity( 1 ), "roam" ) );
+	BOOST_CHECK_EQUAL( TimerTest_Warnings(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( churn_across_compaction )
+{
+	// Entities below churnEntities grow to 40 timers and drop them, which
+	// leaves most of the pool in free blocks too small for the 80 timers of
+	// the second round. That only fits after the tables were compacted,
+	// so the kept timers of the other entities get moved as well.
+	const int churnEntities = 384;
+	const int keptEntities = 512;
+	const int rounds[] = { 40, 80, 20, 80 };
+	TimerCheck timers;
+	char name[ 32 ];
+
+	std::srand( 1 );
+	for( int num = churnEntities; num < churnEntities + keptEntities; num++ )
+	{
+		timers.set( num, "kept0", num );
+		timers.set( num, "KEPT1", -num );
+		timers.set( num, "kept2", 1000 + num );
+	}
+
+	for( int numTimers : rounds )
+	{
+		for( int num = 0; num < churnEntities; num++ )
+		{
+			for( int i = 0; i < numTimers; i++ )
+			{
+				std::snprintf( name, sizeof( name ), "t%d", i );
+				timers.set( num, name, std::rand() % 200 - 50 );
+				if( std::rand() % 8 == 0 )
+				{
+					std::snprintf( name, sizeof( name ), "t%d", std::rand() % numTimers );
+					timers.check( num, name );
+				}
+			}
+			timers.check( churnEntities + num % keptEntities, "kept1" );
+			timers.advance( 1 );
+		}
+
+		for( int num = 0; num < churnEntities + keptEntities; num++ )
+		{
+			for( int i = 0; i < numTimers; i++ )
+			{
+				std::snprintf( name, sizeof( name ), "t%d", i );
+				timers.check( num, name );
+			}
+			timers.check( num, "kept0" );
+			timers.check( num, "kept1" );
+			timers.check( num, "kept2" );
+		}
+
+		// take them out again in a scattered order
+		timers.advance( 100 );
+		for( int num = 0; num < churnEntities; num++ )
+		{
+			for( int i = 0; i < numTimers; i++ )
+			{
+				std::snprintf( name, sizeof( name ), "T%d", (i * 7) % numTimers );
+				switch( std::rand() % 3 )
+				{
+				case 0:
+					timers.remove( num, name );
+					break;
+				case 1:
+					timers.done2( num, name, true );
+					break;
+				default:
+					timers.start( num, name, std::rand() % 100 );
+					break;
+				}
+			}
+			if( num % 2 )
+			{
+				timers.clear( num );
+			}
+		}
+		timers.advance( 200 );
+		for( int num = 0; num < churnEntities; num++ )
+		{
+			for( int i = 0; i < numTimers; i++ )
+			{
+				std::snprintf( name, sizeof( name ), "t%d", i );
+				timers.done2( num, name, true );
+				timers.check( num, name );
+			}
+		}
+	}
+
+	for( int num = churnEntities; num < churnEntities + keptEntities; num++ )
+	{
+		timers.check( num, "kept0" );
+		timers.check( num, "kept1" );
+		timers.check( num, "kept2" );
+	}
+	BOOST_CHECK_EQUAL( TimerTest_Warnings(), 0 );
+}
+
+// the identifiers stay interned, so this has to come last
+BOOST_AUTO_TEST_CASE( identifiers_full )
+{
+	TimerCheck timers;
+	gentity_t *ent = TimerTest_Entity( 5 );
+	char name[ 32 ];
+	int i;
+
+	// spread over the entities to stay clear of their table sizes
+	timers.set( 5, "first", 100 );
+	for( i = 0; i < 2048 && TimerTest_Warnings() == 0; i++ )
+	{
+		std::snprintf( name, sizeof( name ), "name%d", i );
+		TIMER_Set( TimerTest_Entity( i % 64 ), name, 100 );
+	}
+	BOOST_CHECK_EQUAL( TimerTest_Warnings(), 1 );
+	BOOST_CHECK( !TIMER_Exists( TimerTest_Entity( (i - 1) % 64 ), name ) );
+
+	// warned once, the interned identifiers keep working
+	TIMER_Set( ent, "another", 100 );
+	BOOST_CHECK_EQUAL( TimerTest_Warnings(), 1 );
+	BOOST_CHECK( !TIMER_Exists( ent, "another" ) );
+	BOOST_CHECK( TIMER_Exists( ent, "FIRST" ) );
+	BOOST_CHECK( TIMER_Exists( TimerTest_Entity( 0 ), "name0" ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()